@@ -0,0 +1,184 @@
+#include "analysis_cache.h"
+
+AnalysisCacheWriter::~AnalysisCacheWriter()
+{
+	if (_ofs.is_open())
+		Close();
+}
+
+bool AnalysisCacheWriter::Open(const std::string& file_name, double fps, const LocationDetector::Config& config)
+{
+	if (config.brightness_threshold < analysis_cache::min_threshold || config.brightness_threshold > 254)
+	{
+		std::cout << "Analysis cache only supports brightness thresholds in [" << analysis_cache::min_threshold << ", 254]" << std::endl;
+		return false;
+	}
+
+	_ofs.open(file_name, std::ios::binary | std::ios::trunc);
+	if (!_ofs.is_open())
+	{
+		std::cout << "Cannot open analysis cache file " << file_name << std::endl;
+		return false;
+	}
+
+	_header = {};
+	_header.magic = analysis_cache::magic;
+	_header.version = analysis_cache::version;
+	_header.fps = fps;
+	_header.brightness_threshold = config.brightness_threshold;
+	_header.bright_pixel_ratio_low = config.bright_pixel_ratio_low;
+	_header.bright_pixel_ratio_high = config.bright_pixel_ratio_high;
+	_store_ratio_low = config.bright_pixel_ratio_low / 200.0;
+	_store_ratio_high = config.bright_pixel_ratio_high / 50.0;
+	_last_frame = -1;
+
+	// the header is written again with the number of frames in Close()
+	_ofs.write((const char*)&_header, sizeof(_header));
+	return true;
+}
+
+void AnalysisCacheWriter::AddFrame(int frame_number, int64_t time_us, const cv::Mat& game_img)
+{
+	if (frame_number <= _last_frame)
+		return;
+	_last_frame = frame_number;
+
+	analysis_cache::FrameRecord record = {};
+	record.frame_number = frame_number;
+	record.time_us = time_us;
+	record.game_width = uint16_t(game_img.cols);
+	record.game_height = uint16_t(game_img.rows);
+
+	// same geometry as LocationDetector
+	cv::Rect location_rect = HudFrame::ToPixels(LocationDetector::GetLocationRegion(), game_img.size());
+	cv::cvtColor(game_img(location_rect), _location_gray, cv::COLOR_BGR2GRAY);
+	cv::Rect early_out_rect = LocationDetector::GetEarlyOutRect(location_rect);
+	early_out_rect.x -= location_rect.x;
+	early_out_rect.y -= location_rect.y;
+	cv::Mat early_out_gray = _location_gray(early_out_rect);
+
+	// count of pixels brighter than each threshold, from a histogram of the bright end
+	uint32_t histogram[256 - analysis_cache::min_threshold] = {};
+	for (int i = 0; i < early_out_gray.rows; i++)
+	{
+		const uint8_t* data = early_out_gray.ptr<uint8_t>(i);
+		for (int j = 0; j < early_out_gray.cols; j++)
+			if (data[j] >= analysis_cache::min_threshold)
+				histogram[data[j] - analysis_cache::min_threshold]++;
+	}
+	double area = double(early_out_gray.rows * early_out_gray.cols);
+	uint32_t num_brighter = 0;
+	for (int t = 254; t >= analysis_cache::min_threshold; t--)
+	{
+		num_brighter += histogram[t + 1 - analysis_cache::min_threshold];
+		record.bright_ratio[t - analysis_cache::min_threshold] = uint16_t(num_brighter / area * 65535.0 + 0.5);
+	}
+
+	// keep the box if the frame passes the early-out, or would with somewhat looser parameters.
+	// PNG is lossless, so the OCR sees exactly the same pixels as in the original analysis
+	double ratio = AnalysisCacheReader::GetBrightRatio(record, _header.brightness_threshold);
+	bool store_box = ratio >= _store_ratio_low && ratio <= _store_ratio_high;
+	if (store_box)
+	{
+		cv::imencode(".png", _location_gray, _png);
+		record.box_size = uint32_t(_png.size());
+	}
+
+	_ofs.write((const char*)&record, sizeof(record));
+	if (store_box)
+		_ofs.write((const char*)_png.data(), _png.size());
+
+	_header.num_frames++;
+	if (_header.num_frames % flush_interval == 0)
+		_ofs.flush();
+}
+
+bool AnalysisCacheWriter::Close()
+{
+	if (!_ofs.is_open())
+		return false;
+
+	_ofs.seekp(0);
+	_ofs.write((const char*)&_header, sizeof(_header));
+	bool success = _ofs.good();
+	_ofs.close();
+	return success;
+}
+
+AnalysisCacheReader::~AnalysisCacheReader()
+{
+	Close();
+}
+
+bool AnalysisCacheReader::Open(const std::string& file_name)
+{
+	Close();
+
+	if (!_file.Open(file_name))
+		return false;
+
+	_header = (const analysis_cache::Header*)_file.Data();
+	if (_file.Size() < sizeof(analysis_cache::Header) || _header->magic != analysis_cache::magic || _header->version != analysis_cache::version)
+	{
+		std::cout << "Invalid analysis cache file " << file_name << std::endl;
+		Close();
+		return false;
+	}
+
+	// only the records are touched, the boxes in between are skipped. A record or box that was cut off ends the cache
+	uint64_t offset = sizeof(analysis_cache::Header);
+	while (offset + sizeof(analysis_cache::FrameRecord) <= _file.Size())
+	{
+		const analysis_cache::FrameRecord* record = (const analysis_cache::FrameRecord*)(_file.Data() + offset);
+		uint64_t end = offset + sizeof(analysis_cache::FrameRecord) + record->box_size;
+		if (end > _file.Size())
+			break;
+		_records.push_back(record);
+		offset = end;
+	}
+
+	if (_header->num_frames == 0)
+		std::cout << "The analysis that wrote " << file_name << " didn't finish, its first " << _records.size() << " frames are used" << std::endl;
+	else if (_records.size() < _header->num_frames)
+	{
+		std::cout << "Invalid analysis cache file " << file_name << ", " << _header->num_frames - _records.size() << " frames are missing" << std::endl;
+		Close();
+		return false;
+	}
+	else
+		_records.resize(_header->num_frames);
+	return true;
+}
+
+void AnalysisCacheReader::Close()
+{
+	_file.Close();
+	_header = nullptr;
+	_records.clear();
+}
+
+int64_t AnalysisCacheReader::GetFrameTimeUs(int frame_number) const
+{
+	// the records are in the order of their frame numbers
+	auto it = std::lower_bound(_records.begin(), _records.end(), frame_number,
+		[](const analysis_cache::FrameRecord* record, int frame_number) { return record->frame_number < frame_number; });
+	if (it != _records.end() && (*it)->frame_number == frame_number)
+		return (*it)->time_us;
+	return _header->fps > 0.0 ? int64_t(frame_number / _header->fps * 1000000.0) : 0;
+}
+
+double AnalysisCacheReader::GetBrightRatio(const analysis_cache::FrameRecord& record, int threshold)
+{
+	return record.bright_ratio[threshold - analysis_cache::min_threshold] / 65535.0;
+}
+
+bool AnalysisCacheReader::DecodeLocationBox(const analysis_cache::FrameRecord& record, cv::Mat& location_gray) const
+{
+	if (record.box_size == 0)
+		return false;
+
+	// decode straight from the mapped memory, Open() made sure the box is inside the file
+	cv::Mat png(1, int(record.box_size), CV_8UC1, (void*)((const uint8_t*)&record + sizeof(analysis_cache::FrameRecord)));
+	location_gray = cv::imdecode(png, cv::IMREAD_GRAYSCALE);
+	return !location_gray.empty();
+}
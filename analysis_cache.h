@@ -0,0 +1,106 @@
+#pragma once
+#include "common.h"
+#include "location_detector.h"
+
+
+// Sidecar file written during a video analysis, so that the early-out, OCR and matching can be tuned without decoding the video again.
+// It holds the early-out statistics of every frame, and the location boxes of frames that are close to passing the early-out.
+//
+// Layout, all little-endian:
+//   Header
+//   for each analysed frame: FrameRecord, followed by the PNG-compressed gray location box if FrameRecord::box_size > 0
+// Records are appended as the frames are analysed and the header is finished when the analysis ends, so the cache of an analysis
+// that was stopped or crashed can still be read up to its last complete record.
+namespace analysis_cache
+{
+	constexpr uint32_t magic = 0x43545248;		// "HRTC"
+	constexpr uint32_t version = 3;
+
+	// the statistics cover brightness thresholds from min_threshold to 254
+	constexpr int min_threshold = 192;
+	constexpr int num_thresholds = 255 - min_threshold;
+
+#pragma pack(push, 1)
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		double fps;
+		uint32_t num_frames;			// 0 if the analysis didn't finish
+
+		// early-out parameters of the analysis, boxes are stored for frames with a bright pixel ratio in [ratio_low / 2, ratio_high * 2] at this threshold
+		int32_t brightness_threshold;
+		int32_t bright_pixel_ratio_low;
+		int32_t bright_pixel_ratio_high;
+	};
+
+	struct FrameRecord
+	{
+		int32_t frame_number;
+		int64_t time_us;				// time the frame is labelled with, see VideoIndex::GetLabelTimeUs()
+		uint32_t box_size;				// size of the PNG of the location box that follows the record, 0 if the box is not stored
+		uint16_t game_width;
+		uint16_t game_height;
+		uint16_t bright_ratio[num_thresholds];		// ratio of pixels in the early-out area brighter than min_threshold + i, in units of 1/65535
+	};
+#pragma pack(pop)
+}
+
+class AnalysisCacheWriter
+{
+private:
+	static constexpr uint32_t flush_interval = 256;		// frames, at most this many are lost if the analysis is killed
+
+	std::ofstream _ofs;
+	analysis_cache::Header _header = {};
+	int _last_frame = -1;
+	double _store_ratio_low = 0.0, _store_ratio_high = 1.0;
+
+	// reusable buffers
+	cv::Mat _location_gray;
+	std::vector<uint8_t> _png;
+
+public:
+	~AnalysisCacheWriter();
+
+	bool Open(const std::string& file_name, double fps, const LocationDetector::Config& config);
+
+	// add a frame, game_img is BGR. Frame numbers have to increase
+	void AddFrame(int frame_number, int64_t time_us, const cv::Mat& game_img);
+
+	// write the number of frames into the header and close the file
+	bool Close();
+
+	bool IsOpen() const { return _ofs.is_open(); }
+};
+
+// Reads a cache through a read-only memory mapping of the file, so that only the pages that are used are loaded
+class AnalysisCacheReader
+{
+private:
+	util::MappedFile _file;
+	const analysis_cache::Header* _header = nullptr;
+	std::vector<const analysis_cache::FrameRecord*> _records;		// into the mapping, found when the file is opened
+
+public:
+	AnalysisCacheReader() = default;
+	AnalysisCacheReader(const AnalysisCacheReader&) = delete;
+	AnalysisCacheReader& operator=(const AnalysisCacheReader&) = delete;
+	~AnalysisCacheReader();
+
+	bool Open(const std::string& file_name);
+	void Close();
+
+	const analysis_cache::Header& GetHeader() const { return *_header; }
+	// records of the frames in the order they were analysed
+	uint32_t NumRecords() const { return uint32_t(_records.size()); }
+	const analysis_cache::FrameRecord& GetRecord(uint32_t index) const { return *_records[index]; }
+	// label time of a frame as the analysis had it, frame_number / fps for a frame that isn't in the cache
+	int64_t GetFrameTimeUs(int frame_number) const;
+
+	// ratio of bright pixels in the early-out area at the given threshold, which has to be in [min_threshold, 254]
+	static double GetBrightRatio(const analysis_cache::FrameRecord& record, int threshold);
+
+	// decompress the stored location box of a frame, returns false if it's not stored
+	bool DecodeLocationBox(const analysis_cache::FrameRecord& record, cv::Mat& location_gray) const;
+};
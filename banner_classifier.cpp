@@ -0,0 +1,161 @@
+#include "banner_classifier.h"
+
+namespace
+{
+	constexpr char file_magic[] = "HRTBannerClassifier";
+	constexpr int file_version = 1;
+
+	// gradient descent settings, the problem is small enough for full batches
+	constexpr int num_epochs = 500;
+	constexpr float l2_regularization = 1e-4f;
+
+	float Sigmoid(float x)
+	{
+		return 1.0f / (1.0f + std::exp(-x));
+	}
+}
+
+bool BannerClassifier::Load(const std::string& file_name)
+{
+	std::ifstream ifs(file_name);
+	if (!ifs.is_open())
+	{
+		std::cout << "Cannot open banner classifier " << file_name << std::endl;
+		return false;
+	}
+
+	std::string magic;
+	int version, cols, rows;
+	ifs >> magic >> version >> cols >> rows >> _brightness_threshold >> _threshold >> _bias;
+	if (!ifs || magic != file_magic || version != file_version || cols != grid_cols || rows != grid_rows)
+	{
+		std::cout << file_name << " is not a banner classifier of this version" << std::endl;
+		_weights.clear();
+		return false;
+	}
+
+	_weights.resize(num_features);
+	for (float& weight : _weights)
+		ifs >> weight;
+	if (!ifs)
+	{
+		std::cout << "Banner classifier " << file_name << " is incomplete" << std::endl;
+		_weights.clear();
+		return false;
+	}
+	return true;
+}
+
+bool BannerClassifier::Save(const std::string& file_name) const
+{
+	std::ofstream ofs(file_name);
+	if (!ofs.is_open())
+	{
+		std::cout << "Cannot open " << file_name << " for writing" << std::endl;
+		return false;
+	}
+
+	ofs.precision(9);
+	ofs << file_magic << " " << file_version << std::endl;
+	ofs << grid_cols << " " << grid_rows << " " << _brightness_threshold << std::endl;
+	ofs << _threshold << " " << _bias << std::endl;
+	for (int row = 0; row < grid_rows; row++)
+	{
+		for (int col = 0; col < grid_cols; col++)
+			ofs << (col > 0 ? " " : "") << _weights[row * grid_cols + col];
+		ofs << std::endl;
+	}
+	return bool(ofs);
+}
+
+void BannerClassifier::ComputeFeatures(const cv::Mat& location_gray, std::vector<float>& features)
+{
+	// INTER_AREA averages the binarized pixels of each cell, which gives the ratio of bright pixels
+	cv::threshold(location_gray, _bright, _brightness_threshold, 1.0, cv::THRESH_BINARY);
+	_bright.convertTo(_bright, CV_32F);
+	cv::resize(_bright, _grid, cv::Size(grid_cols, grid_rows), 0.0, 0.0, cv::INTER_AREA);
+
+	features.resize(num_features);
+	for (int row = 0; row < grid_rows; row++)
+		memcpy(&features[row * grid_cols], _grid.ptr<float>(row), grid_cols * sizeof(float));
+}
+
+float BannerClassifier::Score(const std::vector<float>& features) const
+{
+	float sum = _bias;
+	for (int i = 0; i < num_features; i++)
+		sum += _weights[i] * features[i];
+	return Sigmoid(sum);
+}
+
+float BannerClassifier::Score(const cv::Mat& location_gray)
+{
+	ComputeFeatures(location_gray, _features);
+	return Score(_features);
+}
+
+BannerClassifier::TrainingReport BannerClassifier::Train(const std::vector<Sample>& samples, double min_recall)
+{
+	TrainingReport report;
+	for (const Sample& sample : samples)
+		(sample.is_banner ? report.num_banners : report.num_others)++;
+
+	_weights.assign(num_features, 0.0f);
+	_bias = 0.0f;
+	_threshold = 0.5f;
+	if (report.num_banners == 0 || report.num_others == 0)
+		return report;
+
+	// there are a lot more boxes without a banner, weigh the classes equally
+	float banner_weight = float(samples.size()) / (2.0f * report.num_banners);
+	float other_weight = float(samples.size()) / (2.0f * report.num_others);
+
+	// The curvature of the log loss is at most 1/4 of the weighted mean of |x|^2 (with 1 for the bias),
+	// a step of the inverse can't overshoot however bright the boxes are
+	double curvature = 0.0;
+	for (const Sample& sample : samples)
+	{
+		double norm = 1.0;
+		for (float feature : sample.features)
+			norm += feature * feature;
+		curvature += (sample.is_banner ? banner_weight : other_weight) * norm;
+	}
+	float learning_rate = float(4.0 * samples.size() / curvature);
+
+	// logistic regression by gradient descent on the weighted log loss
+	std::vector<float> gradient(num_features);
+	for (int epoch = 0; epoch < num_epochs; epoch++)
+	{
+		std::fill(gradient.begin(), gradient.end(), 0.0f);
+		float bias_gradient = 0.0f;
+		for (const Sample& sample : samples)
+		{
+			float error = Score(sample.features) - (sample.is_banner ? 1.0f : 0.0f);
+			error *= sample.is_banner ? banner_weight : other_weight;
+			for (int i = 0; i < num_features; i++)
+				gradient[i] += error * sample.features[i];
+			bias_gradient += error;
+		}
+
+		float step = learning_rate / samples.size();
+		for (int i = 0; i < num_features; i++)
+			_weights[i] -= step * gradient[i] + learning_rate * l2_regularization * _weights[i];
+		_bias -= step * bias_gradient;
+	}
+
+	// the lowest threshold that rejects at most 1 - min_recall of the banners
+	std::vector<float> banner_scores;
+	for (const Sample& sample : samples)
+		if (sample.is_banner)
+			banner_scores.push_back(Score(sample.features));
+	std::sort(banner_scores.begin(), banner_scores.end());
+	size_t num_rejectable = size_t((1.0 - min_recall) * banner_scores.size());
+	_threshold = banner_scores[num_rejectable];
+
+	for (const Sample& sample : samples)
+	{
+		if (Score(sample.features) < _threshold)
+			(sample.is_banner ? report.num_banners_rejected : report.num_others_rejected)++;
+	}
+	return report;
+}
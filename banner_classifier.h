@@ -0,0 +1,61 @@
+#pragma once
+#include "common.h"
+
+
+// A small logistic regression that tells if a location box likely shows a location banner, to skip the OCR of boxes that only pass
+// the bright pixel ratio test because of snow, bright sky or a dialog box.
+// The box is binarized at the brightness threshold and shrunk to a grid of grid_cols x grid_rows cells, the features are the ratios of
+// bright pixels in the cells. Models are trained offline from the boxes of an analysis cache, labelled by the full OCR (see -train).
+class BannerClassifier
+{
+public:
+	static constexpr int grid_cols = 48;
+	static constexpr int grid_rows = 6;
+	static constexpr int num_features = grid_cols * grid_rows;
+
+	// one labelled box for training
+	struct Sample
+	{
+		std::vector<float> features;
+		bool is_banner = false;
+	};
+
+	struct TrainingReport
+	{
+		size_t num_banners = 0, num_others = 0;
+		size_t num_banners_rejected = 0;		// at the chosen threshold
+		size_t num_others_rejected = 0;
+	};
+
+private:
+	std::vector<float> _weights;		// num_features
+	float _bias = 0.0f;
+	float _threshold = 0.5f;			// boxes with a lower probability are rejected
+	int _brightness_threshold = 240;	// of the binarization, the one the model was trained with
+
+	// reusable buffers
+	cv::Mat _bright;
+	cv::Mat _grid;
+	std::vector<float> _features;
+
+public:
+	bool Load(const std::string& file_name);
+	bool Save(const std::string& file_name) const;
+	bool IsLoaded() const { return _weights.size() == num_features; }
+
+	// the binarization threshold of ComputeFeatures(), Load() sets the one the model was trained with
+	void SetBrightnessThreshold(int threshold) { _brightness_threshold = threshold; }
+	int BrightnessThreshold() const { return _brightness_threshold; }
+
+	void ComputeFeatures(const cv::Mat& location_gray, std::vector<float>& features);
+
+	// probability that the box shows a banner
+	float Score(const std::vector<float>& features) const;
+	float Score(const cv::Mat& location_gray);
+	bool IsBanner(const cv::Mat& location_gray) { return Score(location_gray) >= _threshold; }
+	float Threshold() const { return _threshold; }
+
+	// Fit the model to samples from ComputeFeatures().
+	// The decision threshold is set so that at least min_recall of the banners are kept
+	TrainingReport Train(const std::vector<Sample>& samples, double min_recall);
+};
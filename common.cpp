@@ -1,4 +1,7 @@
 #include "common.h"
+#include <map>
+#include <iomanip>
+#include <mutex>
 
 namespace util
 {
@@ -9,13 +12,21 @@ uint32_t GetStringEditDistance(const std::string& first, const std::string& seco
 	uint32_t n = uint32_t(second.length());
 	uint32_t s = max_allowed_edits;
 
-	std::vector<uint32_t> T((m + 1) * (n + 1));		// TODO: make this thread_local to avoid multiple memory allocations, or just use alloca()
-	T[0] = 0;
-	for (uint32_t i = 1; i <= std::min(s, n); i++) {
+	// the distance is at least the difference of the lengths, and the band below doesn't reach the last cell if it's larger than s
+	if (std::max(m, n) - std::min(m, n) > s)
+		return max_allowed_edits + 1;
+
+	// the table is kept per thread and only ever grows, so steady-state calls don't allocate memory.
+	// The band reads cells it doesn't write, e.g. the first column below s, those must be 0 as in a new table
+	thread_local std::vector<uint32_t> T;
+	if (T.size() < (m + 1) * (n + 1))
+		T.resize((m + 1) * (n + 1));
+	std::fill(T.begin(), T.begin() + (m + 1) * (n + 1), 0u);
+	for (uint32_t i = 1; i <= std::min(s, m); i++) {
 		T[i * (n + 1) + 0] = i;
 	}
 
-	for (uint32_t j = 1; j <= std::min(s, m); j++) {
+	for (uint32_t j = 1; j <= std::min(s, n); j++) {
 		T[0 * (n + 1) + j] = j;
 	}
 
@@ -41,6 +52,45 @@ uint32_t GetStringEditDistance(const std::string& first, const std::string& seco
 	return T[m * (n + 1) + n];
 }
 
+uint32_t CountPixelsAbove(const cv::Mat& gray, int threshold)
+{
+	uint32_t count = 0;
+	for (int i = 0; i < gray.rows; i++)
+	{
+		const uint8_t* data = gray.ptr<uint8_t>(i);
+		for (int j = 0; j < gray.cols; j++)
+			if (data[j] > threshold)
+				count++;
+	}
+	return count;
+}
+
+void NormalizeTextForMatching(std::string_view text_in, std::string& text_out)
+{
+	text_out.assign(text_in);
+	// spaces and single quotes are ignored since sometimes they are not correctly recognized
+	text_out.erase(std::remove_if(text_out.begin(), text_out.end(), [](auto& c) -> bool { return c == ' ' || c == '\''; }), text_out.end());
+
+	// The Hylia Serif font (unofficial name) used by BotW has similar glyphs for upper/lower-case letters, causing the recognition to mix them sometimes.
+	// Forcing to uppercase to get rid of this confusion.
+	std::for_each(text_out.begin(), text_out.end(), [](auto& c) { c = std::toupper(c); });
+}
+
+void WriteJsonString(std::ostream& os, std::string_view str)
+{
+	os << '"';
+	for (char c : str)
+	{
+		if (c == '"' || c == '\\')
+			os << '\\' << c;
+		else if (uint8_t(c) < 0x20)
+			os << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+		else
+			os << c;
+	}
+	os << '"';
+}
+
 void OpenCvMatBGRAToLeptonicaRGBAInplace(cv::Mat& frame)
 {
 	//                 byte[0] byte[1] byte[2] byte[3]
@@ -54,4 +104,249 @@ void OpenCvMatBGRAToLeptonicaRGBAInplace(cv::Mat& frame)
 	}
 }
 
+void WrapLeptonicaPix(cv::Mat& frame, PIX& pix)
+{
+	memset(&pix, 0, sizeof(pix));
+	pixSetDimensions(&pix, frame.cols, frame.rows, 32);
+	pixSetWpl(&pix, int(frame.step / 4));
+	pixSetSpp(&pix, 4);
+	pix.refcount = 1;
+	pix.informat = IFF_UNKNOWN;
+	pixSetData(&pix, (l_uint32*)frame.data);
+}
+
+void BrightTextToOcrInput(cv::Mat& gray, cv::Mat& ocr_input)
+{
+	for (int i = 0; i < gray.rows; i++)
+	{
+		uint8_t* data = gray.ptr<uint8_t>(i);
+		for (int j = 0; j < gray.cols; j++)
+			data[j] = 255 - (std::max(data[j], uint8_t(204)) - 204) * 5;		// invert the image so that the text is black-on-white. For some reason, Tesseract OCRs such text at almost double the speed compared to white-on-black text.
+	}
+	// convert to BGRA so that each pixel has 4 bytes (needed because opencv uses little-endian in Mat and leptonica uses big-endian in PIX)
+	cv::cvtColor(gray, ocr_input, cv::COLOR_GRAY2BGRA);
+
+	// reorder the channels in each pixel for leptonica
+	OpenCvMatBGRAToLeptonicaRGBAInplace(ocr_input);
+}
+
+namespace
+{
+	// the rows of PreprocessBrightText() for a fixed number of channels, so that the gray conversion has a constant stride
+	template <int Channels>
+	uint32_t PreprocessBrightTextRows(const cv::Mat& src, const cv::Rect& area, const uint8_t* range_lut, int brightness_threshold,
+		const cv::Rect& counted, cv::Mat* ocr_input, cv::Size ocr_size)
+	{
+		// per-thread buffers, so that the detectors of different workers don't share them
+		thread_local std::vector<uint8_t> s_gray_row;
+		thread_local std::vector<int> s_cell_cols;		// first source column of each cell, and the end of the last one
+		thread_local std::vector<uint32_t> s_cell_sums;
+		s_gray_row.resize(area.width);
+
+		int cell_row = 0, cell_row_begin = 0, cell_row_end = 0;
+		if (ocr_input)
+		{
+			ocr_input->create(ocr_size, CV_8UC4);
+			s_cell_cols.resize(ocr_size.width + 1);
+			for (int col = 0; col <= ocr_size.width; col++)
+				s_cell_cols[col] = col * area.width / ocr_size.width;
+			s_cell_sums.assign(ocr_size.width, 0);
+			cell_row_end = area.height / ocr_size.height;
+		}
+
+		uint32_t num_bright = 0;
+		for (int row = 0; row < area.height; row++)
+		{
+			const uint8_t* src_row = src.ptr<uint8_t>(area.y + row) + area.x * Channels;
+			uint8_t* gray_row = s_gray_row.data();
+			const uint8_t* gray = gray_row;
+			if constexpr (Channels == 1)
+			{
+				if (range_lut)
+				{
+					for (int col = 0; col < area.width; col++)
+						gray_row[col] = range_lut[src_row[col]];
+				}
+				else
+					gray = src_row;
+			}
+			else
+			{
+				// same conversion as cv::COLOR_BGR2GRAY, so the thresholds mean the same as before
+				for (int col = 0; col < area.width; col++)
+					gray_row[col] = util::BgrToGray(src_row + col * Channels);
+			}
+
+			if (row >= counted.y && row < counted.y + counted.height)
+			{
+				for (int col = counted.x; col < counted.x + counted.width; col++)
+					num_bright += gray[col] > brightness_threshold;
+			}
+
+			if (!ocr_input)
+				continue;
+
+			// box filter the row into its cells
+			for (int cell = 0; cell < ocr_size.width; cell++)
+			{
+				uint32_t sum = 0;
+				for (int col = s_cell_cols[cell]; col < s_cell_cols[cell + 1]; col++)
+					sum += gray[col];
+				s_cell_sums[cell] += sum;
+			}
+
+			if (row + 1 < cell_row_end)
+				continue;
+
+			// last source row of a cell row, finish it the same way as BrightTextToOcrInput()
+			uint32_t* dst = ocr_input->ptr<uint32_t>(cell_row);
+			uint32_t cell_height = uint32_t(cell_row_end - cell_row_begin);
+			for (int cell = 0; cell < ocr_size.width; cell++)
+			{
+				uint32_t cell_area = uint32_t(s_cell_cols[cell + 1] - s_cell_cols[cell]) * cell_height;
+				dst[cell] = util::ToOcrInputPixel(int((s_cell_sums[cell] + cell_area / 2) / cell_area));
+				s_cell_sums[cell] = 0;
+			}
+			cell_row++;
+			cell_row_begin = cell_row_end;
+			cell_row_end = (cell_row + 1) * area.height / ocr_size.height;
+		}
+		return num_bright;
+	}
+}
+
+uint32_t PreprocessBrightText(const cv::Mat& src, const cv::Rect& rect, const uint8_t* range_lut, int brightness_threshold, const cv::Rect& count_rect,
+	cv::Mat* ocr_input, cv::Size ocr_size)
+{
+	// cells can't be smaller than a pixel
+	ocr_size.width = std::min(ocr_size.width, rect.width);
+	ocr_size.height = std::min(ocr_size.height, rect.height);
+	if (!ocr_input || ocr_size.width <= 0 || ocr_size.height <= 0)
+		ocr_input = nullptr;
+
+	// without OCR input only the counted pixels are read
+	cv::Rect counted = (count_rect + rect.tl()) & rect;
+	cv::Rect area = ocr_input ? rect : counted;
+	counted -= area.tl();
+	if (area.empty())
+		return 0;
+
+	switch (src.channels())
+	{
+	case 1:
+		return PreprocessBrightTextRows<1>(src, area, range_lut, brightness_threshold, counted, ocr_input, ocr_size);
+	case 3:
+		return PreprocessBrightTextRows<3>(src, area, range_lut, brightness_threshold, counted, ocr_input, ocr_size);
+	case 4:
+		return PreprocessBrightTextRows<4>(src, area, range_lut, brightness_threshold, counted, ocr_input, ocr_size);
+	default:
+		return 0;
+	}
+}
+
+bool SetCurrentThreadScheduling(const ThreadScheduling& scheduling)
+{
+	HANDLE thread = ::GetCurrentThread();
+	if (!::SetThreadPriority(thread, scheduling.priority))
+		return false;
+	if (scheduling.affinity_mask != 0 && ::SetThreadAffinityMask(thread, DWORD_PTR(scheduling.affinity_mask)) == 0)
+		return false;
+	return true;
+}
+
+std::chrono::microseconds GetProcessCpuTime()
+{
+	FILETIME creation_time, exit_time, kernel_time, user_time;
+	if (!::GetProcessTimes(::GetCurrentProcess(), &creation_time, &exit_time, &kernel_time, &user_time))
+		return std::chrono::microseconds(0);
+
+	// in units of 100ns
+	auto to_int = [](const FILETIME& time) { return (uint64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+	return std::chrono::microseconds((to_int(kernel_time) + to_int(user_time)) / 10);
+}
+
+bool MappedFile::Open(const std::string& file_name)
+{
+	Close();
+
+	_file = ::CreateFileA(file_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (_file == INVALID_HANDLE_VALUE)
+	{
+		std::cout << "Cannot open file " << file_name << std::endl;
+		return false;
+	}
+	LARGE_INTEGER size;
+	if (!::GetFileSizeEx(_file, &size) || size.QuadPart == 0)
+	{
+		// an empty file can't be mapped
+		std::cout << "File " << file_name << " is empty" << std::endl;
+		Close();
+		return false;
+	}
+	_size = uint64_t(size.QuadPart);
+
+	_mapping = ::CreateFileMappingA(_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (_mapping)
+		_data = (const uint8_t*)::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!_data)
+	{
+		std::cout << "Cannot map file " << file_name << std::endl;
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+	if (_data)
+		::UnmapViewOfFile(_data);
+	if (_mapping)
+		::CloseHandle(_mapping);
+	if (_file != INVALID_HANDLE_VALUE)
+		::CloseHandle(_file);
+	_data = nullptr;
+	_mapping = nullptr;
+	_file = INVALID_HANDLE_VALUE;
+	_size = 0;
+}
+
+bool InitTesseract(tesseract::TessBaseAPI& tess_api, const char* lang, const OcrModel& model)
+{
+	std::string file = model.file.empty() ? std::string(lang) + ".traineddata" : model.file;
+
+	// the mappings are kept until the program exits
+	static std::mutex s_models_mutex;
+	static std::map<std::string, std::unique_ptr<MappedFile>> s_models;
+	const MappedFile* mapped_file;
+	{
+		std::lock_guard<std::mutex> lg(s_models_mutex);
+		std::unique_ptr<MappedFile>& entry = s_models[file];
+		if (!entry)
+		{
+			std::unique_ptr<MappedFile> new_entry = std::make_unique<MappedFile>();
+			if (!new_entry->Open(file))
+			{
+				s_models.erase(file);
+				return false;
+			}
+			entry = std::move(new_entry);
+		}
+		mapped_file = entry.get();
+	}
+
+	// the dictionaries have to be disabled before the model is loaded
+	std::vector<std::string> vars, values;
+	if (!model.dictionary)
+	{
+		for (const char* var : { "load_system_dawg", "load_punc_dawg", "load_number_dawg" })
+		{
+			vars.push_back(var);
+			values.push_back("0");
+		}
+	}
+
+	return tess_api.Init((const char*)mapped_file->Data(), int(mapped_file->Size()), lang, tesseract::OEM_DEFAULT, nullptr, 0, &vars, &values, false, nullptr) == 0;
+}
+
 }
@@ -3,6 +3,8 @@
 #include <memory>
 #include <sstream>
 #include <fstream>
+#include <thread>
+#include <chrono>
 
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
@@ -73,8 +75,157 @@ namespace util
 	uint32_t GetStringEditDistance(const std::string& first, const std::string& second, uint32_t max_allowed_edits);
 
 
+	/**
+	 * Heap allocations of the current thread are counted in g_num_allocations while g_count_allocations is set, for checking that the
+	 * per-frame path doesn't allocate (see -selftest). Only the program replaces operator new to count them, the flag does nothing elsewhere.
+	 */
+	inline thread_local bool g_count_allocations = false;
+	inline thread_local uint64_t g_num_allocations = 0;
+
+	// stops counting until Resume() or the end of the scope, around third-party code that allocates on its own
+	class AllocationCountPause
+	{
+	private:
+		bool _was_counting;
+
+	public:
+		AllocationCountPause() : _was_counting(g_count_allocations) { g_count_allocations = false; }
+		~AllocationCountPause() { Resume(); }
+		AllocationCountPause(const AllocationCountPause&) = delete;
+		AllocationCountPause& operator=(const AllocationCountPause&) = delete;
+		void Resume() { g_count_allocations = _was_counting; }
+	};
+
+
+	/**
+	 * Count the pixels of a gray image that are brighter than threshold
+	 */
+	uint32_t CountPixelsAbove(const cv::Mat& gray, int threshold);
+
+
+	/**
+	 * Normalize a name or OCR text for matching. The result is written to an existing string so that its capacity can be reused.
+	 */
+	void NormalizeTextForMatching(std::string_view text_in, std::string& text_out);
+
+
+	/**
+	 * Write a string as a quoted and escaped JSON string
+	 */
+	void WriteJsonString(std::ostream& os, std::string_view str);
+
+
 	/**
 	 * Reorder channels of an opencv Mat in BGRA format to Leptonica RGBA order
 	 */
 	void OpenCvMatBGRAToLeptonicaRGBAInplace(cv::Mat& frame);
+
+
+	/**
+	 * Fill a PIX struct that refers to the pixels of a BGRA Mat with channels already in Leptonica order, no pixel data is copied
+	 */
+	void WrapLeptonicaPix(cv::Mat& frame, PIX& pix);
+
+
+	/**
+	 * Turn a gray image of bright in-game text into Tesseract input, i.e. dark text on white background in Leptonica RGBA order.
+	 * gray is modified in place, ocr_input should be preallocated to the same size in CV_8UC4 to avoid allocation.
+	 */
+	void BrightTextToOcrInput(cv::Mat& gray, cv::Mat& ocr_input);
+
+
+	/**
+	 * Crop, gray conversion, downscale and BrightTextToOcrInput() of a text box in a single pass over the source pixels.
+	 * src is BGR, BGRA or gray, gray is mapped through range_lut if not null. Each source row is converted once and box-filtered
+	 * into the cells of ocr_size (area averaging), so no full size gray image or intermediate copy is made.
+	 * Pixels brighter than brightness_threshold inside count_rect (relative to rect) are counted on the way and returned.
+	 * If ocr_input is null only count_rect is read, for an early-out test.
+	 */
+	uint32_t PreprocessBrightText(const cv::Mat& src, const cv::Rect& rect, const uint8_t* range_lut, int brightness_threshold, const cv::Rect& count_rect,
+		cv::Mat* ocr_input, cv::Size ocr_size);
+
+
+	/**
+	 * Gray value of a BGR pixel, with the same fixed point weights and rounding as cv::COLOR_BGR2GRAY
+	 */
+	inline uint8_t BgrToGray(const uint8_t* bgr)
+	{
+		return uint8_t((bgr[0] * 1868 + bgr[1] * 9617 + bgr[2] * 4899 + (1 << 13)) >> 14);
+	}
+
+
+	/**
+	 * OCR input pixel of an averaged gray value, inverted and stretched like BrightTextToOcrInput(), as gray BGRA with the channels
+	 * already reordered for leptonica (see OpenCvMatBGRAToLeptonicaRGBAInplace())
+	 */
+	inline uint32_t ToOcrInputPixel(int gray)
+	{
+		uint32_t inverted = uint32_t(255 - (std::max(gray, 204) - 204) * 5);
+		return (inverted * 0x01010100u) | 0xFF;
+	}
+
+
+	/**
+	 * Scheduling settings of a worker thread
+	 */
+	struct ThreadScheduling
+	{
+		int priority = THREAD_PRIORITY_NORMAL;
+		uint64_t affinity_mask = 0;			// bit mask of allowed cores, 0 means any core
+	};
+
+
+	/**
+	 * Apply scheduling settings to the calling thread
+	 */
+	bool SetCurrentThreadScheduling(const ThreadScheduling& scheduling);
+
+
+	/**
+	 * User and kernel time of all threads of the process so far
+	 */
+	std::chrono::microseconds GetProcessCpuTime();
+
+
+	/**
+	 * Which Tesseract model to load
+	 */
+	struct OcrModel
+	{
+		std::string file;				// traineddata file, "<lang>.traineddata" if empty. Can be a pruned model
+		bool dictionary = true;			// load the word lists of the model, they only bias the recognition towards English words
+	};
+
+
+	/**
+	 * Initialize Tesseract from a memory mapping of the model file.
+	 * The file is mapped once and shared by all instances, so several instances can be initialized in parallel without reading it again.
+	 */
+	bool InitTesseract(tesseract::TessBaseAPI& tess_api, const char* lang, const OcrModel& model);
+
+
+	/**
+	 * A file mapped read-only into memory, only the pages that are used are loaded
+	 */
+	class MappedFile
+	{
+	private:
+		HANDLE _file = INVALID_HANDLE_VALUE;
+		HANDLE _mapping = nullptr;
+		const uint8_t* _data = nullptr;
+		uint64_t _size = 0;
+
+	public:
+		MappedFile() = default;
+		MappedFile(const MappedFile&) = delete;
+		MappedFile& operator=(const MappedFile&) = delete;
+		~MappedFile() { Close(); }
+
+		// prints the reason on failure
+		bool Open(const std::string& file_name);
+		void Close();
+
+		const uint8_t* Data() const { return _data; }
+		uint64_t Size() const { return _size; }
+	};
 }
\ No newline at end of file
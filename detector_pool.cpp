@@ -0,0 +1,215 @@
+#include "detector_pool.h"
+
+DetectorPool::~DetectorPool()
+{
+	Stop();
+}
+
+bool DetectorPool::AddWorkers(int num_workers, const WorkerInit& init)
+{
+	if (_threads.size() > 0 || num_workers < 0)
+		return false;
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	std::vector<std::future<bool>> results;
+	for (int i = 0; i < num_workers; i++)
+	{
+		Worker& worker = *workers.emplace_back(std::make_unique<Worker>());
+		results.push_back(std::async(std::launch::async, [&init, &worker]() { return init(worker); }));
+	}
+
+	// wait for all of them, the workers can't be destroyed while an init is still running
+	bool success = true;
+	for (std::future<bool>& result : results)
+		success = result.get() && success;
+	if (!success)
+		return false;
+
+	for (std::unique_ptr<Worker>& worker : workers)
+		_workers.push_back(std::move(worker));
+	return true;
+}
+
+bool DetectorPool::Start(int num_streams, ResultHandler handler)
+{
+	if (_threads.size() > 0 || _workers.empty() || num_streams <= 0)
+		return false;
+
+	_streams = std::vector<Stream>(num_streams);
+	_next_stream = 0;
+	_handler = std::move(handler);
+	_stop = false;
+	for (size_t i = 0; i < _workers.size(); i++)
+		_threads.emplace_back([this, &worker = *_workers[i], i]() { WorkerThread(worker, int(i)); });
+	return true;
+}
+
+void DetectorPool::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		_stop = true;
+	}
+	_cv.notify_all();
+	for (std::thread& thread : _threads)
+		thread.join();
+	_threads.clear();
+}
+
+std::unique_ptr<DetectorPool::Job> DetectorPool::NewJob()
+{
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		if (_free_jobs.size() > 0)
+		{
+			std::unique_ptr<Job> job = std::move(_free_jobs.back());
+			_free_jobs.pop_back();
+			return job;
+		}
+	}
+	return std::make_unique<Job>();
+}
+
+int DetectorPool::TakeStream()
+{
+	for (size_t i = 0; i < _streams.size(); i++)
+	{
+		size_t index = (_next_stream + i) % _streams.size();
+		if (_streams[index].waiting)
+		{
+			_next_stream = index + 1;
+			return int(index);
+		}
+	}
+	return -1;
+}
+
+void DetectorPool::WorkerThread(Worker& worker, int worker_index)
+{
+	if (!util::SetCurrentThreadScheduling(_thread_scheduling))
+		std::cout << "Failed to set the scheduling of an OCR thread" << std::endl;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (1)
+	{
+		int stream_index;
+		_cv.wait(lock, [this, &stream_index] { return _stop || (stream_index = TakeStream()) >= 0; });
+		if (_stop)
+			break;
+
+		// the deque doesn't move its elements when the front is popped or new jobs are pushed, so the entry stays valid
+		Stream& stream = _streams[stream_index];
+		std::pair<JobState, std::unique_ptr<Job>>& entry = *stream.waiting;
+		stream.waiting = nullptr;
+		if (_deadline.count() > 0 && std::chrono::steady_clock::now() - entry.second->frame_time > _deadline)
+		{
+			entry.first = JobState::Dropped;
+			stream.num_stale++;
+		}
+		else
+		{
+			entry.first = JobState::Processing;
+			stream.num_processed++;
+
+			lock.unlock();
+			Job& job = *entry.second;
+			job.worker_index = worker_index;
+			job.ocr_begin = std::chrono::steady_clock::now();
+			worker.hud_engine.DetectCandidates(job.frame(job.game_rect), job.candidates, job.events);
+			job.ocr_end = std::chrono::steady_clock::now();
+
+			// the lookups of an earlier job are still there if the location wasn't a candidate this time
+			job.match_spans.clear();
+			for (const LocationDetector::TimeSpan& span : worker.location_detector->LastMatchSpans())
+				if (span.begin >= job.ocr_begin)
+					job.match_spans.push_back(span);
+			lock.lock();
+
+			entry.first = JobState::Done;
+		}
+
+		lock.unlock();
+		ReportResults(stream_index);
+		lock.lock();
+	}
+}
+
+void DetectorPool::Submit(int stream_index, std::unique_ptr<Job> job)
+{
+	bool needs_worker = job->candidates.size() > 0;
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		Stream& stream = _streams[stream_index];
+		if (needs_worker)
+		{
+			if (stream.waiting)
+			{
+				stream.waiting->first = JobState::Dropped;
+				stream.num_dropped++;
+			}
+			stream.waiting = &stream.jobs.emplace_back(JobState::Waiting, std::move(job));
+		}
+		else
+		{
+			stream.jobs.emplace_back(JobState::Done, std::move(job));
+			stream.num_screened_out++;
+		}
+	}
+
+	if (needs_worker)
+		_cv.notify_one();
+	else
+		ReportResults(stream_index);
+}
+
+void DetectorPool::ReportResults(int stream_index)
+{
+	// taking the jobs off the stream and reporting them happen under the same lock, so that two threads can't report out of order
+	std::lock_guard<std::mutex> report_lock(_report_mutex);
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		Stream& stream = _streams[stream_index];
+		while (stream.jobs.size() > 0 && (stream.jobs.front().first == JobState::Done || stream.jobs.front().first == JobState::Dropped))
+		{
+			if (stream.jobs.front().first == JobState::Done)
+				_finished_jobs.push_back(std::move(stream.jobs.front().second));
+			else
+				_free_jobs.push_back(std::move(stream.jobs.front().second));
+			stream.jobs.pop_front();
+		}
+	}
+	if (_finished_jobs.empty())
+		return;
+
+	for (std::unique_ptr<Job>& job : _finished_jobs)
+		_handler(stream_index, *job);
+
+	std::lock_guard<std::mutex> lg(_mutex);
+	for (std::unique_ptr<Job>& job : _finished_jobs)
+		_free_jobs.push_back(std::move(job));
+	_finished_jobs.clear();
+}
+
+std::string DetectorPool::GetStreamReport()
+{
+	std::lock_guard<std::mutex> lg(_mutex);
+	std::ostringstream os;
+	for (size_t i = 0; i < _streams.size(); i++)
+	{
+		const Stream& stream = _streams[i];
+		os << "Stream " << i << ": " << stream.num_screened_out << " frames without OCR, " << stream.num_processed << " frames with OCR, "
+			<< stream.num_dropped << " replaced by newer frames, " << stream.num_stale << " past the deadline" << std::endl;
+	}
+	return os.str();
+}
+
+std::string DetectorPool::GetCascadeReport() const
+{
+	std::ostringstream os;
+	for (size_t i = 0; i < _workers.size(); i++)
+	{
+		os << "Worker " << i << ":" << std::endl;
+		os << _workers[i]->location_detector->GetCascadeReport();
+	}
+	return os.str();
+}
@@ -0,0 +1,131 @@
+#pragma once
+#include "common.h"
+#include "hud_engine.h"
+#include "location_detector.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <deque>
+#include <future>
+
+
+// A pool of OCR threads shared by several input streams.
+// The early-out (HudEngine::Screen()) runs inline on every frame, only frames with OCR candidates are handed to the pool as jobs.
+// Each worker has its own HUD engine (and so its own Tesseract instances), any worker can process any job.
+// A stream only keeps its newest job waiting, a job that hasn't been picked up when the next one arrives is dropped.
+// Workers take streams in round-robin order so that a busy stream can't starve the others.
+// Several workers can process jobs of the same stream at the same time, the results are reordered by frame number before they are handed out.
+class DetectorPool
+{
+public:
+	struct Worker
+	{
+		HudEngine hud_engine;
+		LocationDetector* location_detector = nullptr;		// owned by hud_engine
+	};
+
+	// one frame of a stream
+	struct Job
+	{
+		int frame_number = -1;
+		std::chrono::steady_clock::time_point frame_time;		// when the frame was captured
+		cv::Mat frame;						// only needed if there are candidates
+		cv::Rect game_rect;
+		std::vector<size_t> candidates;		// OCR-bound regions that passed the early-out
+		std::vector<HudEvent> events;		// events of the cheap regions, the worker adds the OCR results
+
+		// stage times for the latency trace
+		int64_t pts_us = -1;				// presentation time stamp of the frame in the stream
+		std::chrono::steady_clock::time_point arrival_time;		// when the packet of the frame was read
+		std::chrono::steady_clock::time_point screen_begin, screen_end;		// early-out
+		std::chrono::steady_clock::time_point ocr_begin, ocr_end;		// only set if there are candidates
+		std::vector<LocationDetector::TimeSpan> match_spans;		// location list lookups during the OCR
+		int worker_index = -1;
+	};
+
+	// registers the detectors of a new worker, returns false on failure
+	using WorkerInit = std::function<bool(Worker& worker)>;
+
+	// called with the finished jobs of each stream in frame order, from the thread that finished the job or the one that submitted it.
+	// Calls are serialized, even between streams
+	using ResultHandler = std::function<void(int stream, Job& job)>;
+
+private:
+	enum class JobState
+	{
+		Waiting,
+		Processing,
+		Done,
+		Dropped,
+	};
+
+	struct Stream
+	{
+		std::deque<std::pair<JobState, std::unique_ptr<Job>>> jobs;		// all unfinished and unreported jobs in frame order
+		std::pair<JobState, std::unique_ptr<Job>>* waiting = nullptr;		// the newest job waiting for a worker
+		uint64_t num_screened_out = 0;	// no OCR needed
+		uint64_t num_processed = 0;
+		uint64_t num_dropped = 0;		// replaced by a newer job before a worker was free
+		uint64_t num_stale = 0;			// older than the deadline when a worker was free
+	};
+
+	std::vector<std::unique_ptr<Worker>> _workers;
+	std::vector<std::thread> _threads;
+	std::vector<Stream> _streams;
+	size_t _next_stream = 0;			// where the round-robin search starts
+	std::vector<std::unique_ptr<Job>> _free_jobs;
+	ResultHandler _handler;
+	std::chrono::milliseconds _deadline{ 0 };
+	util::ThreadScheduling _thread_scheduling;
+
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	bool _stop = false;
+
+	std::mutex _report_mutex;			// serializes the result handler
+	std::vector<std::unique_ptr<Job>> _finished_jobs;
+
+private:
+	void WorkerThread(Worker& worker, int worker_index);
+
+	// find the next stream with a waiting job, _mutex must be locked
+	int TakeStream();
+
+	// hand the finished jobs at the front of the stream to the handler
+	void ReportResults(int stream);
+
+public:
+	DetectorPool() = default;
+	DetectorPool(const DetectorPool&) = delete;
+	DetectorPool& operator=(const DetectorPool&) = delete;
+	~DetectorPool();
+
+	// Jobs that are older than the deadline when a worker becomes free are dropped, since their result would come too late to be useful.
+	// 0 means no deadline. Has to be called before Start()
+	void SetDeadline(std::chrono::milliseconds deadline) { _deadline = deadline; }
+	void SetThreadScheduling(const util::ThreadScheduling& scheduling) { _thread_scheduling = scheduling; }
+
+	// Load more workers before Start(), they are initialized in parallel since each loads its own OCR models.
+	// Nothing is added if any of them fails
+	bool AddWorkers(int num_workers, const WorkerInit& init);
+
+	bool Start(int num_streams, ResultHandler handler);
+	void Stop();
+
+	// get an unused job, its buffers are reused from earlier jobs
+	std::unique_ptr<Job> NewJob();
+
+	// Hand a new frame of a stream to the pool, frame numbers have to increase.
+	// A job without candidates doesn't need a worker, it's reported as soon as the jobs before it are
+	void Submit(int stream, std::unique_ptr<Job> job);
+
+	int NumWorkers() const { return int(_workers.size()); }
+
+	// processed / dropped frame counts of each stream
+	std::string GetStreamReport();
+
+	// OCR statistics of all workers
+	std::string GetCascadeReport() const;
+};
@@ -1,6 +1,7 @@
 #include "common.h"
 #include "ffmpeg_wrap.h"
 #include <iostream>
+#include <algorithm>
 
 extern "C" {
 #pragma warning(push)
@@ -22,12 +23,151 @@ extern "C" {
 #pragma comment(lib, "swresample.lib")
 #pragma comment(lib, "swscale.lib")
 
-std::thread FFmpegWrap::s_capture_thread;
-bool FFmpegWrap::s_end_capture_thread = false;
-std::vector<uint8_t> FFmpegWrap::s_buffer;
-int FFmpegWrap::s_width = 0, FFmpegWrap::s_height = 0;
-int FFmpegWrap::s_frame_index = 0;
-std::mutex FFmpegWrap::s_mutex;
+void FrameSignal::Notify()
+{
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		_count++;
+	}
+	_cv.notify_all();
+}
+
+uint64_t FrameSignal::Wait(uint64_t last_count, std::chrono::milliseconds timeout)
+{
+	std::unique_lock<std::mutex> lock(_mutex);
+	_cv.wait_for(lock, timeout, [this, last_count] { return _count != last_count; });
+	return _count;
+}
+
+FrameRecorder::~FrameRecorder()
+{
+	Close();
+}
+
+bool FrameRecorder::Open(const std::string& file_name, int width, int height)
+{
+	Close();
+
+	_ofs.open(file_name, std::ios::binary);
+	if (!_ofs.is_open())
+	{
+		std::cout << "Cannot open recording file " << file_name << std::endl;
+		return false;
+	}
+
+	RecordingHeader header;
+	header.width = width;
+	header.height = height;
+	_ofs.write((const char*)&header, sizeof(header));
+
+	_file_name = file_name;
+	_width = width;
+	_height = height;
+	_num_frames = 0;
+	_num_stalls = 0;
+	_num_written = 0;
+	_failed = false;
+	_end_threads = false;
+
+	// one thread compresses a 1080p frame slower than the camera delivers them
+	int num_threads = std::clamp(int(std::thread::hardware_concurrency()) / 4, 1, max_encode_threads);
+	for (int i = 0; i < num_threads; i++)
+		_threads.emplace_back(&FrameRecorder::EncodeThread, this);
+	return true;
+}
+
+void FrameRecorder::EncodeThread()
+{
+	// fast compression, the files are still less than half the size of raw pixels
+	const std::vector<int> png_params = { cv::IMWRITE_PNG_COMPRESSION, 1 };
+	std::vector<uint8_t> png;
+
+	std::unique_lock<std::mutex> lock(_mutex);
+	while (1)
+	{
+		_cv.wait(lock, [this]() { return _queue.size() > 0 || _end_threads; });
+		if (_queue.empty())
+			break;
+
+		Frame frame = std::move(_queue.front());
+		_queue.pop_front();
+		lock.unlock();
+		bool encoded = !_failed && cv::imencode(".png", frame.pixels, png, png_params);
+
+		// the frames are written in the order they were captured
+		lock.lock();
+		_written_cv.wait(lock, [this, &frame]() { return _num_written == frame.index; });
+		if (!_failed)
+		{
+			if (encoded)
+			{
+				uint32_t png_size = uint32_t(png.size());
+				_ofs.write((const char*)&frame.arrival_ns, sizeof(frame.arrival_ns));
+				_ofs.write((const char*)&png_size, sizeof(png_size));
+				_ofs.write((const char*)png.data(), png.size());
+			}
+			if (!encoded || !_ofs.good())
+			{
+				_failed = true;
+				std::cout << "Writing the recording " << _file_name << " failed at frame " << frame.index << ", the rest of the session is not recorded" << std::endl;
+			}
+		}
+		_num_written++;
+		_free_buffers.push_back(std::move(frame.pixels));
+		_written_cv.notify_all();
+	}
+}
+
+void FrameRecorder::Close()
+{
+	if (_threads.empty())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		_end_threads = true;
+	}
+	_cv.notify_all();
+	for (std::thread& thread : _threads)
+		thread.join();
+	_threads.clear();
+	_ofs.close();
+	_free_buffers.clear();
+}
+
+void FrameRecorder::Add(const uint8_t* bgr, std::chrono::steady_clock::time_point arrival_time)
+{
+	if (_failed)
+		return;
+	if (_num_frames == 0)
+		_first_frame_time = arrival_time;
+
+	Frame frame;
+	frame.index = _num_frames++;
+	frame.arrival_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(arrival_time - _first_frame_time).count();
+	{
+		// wait for the recorder rather than leave a frame out of the recording
+		std::unique_lock<std::mutex> lock(_mutex);
+		if (frame.index - _num_written >= max_queued_frames)
+		{
+			_num_stalls++;
+			_written_cv.wait(lock, [this, &frame]() { return frame.index - _num_written < max_queued_frames; });
+		}
+		if (_free_buffers.size() > 0)
+		{
+			frame.pixels = std::move(_free_buffers.back());
+			_free_buffers.pop_back();
+		}
+	}
+
+	frame.pixels.create(_height, _width, CV_8UC3);
+	memcpy(frame.pixels.data, bgr, frame.pixels.total() * frame.pixels.elemSize());
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		_queue.push_back(std::move(frame));
+	}
+	_cv.notify_one();
+}
 
 void FFmpegWrap::Init()
 {
@@ -68,31 +208,177 @@ std::vector<std::string> FFmpegWrap::ListCameras()
 	return ret;
 }
 
+namespace
+{
+	// Packets of a network stream, read on a thread of their own so that the decoder can tell when newer data is already waiting
+	class PacketQueue
+	{
+	public:
+		struct Entry
+		{
+			AVPacket* packet = nullptr;
+			std::chrono::steady_clock::time_point arrival_time;
+		};
+
+		// about 2 seconds of video, more means the decoder can't keep up
+		static constexpr size_t max_packets = 120;
+
+	private:
+		std::mutex _mutex;
+		std::condition_variable _cv;
+		std::deque<Entry> _entries;
+		bool _ended = false;
+		bool _drop_until_keyframe = false;
+		bool _flush_pending = false;
+		uint64_t _num_dropped = 0;
+
+	public:
+		~PacketQueue()
+		{
+			for (Entry& entry : _entries)
+				av_packet_free(&entry.packet);
+		}
+
+		// takes the ownership of packet
+		void Push(AVPacket* packet, std::chrono::steady_clock::time_point arrival_time)
+		{
+			{
+				std::lock_guard<std::mutex> lg(_mutex);
+				if (_entries.size() >= max_packets)
+				{
+					// drop the backlog and start again from the next keyframe, the frames in between can't be decoded
+					_num_dropped += _entries.size();
+					for (Entry& entry : _entries)
+						av_packet_free(&entry.packet);
+					_entries.clear();
+					_drop_until_keyframe = true;
+					_flush_pending = true;
+				}
+				if (_drop_until_keyframe && !(packet->flags & AV_PKT_FLAG_KEY))
+				{
+					_num_dropped++;
+					av_packet_free(&packet);
+					return;
+				}
+				_drop_until_keyframe = false;
+				_entries.push_back({ packet, arrival_time });
+			}
+			_cv.notify_one();
+		}
+
+		void End()
+		{
+			{
+				std::lock_guard<std::mutex> lg(_mutex);
+				_ended = true;
+			}
+			_cv.notify_one();
+		}
+
+		// Wait for the next packet, returns false at the end of the stream.
+		// flush is set if packets were dropped before this one, the decoder has to be flushed then
+		bool Pop(Entry& entry, bool& flush)
+		{
+			std::unique_lock<std::mutex> lock(_mutex);
+			_cv.wait(lock, [this]() { return _entries.size() > 0 || _ended; });
+			if (_entries.empty())
+				return false;
+			entry = _entries.front();
+			_entries.pop_front();
+			flush = _flush_pending;
+			_flush_pending = false;
+			return true;
+		}
+
+		// the decoder rejected a packet, skip to the next keyframe. The decoder is flushed by the caller
+		void DropUntilKeyframe()
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			while (_entries.size() > 0 && !(_entries.front().packet->flags & AV_PKT_FLAG_KEY))
+			{
+				_num_dropped++;
+				av_packet_free(&_entries.front().packet);
+				_entries.pop_front();
+			}
+			_drop_until_keyframe = _entries.empty();
+		}
+
+		bool HasPackets()
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			return _entries.size() > 0;
+		}
+
+		uint64_t NumDropped()
+		{
+			std::lock_guard<std::mutex> lg(_mutex);
+			return _num_dropped;
+		}
+	};
+}
+
+bool FFmpegWrap::IsStreamUrl(const std::string& name)
+{
+	return name.find("://") != std::string::npos;
+}
+
 bool FFmpegWrap::CaptureCamera(const std::string& cam_name)
+{
+	avdevice_register_all();
+
+	// Find the input format
+	const AVInputFormat* inputFormat = av_find_input_format("dshow");
+	if (!inputFormat) {
+		std::cout << "Could not find input format dshow" << std::endl;
+		return false;
+	}
+
+	return CaptureInput(inputFormat, "video=" + cam_name, cam_name, false);
+}
+
+bool FFmpegWrap::CaptureStream(const std::string& url)
+{
+	avformat_network_init();
+	return CaptureInput(nullptr, url, url, true);
+}
+
+bool FFmpegWrap::CaptureInput(const AVInputFormat* inputFormat, const std::string& input_name, const std::string& display_name, bool network)
 {
 	AVFormatContext* inputFormatContext = NULL;
-	const AVInputFormat* inputFormat = NULL;
 	AVPacket* packet = NULL;
 	AVFrame* frame = NULL;
 	AVCodecContext* codecContext = NULL;
 	const AVCodec* codec = NULL;
 	int videoStreamIndex = -1;
 
-	avdevice_register_all();
-
-	// Find the input format
-	inputFormat = av_find_input_format("dshow");
-	if (!inputFormat) {
-		std::cout << "Could not find input format dshow" << std::endl;
+	// the stop flag interrupts a read that is waiting for the network
+	inputFormatContext = avformat_alloc_context();
+	if (!inputFormatContext) {
+		std::cout << "Could not allocate format context" << std::endl;
 		return false;
 	}
+	inputFormatContext->interrupt_callback.callback = [](void* opaque) -> int { return ((FFmpegWrap*)opaque)->_end_capture_thread ? 1 : 0; };
+	inputFormatContext->interrupt_callback.opaque = this;
+
+	// Network streams: start decoding as soon as the codec is known instead of buffering to analyse the stream,
+	// and give up on a sender that stopped sending. Options of the protocol (e.g. the SRT latency) can be added to the URL
+	AVDictionary* options = NULL;
+	if (network) {
+		av_dict_set(&options, "probesize", "32768", 0);
+		av_dict_set(&options, "analyzeduration", "500000", 0);
+		av_dict_set(&options, "fflags", "nobuffer", 0);
+		av_dict_set(&options, "flags", "low_delay", 0);
+		av_dict_set(&options, "rw_timeout", "5000000", 0);
+		av_dict_set(&options, "overrun_nonfatal", "1", 0);
+	}
 
-	// Open the input device
-	int averror = avformat_open_input(&inputFormatContext, ("video=" + cam_name).c_str(), inputFormat, NULL);
+	// Open the input
+	int averror = avformat_open_input(&inputFormatContext, input_name.c_str(), inputFormat, &options);
+	av_dict_free(&options);
 	if (averror != 0) {
 		char buf[1000];
 		av_strerror(averror, buf, 1000);
-		std::cout << "Could not open input device \"" << cam_name << "\": " << buf << std::endl;
+		std::cout << "Could not open input \"" << display_name << "\": " << buf << std::endl;
 		return false;
 	}
 
@@ -131,6 +417,14 @@ bool FFmpegWrap::CaptureCamera(const std::string& cam_name)
 		return false;
 	}
 
+	// Output each frame as soon as it's decoded, without waiting for B-frames to reorder (the sender shouldn't use any)
+	// or for frame threads to fill up, slice threads don't add a delay
+	if (network) {
+		codecContext->flags |= AV_CODEC_FLAG_LOW_DELAY;
+		codecContext->flags2 |= AV_CODEC_FLAG2_FAST;
+		codecContext->thread_type = FF_THREAD_SLICE;
+	}
+
 	// Open the codec
 	if (avcodec_open2(codecContext, codec, NULL) < 0) {
 		std::cout << "Could not open codec" << std::endl;
@@ -149,82 +443,339 @@ bool FFmpegWrap::CaptureCamera(const std::string& cam_name)
 		return false;
 	}
 
-	constexpr int WIDTH = 1280;
-	constexpr int HEIGHT = 720;
-	struct SwsContext* swsContext = sws_getContext(codecContext->width, codecContext->height, codecContext->pix_fmt, WIDTH, HEIGHT, AV_PIX_FMT_BGR24, SWS_BICUBIC, NULL, NULL, NULL);
-	if (!swsContext) {
-		std::cout << "Could not create sws context" << std::endl;
+	_decoded_frame = av_frame_alloc();
+	if (!_decoded_frame) {
+		std::cout << "Could not allocate frame" << std::endl;
 		return false;
 	}
 
-	AVFrame* rgbFrame = av_frame_alloc();
-	if (!rgbFrame) {
-		std::cout << "Could not allocate RGB frame" << std::endl;
+	constexpr int WIDTH = 1280;
+	constexpr int HEIGHT = 720;
+	int numBytes = av_image_get_buffer_size(AV_PIX_FMT_BGR24, WIDTH, HEIGHT, 1);
+	_buffer.resize(numBytes);
+	_converted_index = 0;
+
+	_height = HEIGHT;
+	_width = WIDTH;
+	_end_capture_thread = false;
+	_capture_ended = false;
+	_wait_for_consumer = false;
+	_num_late_frames = 0;
+	_num_dropped_packets = 0;
+	_num_bad_packets = 0;
+
+	if (_record_file.size() && !_recorder.Open(_record_file, WIDTH, HEIGHT))
 		return false;
-	}
 
-	int numBytes = av_image_get_buffer_size(AV_PIX_FMT_BGR24, WIDTH, HEIGHT, 1);
-	s_buffer.resize(numBytes);
-	av_image_fill_arrays(rgbFrame->data, rgbFrame->linesize, &s_buffer[0], AV_PIX_FMT_BGR24, WIDTH, HEIGHT, 1);
-
-	s_height = HEIGHT;
-	s_width = WIDTH;
-
-	s_capture_thread = std::thread([videoStreamIndex, swsContext] (AVFormatContext *inputFormatContext, AVPacket *packet, AVCodecContext *codecContext, AVFrame *frame, AVFrame *rgbFrame){
-		s_frame_index = 0;
-		while (!s_end_capture_thread && av_read_frame(inputFormatContext, packet) >= 0) {
-			if (packet->stream_index == videoStreamIndex) {
-				int ret = avcodec_send_packet(codecContext, packet);
-				if (ret < 0) {
-					std::cout << "Error sending packet to decoder" << std::endl;
+	AVRational time_base = inputFormatContext->streams[videoStreamIndex]->time_base;
+	_capture_thread = std::thread([this, videoStreamIndex, time_base, network] (AVFormatContext *inputFormatContext, AVPacket *packet, AVCodecContext *codecContext, AVFrame *frame){
+		_frame_index = 0;
+		if (!util::SetCurrentThreadScheduling(_thread_scheduling))
+			std::cout << "Failed to set the scheduling of the capture thread" << std::endl;
+
+		// Decode one packet. If newer packets are already waiting, the frames of this one are decoded but not converted,
+		// so that after a burst of late packets the newest frame comes out first
+		auto decode_packet = [&](AVPacket* packet, std::chrono::steady_clock::time_point arrival_time, bool newer_waiting) {
+			int ret = avcodec_send_packet(codecContext, packet);
+			if (ret < 0) {
+				std::cout << "Error sending packet to decoder" << std::endl;
+				return false;
+			}
+			while (ret >= 0) {
+				ret = avcodec_receive_frame(codecContext, frame);
+				if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+					break;
+				}
+				else if (ret < 0) {
+					std::cout << "Error decoding frame" << std::endl;
 					break;
 				}
-				while (ret >= 0) {
-					ret = avcodec_receive_frame(codecContext, frame);
-					if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
-						break;
-					}
-					else if (ret < 0) {
-						std::cout << "Error decoding frame" << std::endl;
-						break;
-					}
 
-					// If we have a decoded frame, do something with it
-					if (ret == 0) {
-						std::lock_guard<std::mutex> lg(s_mutex);
-						sws_scale(swsContext, (const uint8_t* const*)frame->data, frame->linesize, 0, codecContext->height, rgbFrame->data, rgbFrame->linesize);
-						s_frame_index++;
-					}
+				if (newer_waiting) {
+					_num_late_frames++;
+					continue;
 				}
+
+				// If we have a decoded frame, keep it until it's taken or replaced. It's only converted when it's taken,
+				// except for the recording, which needs every frame
+				{
+					std::lock_guard<std::mutex> lg(_mutex);
+					av_frame_unref(_decoded_frame);
+					av_frame_move_ref(_decoded_frame, frame);
+					_frame_timing.pts_us = _decoded_frame->best_effort_timestamp != AV_NOPTS_VALUE ? av_rescale_q(_decoded_frame->best_effort_timestamp, time_base, av_get_time_base_q()) : -1;
+					_frame_timing.arrival_time = arrival_time;
+					_frame_timing.frame_time = std::chrono::steady_clock::now();
+					_frame_index++;
+					if (_recorder.IsOpen() && ConvertDecodedFrame())
+						_recorder.Add(&_buffer[0], arrival_time);
+				}
+				if (_frame_signal)
+					_frame_signal->Notify();
 			}
+			return true;
+		};
 
-			av_packet_unref(packet);
+		if (!network) {
+			// a local device delivers one frame at a time, there's never a backlog
+			while (!_end_capture_thread && av_read_frame(inputFormatContext, packet) >= 0) {
+				bool decoded = packet->stream_index != videoStreamIndex || decode_packet(packet, std::chrono::steady_clock::now(), false);
+				av_packet_unref(packet);
+				if (!decoded)
+					break;
+			}
+		}
+		else {
+			// network packets are read on another thread, so that the decoder sees when they come in faster than it decodes
+			PacketQueue queue;
+			std::thread reader_thread([&]() {
+				while (!_end_capture_thread && av_read_frame(inputFormatContext, packet) >= 0) {
+					if (packet->stream_index == videoStreamIndex)
+						queue.Push(av_packet_clone(packet), std::chrono::steady_clock::now());
+					av_packet_unref(packet);
+				}
+				queue.End();
+			});
+
+			// a packet the decoder rejects, e.g. after packet loss, only costs the frames up to the next keyframe.
+			// The stream ends when the decoder keeps rejecting packets even after that
+			constexpr int max_decode_errors = 10;
+			int num_decode_errors = 0;
+			PacketQueue::Entry entry;
+			bool flush;
+			while (queue.Pop(entry, flush)) {
+				if (flush)
+					avcodec_flush_buffers(codecContext);
+				bool decoded = decode_packet(entry.packet, entry.arrival_time, queue.HasPackets());
+				av_packet_free(&entry.packet);
+				if (decoded)
+					num_decode_errors = 0;
+				else {
+					_num_bad_packets++;
+					if (++num_decode_errors >= max_decode_errors) {
+						std::cout << "The decoder rejected " << num_decode_errors << " packets in a row, the stream ends" << std::endl;
+						_end_capture_thread = true;
+					}
+					else {
+						avcodec_flush_buffers(codecContext);
+						queue.DropUntilKeyframe();
+					}
+				}
+				_num_dropped_packets = queue.NumDropped();
+				if (_end_capture_thread)
+					break;
+			}
+			reader_thread.join();
 		}
 
-		sws_freeContext(swsContext);
-		av_frame_free(&rgbFrame);
 		av_packet_free(&packet);
 		av_frame_free(&frame);
 		avcodec_free_context(&codecContext);
 		avformat_close_input(&inputFormatContext);
-	}, inputFormatContext, packet, codecContext, frame, rgbFrame);
+		_recorder.Close();
+
+		_capture_ended = true;
+		if (_frame_signal)
+			_frame_signal->Notify();
+	}, inputFormatContext, packet, codecContext, frame);
 
 	return true;
 }
 
-int FFmpegWrap::GetLatestFrame(int lastFrame, cv::Mat &mat)
+bool FFmpegWrap::ReplayRecording(const std::string& file_name, bool realtime)
 {
-	if (lastFrame == s_frame_index)
+	std::ifstream ifs(file_name, std::ios::binary);
+	if (!ifs.is_open())
+	{
+		std::cout << "Cannot open recording " << file_name << std::endl;
+		return false;
+	}
+
+	FrameRecorder::RecordingHeader header, expected_header;
+	if (!ifs.read((char*)&header, sizeof(header)) || memcmp(header.magic, expected_header.magic, sizeof(header.magic)) != 0 || header.version != expected_header.version
+		|| header.width <= 0 || header.height <= 0)
+	{
+		std::cout << file_name << " is not a recording of a supported version" << std::endl;
+		return false;
+	}
+
+	_width = header.width;
+	_height = header.height;
+	_buffer.resize(size_t(_width) * _height * 3);
+	_end_capture_thread = false;
+	_capture_ended = false;
+	_wait_for_consumer = !realtime;
+	_taken_index = 0;
+
+	_capture_thread = std::thread([this, realtime](std::ifstream ifs) {
+		_frame_index = 0;
+		if (!util::SetCurrentThreadScheduling(_thread_scheduling))
+			std::cout << "Failed to set the scheduling of the capture thread" << std::endl;
+
+		// read ahead into a second buffer, and swap it in when the frame is due
+		std::vector<uint8_t> next_frame(_buffer.size());
+		std::vector<uint8_t> png;
+		cv::Mat decoded;
+		auto start_time = std::chrono::steady_clock::now();
+		int64_t arrival_ns;
+		uint32_t png_size;
+		while (!_end_capture_thread && ifs.read((char*)&arrival_ns, sizeof(arrival_ns)) && ifs.read((char*)&png_size, sizeof(png_size)))
+		{
+			png.resize(png_size);
+			if (!ifs.read((char*)png.data(), png.size()))
+				break;
+			decoded = cv::imdecode(png, cv::IMREAD_COLOR);
+			if (decoded.cols != _width || decoded.rows != _height || !decoded.isContinuous())
+			{
+				std::cout << "Frame " << _frame_index << " of the recording can't be decoded, the playback ends there" << std::endl;
+				break;
+			}
+			memcpy(next_frame.data(), decoded.data, next_frame.size());
+
+			if (realtime)
+				std::this_thread::sleep_until(start_time + std::chrono::nanoseconds(arrival_ns));
+
+			{
+				std::unique_lock<std::mutex> lock(_mutex);
+				if (_wait_for_consumer)
+				{
+					_frame_taken_cv.wait(lock, [this]() { return _taken_index == _frame_index || _end_capture_thread; });
+					if (_end_capture_thread)
+						break;
+				}
+				_buffer.swap(next_frame);
+				_frame_timing.pts_us = arrival_ns / 1000;
+				_frame_timing.arrival_time = _frame_timing.frame_time = std::chrono::steady_clock::now();
+				_frame_index++;
+			}
+			if (_frame_signal)
+				_frame_signal->Notify();
+		}
+
+		_capture_ended = true;
+		if (_frame_signal)
+			_frame_signal->Notify();
+	}, std::move(ifs));
+
+	return true;
+}
+
+bool FFmpegWrap::CaptureSharedMemory(const std::string& name)
+{
+	if (!_shared_frames.Open(name))
+		return false;
+
+	_end_capture_thread = false;
+	_capture_ended = false;
+	_capture_thread = std::thread([this]() {
+		_frame_index = 0;
+		if (!util::SetCurrentThreadScheduling(_thread_scheduling))
+			std::cout << "Failed to set the scheduling of the capture thread" << std::endl;
+
+		// nothing to decode or convert here, the signal of the producer is only passed on. The timeout is there to check the end flags
+		while (!_end_capture_thread && !_shared_frames.IsClosed())
+		{
+			if (!_shared_frames.WaitForFrame(std::chrono::milliseconds(100)))
+				continue;
+			_frame_index = int(_shared_frames.LatestSequence());
+			if (_frame_signal)
+				_frame_signal->Notify();
+		}
+
+		_capture_ended = true;
+		if (_frame_signal)
+			_frame_signal->Notify();
+	});
+
+	return true;
+}
+
+bool FFmpegWrap::ConvertDecodedFrame()
+{
+	if (_converted_index == _frame_index)
+		return true;
+
+	// the scaler is made for the first decoded frame, the size in the stream info isn't always known with the small probe of network streams
+	_sws_context = sws_getCachedContext(_sws_context, _decoded_frame->width, _decoded_frame->height, (AVPixelFormat)_decoded_frame->format,
+		_width, _height, AV_PIX_FMT_BGR24, SWS_BICUBIC, NULL, NULL, NULL);
+	if (!_sws_context) {
+		std::cout << "Could not create sws context" << std::endl;
+		return false;
+	}
+	uint8_t* dst_data[1] = { &_buffer[0] };
+	int dst_linesize[1] = { _width * 3 };
+	sws_scale(_sws_context, (const uint8_t* const*)_decoded_frame->data, _decoded_frame->linesize, 0, _decoded_frame->height, dst_data, dst_linesize);
+	_converted_index = _frame_index;
+	return true;
+}
+
+int FFmpegWrap::GetLatestFrame(int lastFrame, cv::Mat &mat, FrameTiming *timing)
+{
+	if (lastFrame == _frame_index)
 		return lastFrame;
-	if (mat.cols != s_width || mat.rows != s_height || mat.type() != CV_8UC3)
-		mat = cv::Mat(s_height, s_width, CV_8UC3);
-	std::lock_guard<std::mutex> lg(s_mutex);
-	memcpy(mat.ptr(), &s_buffer[0], s_height * s_width * 3);
-	return s_frame_index;
+
+	if (_shared_frames.IsOpen())
+	{
+		int64_t timestamp_us = 0;
+		int frame_index = int(_shared_frames.ReadLatest(lastFrame, mat, timestamp_us));
+		if (frame_index != lastFrame && timing)
+		{
+			// the capture time of the producer on the steady clock, so that the latency includes the time before the frame got here
+			timing->frame_time = std::chrono::steady_clock::now();
+			int64_t now_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+			int64_t age_us = timestamp_us > 0 ? std::max<int64_t>(now_us - timestamp_us, 0) : 0;
+			timing->arrival_time = timing->frame_time - std::chrono::microseconds(age_us);
+			timing->pts_us = timestamp_us > 0 ? timestamp_us : -1;
+		}
+		return frame_index;
+	}
+
+	if (mat.cols != _width || mat.rows != _height || mat.type() != CV_8UC3)
+		mat = cv::Mat(_height, _width, CV_8UC3);
+	int frame_index;
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		if (_decoded_frame && !ConvertDecodedFrame())
+			return lastFrame;
+		memcpy(mat.ptr(), &_buffer[0], _height * _width * 3);
+		if (timing)
+			*timing = _frame_timing;
+		frame_index = _frame_index;
+		_taken_index = frame_index;
+	}
+	if (_wait_for_consumer)
+		_frame_taken_cv.notify_one();
+	return frame_index;
 }
 
 void FFmpegWrap::StopCapture()
 {
-	s_end_capture_thread = true;
-	s_capture_thread.join();
+	if (!_capture_thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		_end_capture_thread = true;
+	}
+	_frame_taken_cv.notify_one();
+	_capture_thread.join();
+	_shared_frames.Close();
+	av_frame_free(&_decoded_frame);
+	sws_freeContext(_sws_context);
+	_sws_context = nullptr;
+}
+
+void FFmpegWrap::SkipFrame(int frameIndex)
+{
+	{
+		std::lock_guard<std::mutex> lg(_mutex);
+		_taken_index = frameIndex;
+	}
+	if (_wait_for_consumer)
+		_frame_taken_cv.notify_one();
+}
+
+FFmpegWrap::~FFmpegWrap()
+{
+	StopCapture();
+	av_frame_free(&_decoded_frame);
+	sws_freeContext(_sws_context);
 }
\ No newline at end of file
@@ -3,21 +3,195 @@
 #include <string>
 #include <vector>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <fstream>
+#include <deque>
+#include "shared_frames.h"
 
+struct AVInputFormat;
+struct AVFrame;
+struct SwsContext;
+
+
+// Wakes up a consumer when a new frame is captured, one signal can be shared by several captures
+class FrameSignal
+{
+private:
+	std::mutex _mutex;
+	std::condition_variable _cv;
+	uint64_t _count = 0;
+public:
+	void Notify();
+
+	// wait until Notify() has been called since Wait() returned last_count, or until timeout. Returns the current count
+	uint64_t Wait(uint64_t last_count, std::chrono::milliseconds timeout);
+};
+
+// Saves captured frames with their arrival times, so that a live session can be replayed with FFmpegWrap::ReplayRecording().
+// The file is a RecordingHeader followed by the frames, each as its arrival time in nanoseconds since the first frame (int64_t),
+// the size of its PNG (uint32_t) and the PNG of its BGR pixels. PNG is lossless, so the replay detects on exactly the captured pixels.
+// The frames are compressed on a few threads of their own and written in order. No frame is left out: if the compression or the disk
+// can't keep up the capture waits for room in the queue, and if writing fails the recording stops with a message.
+class FrameRecorder
+{
+public:
+	struct RecordingHeader
+	{
+		char magic[4] = { 'H', 'R', 'T', 'R' };
+		uint32_t version = 2;
+		int32_t width = 0;
+		int32_t height = 0;
+	};
+
+private:
+	struct Frame
+	{
+		uint64_t index;
+		int64_t arrival_ns;
+		cv::Mat pixels;
+	};
+	static constexpr size_t max_queued_frames = 60;
+	static constexpr int max_encode_threads = 4;
+
+	std::ofstream _ofs;
+	std::string _file_name;
+	int _width = 0, _height = 0;
+	std::chrono::steady_clock::time_point _first_frame_time;
+	uint64_t _num_frames = 0;
+	uint64_t _num_stalls = 0;
+	std::atomic<bool> _failed = false;
+
+	std::vector<std::thread> _threads;
+	std::mutex _mutex;
+	std::condition_variable _cv;			// a frame was queued, or the threads should end
+	std::condition_variable _written_cv;	// a frame was written, so there is room in the queue and the next one can be written
+	std::deque<Frame> _queue;
+	std::vector<cv::Mat> _free_buffers;
+	uint64_t _num_written = 0;
+	bool _end_threads = false;
+
+	void EncodeThread();
+
+public:
+	FrameRecorder() = default;
+	FrameRecorder(const FrameRecorder&) = delete;
+	FrameRecorder& operator=(const FrameRecorder&) = delete;
+	~FrameRecorder();
+
+	bool Open(const std::string& file_name, int width, int height);
+	// writes the frames that are still queued
+	void Close();
+	bool IsOpen() const { return !_threads.empty(); }
+
+	// copies the pixels, called from the capture thread. Waits while the queue is full
+	void Add(const uint8_t* bgr, std::chrono::steady_clock::time_point arrival_time);
+
+	uint64_t NumFrames() const { return _num_frames; }
+	// frames the capture had to wait for the recorder, the capture may have fallen behind the camera then
+	uint64_t NumStalls() const { return _num_stalls; }
+	// writing failed, the recording ends with the frames before that
+	bool Failed() const { return _failed; }
+};
 
 class FFmpegWrap
 {
+public:
+	// where a frame came from and when, for latency tracing
+	struct FrameTiming
+	{
+		int64_t pts_us = -1;			// presentation time stamp of the stream in microseconds, -1 if there is none
+		std::chrono::steady_clock::time_point arrival_time;		// when the packet of the frame was read from the device
+		std::chrono::steady_clock::time_point frame_time;		// when the frame was decoded
+	};
+
+private:
+	std::thread _capture_thread;
+	std::atomic<bool> _end_capture_thread = false;
+	std::vector<uint8_t> _buffer;
+	int _width = 0, _height = 0;
+	std::atomic<int> _frame_index = 0;
+	FrameTiming _frame_timing;		// of the latest frame
+	std::mutex _mutex;
+	FrameSignal* _frame_signal = nullptr;
+	util::ThreadScheduling _thread_scheduling;
+	std::atomic<bool> _capture_ended = false;
+
+	std::string _record_file;
+	FrameRecorder _recorder;
+
+	// as-fast-as-possible replay waits until the consumer took the previous frame
+	bool _wait_for_consumer = false;
+	int _taken_index = 0;
+	std::condition_variable _frame_taken_cv;
+
+	// frames of a local producer, GetLatestFrame() reads them straight from the ring buffer
+	SharedFrameReader _shared_frames;
+
+	// FFmpeg inputs: the latest decoded frame, converted into _buffer when it's taken, so that frames replaced before that are never converted
+	AVFrame* _decoded_frame = nullptr;
+	SwsContext* _sws_context = nullptr;
+	int _converted_index = 0;		// frame index of the pixels in _buffer
+
+	// network streams: decoded frames that were skipped for a newer one, packets dropped because the decoder fell behind or up to the
+	// keyframe after a bad packet, and packets the decoder rejected
+	std::atomic<uint64_t> _num_late_frames = 0;
+	std::atomic<uint64_t> _num_dropped_packets = 0;
+	std::atomic<uint64_t> _num_bad_packets = 0;
+
 private:
-	static std::thread s_capture_thread;
-	static bool s_end_capture_thread;
-	static std::vector<uint8_t> s_buffer;
-	static int s_width, s_height;
-	static int s_frame_index;
-	static std::mutex s_mutex;
+	bool CaptureInput(const AVInputFormat* inputFormat, const std::string& input_name, const std::string& display_name, bool network);
+	// called with _mutex locked
+	bool ConvertDecodedFrame();
+
 public:
+	FFmpegWrap() = default;
+	FFmpegWrap(const FFmpegWrap&) = delete;
+	FFmpegWrap& operator=(const FFmpegWrap&) = delete;
+	~FFmpegWrap();
+
 	static void Init();
 	static std::vector<std::string> ListCameras();
-	static bool CaptureCamera(const std::string& cam_name);
-	static int GetLatestFrame(int lastFrame, cv::Mat &mat);
-	static void StopCapture();
+
+	// have to be called before CaptureCamera()
+	void SetFrameSignal(FrameSignal* frame_signal) { _frame_signal = frame_signal; }
+	void SetThreadScheduling(const util::ThreadScheduling& scheduling) { _thread_scheduling = scheduling; }
+	// save the captured frames to a file for ReplayRecording()
+	void SetRecordFile(const std::string& file_name) { _record_file = file_name; }
+
+	bool CaptureCamera(const std::string& cam_name);
+
+	// Receive a stream over the network (e.g. srt://, udp:// MPEG-TS or rtmp://) with the demuxer and the decoder set for low latency.
+	// When packets arrive in a burst after a network stall, the frames before the newest are decoded but not converted
+	bool CaptureStream(const std::string& url);
+	// a name of a network stream rather than of a camera
+	static bool IsStreamUrl(const std::string& name);
+
+	// Play a file saved by the recorder as if it was a camera.
+	// With realtime the frames come with their original timing, otherwise each frame comes as soon as the previous one was taken by GetLatestFrame()
+	bool ReplayRecording(const std::string& file_name, bool realtime);
+
+	// Take the frames a local producer writes into a shared memory ring buffer, see shared_frames.h.
+	// The frame index is the sequence number of the producer
+	bool CaptureSharedMemory(const std::string& name);
+
+	// the camera stopped delivering frames or the recording reached its end, the latest frame can still be taken
+	bool CaptureEnded() const { return _capture_ended; }
+
+	// copy the latest frame to mat if it's newer than lastFrame, returns its index
+	int GetLatestFrame(int lastFrame, cv::Mat &mat, FrameTiming *timing = nullptr);
+	// index of the latest frame, without taking it
+	int LatestFrameIndex() const { return _frame_index; }
+	// pass on a frame without taking its pixels, an as-fast-as-possible replay goes on to the next one
+	void SkipFrame(int frameIndex);
+	void StopCapture();
+
+	// frames the capture waited for the recorder, and whether writing the recording failed
+	uint64_t NumRecordStalls() const { return _recorder.NumStalls(); }
+	bool RecordFailed() const { return _recorder.Failed(); }
+	uint64_t NumLateFrames() const { return _num_late_frames; }
+	uint64_t NumDroppedPackets() const { return _num_dropped_packets; }
+	uint64_t NumBadPackets() const { return _num_bad_packets; }
 };
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "frame_sampler.h"
+#include <iomanip>
+
+void FrameSampler::Init(std::chrono::milliseconds max_delay, double bright_pixel_ratio_low, double bright_pixel_ratio_high)
+{
+	_max_delay = max_delay;
+
+	// same band as the boxes kept by the analysis cache, frames in it are close to passing the early-out
+	_near_low = bright_pixel_ratio_low / 2.0;
+	_near_high = bright_pixel_ratio_high * 2.0;
+
+	_last_processed = -1;
+	_interval = 1;
+	_frame_period_ms = 0.0;
+	_cost_us = 0.0;
+	_num_processed = 0;
+	_num_skipped = 0;
+}
+
+int FrameSampler::MaxInterval() const
+{
+	// skipping interval - 1 frames delays a banner by that many frame periods at most
+	double frame_period_ms = _frame_period_ms;
+	if (frame_period_ms <= 0.0)
+		return 1;
+	return 1 + int(_max_delay.count() / frame_period_ms);
+}
+
+bool FrameSampler::ShouldProcess(int frame_number, std::chrono::steady_clock::time_point now)
+{
+	if (!IsEnabled())
+		return true;
+
+	if (_last_processed >= 0 && frame_number - _last_processed < _interval && now - _last_processed_time < _max_delay)
+	{
+		_num_skipped++;
+		return false;
+	}
+
+	if (_last_processed < 0)
+		_last_change_time = now;
+	else if (frame_number > _last_processed)
+	{
+		double period_ms = std::chrono::duration<double, std::milli>(now - _last_processed_time).count() / (frame_number - _last_processed);
+		_frame_period_ms = _frame_period_ms > 0.0 ? _frame_period_ms * 0.9 + period_ms * 0.1 : period_ms;
+	}
+	_last_processed = frame_number;
+	_last_processed_time = now;
+	return true;
+}
+
+void FrameSampler::Update(bool location_screened, double bright_pixel_ratio, bool passed, std::chrono::steady_clock::time_point now, std::chrono::microseconds cost)
+{
+	_num_processed++;
+	_cost_us = _cost_us > 0.0 ? _cost_us * 0.9 + cost.count() * 0.1 : double(cost.count());
+	if (!IsEnabled())
+		return;
+
+	// back to every frame as soon as a banner might be coming, slow down step by step once none has been near for a while
+	if (passed || !location_screened || (bright_pixel_ratio >= _near_low && bright_pixel_ratio <= _near_high))
+	{
+		_interval = 1;
+		_last_change_time = now;
+	}
+	else if (now - _last_change_time >= hold_time)
+	{
+		_interval = std::min(_interval * 2, MaxInterval());
+		_last_change_time = now;
+	}
+}
+
+std::string FrameSampler::GetReport() const
+{
+	std::ostringstream os;
+	double frame_period_ms = _frame_period_ms;
+	uint64_t num_processed = _num_processed, num_skipped = _num_skipped;
+	os << "every " << _interval << " frames";
+	if (frame_period_ms > 0.0)
+		os << " (" << std::fixed << std::setprecision(1) << 1000.0 / frame_period_ms / _interval << " fps)" << std::defaultfloat;
+	os << ", " << num_skipped << " of " << num_processed + num_skipped << " frames skipped, about " << std::fixed << std::setprecision(2)
+		<< SavedSeconds() << "s of processing saved" << std::defaultfloat;
+	return os.str();
+}
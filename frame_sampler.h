@@ -0,0 +1,56 @@
+#pragma once
+#include "common.h"
+#include <atomic>
+#include <chrono>
+
+
+// Adaptive frame sampling of a live stream, to save the conversion and the early-out of frames while no banner is near.
+// While the bright pixel ratio of the location box stays far from the early-out window, only every interval-th frame is processed.
+// The interval doubles after each second without a frame near the window, up to what max_delay allows at the frame rate of the stream.
+// A frame near the window, a black or loading screen, or a frame that passed the early-out brings the interval back to 1 at once,
+// and it stays there for a second.
+// A frame is always processed once max_delay has passed since the last processed one, so a banner is detected at most max_delay plus
+// one frame later than without sampling.
+class FrameSampler
+{
+private:
+	static constexpr std::chrono::milliseconds hold_time{ 1000 };
+
+	std::chrono::milliseconds _max_delay{ 0 };
+	double _near_low = 0.0, _near_high = 1.0;		// bright pixel ratios that count as near the window
+
+	int _last_processed = -1;
+	std::chrono::steady_clock::time_point _last_processed_time;
+	std::chrono::steady_clock::time_point _last_change_time;		// of the interval, or of the last frame near the window
+
+	// read by the stats provider of the server
+	std::atomic<int> _interval = 1;
+	std::atomic<double> _frame_period_ms = 0.0;		// average time between two captured frames
+	std::atomic<double> _cost_us = 0.0;				// average time to process a frame
+	std::atomic<uint64_t> _num_processed = 0;
+	std::atomic<uint64_t> _num_skipped = 0;
+
+private:
+	int MaxInterval() const;
+
+public:
+	// max_delay 0 processes every frame. The ratios are the early-out window
+	void Init(std::chrono::milliseconds max_delay, double bright_pixel_ratio_low, double bright_pixel_ratio_high);
+	bool IsEnabled() const { return _max_delay.count() > 0; }
+
+	// whether to process the latest frame of the stream, frame numbers increase
+	bool ShouldProcess(int frame_number, std::chrono::steady_clock::time_point now);
+
+	// after a processed frame: whether its location box was screened and its bright pixel ratio, whether any region passed the early-out,
+	// and how long taking and screening the frame took. A box that wasn't screened because a black or loading screen ended the
+	// screening counts as near the window, such screens often come just before a banner
+	void Update(bool location_screened, double bright_pixel_ratio, bool passed, std::chrono::steady_clock::time_point now, std::chrono::microseconds cost);
+
+	int Interval() const { return _interval; }
+	uint64_t NumSkipped() const { return _num_skipped; }
+	// estimate of the processing time the skipped frames would have taken
+	double SavedSeconds() const { return _num_skipped * _cost_us / 1000000.0; }
+
+	// the current sampling rate and the time it saved
+	std::string GetReport() const;
+};
@@ -0,0 +1,320 @@
+#include "game_area_detector.h"
+
+namespace
+{
+	// a pixel is considered changing if its brightness varies more than this over the sampled frames
+	constexpr int activity_threshold = 24;
+
+	// static pixels darker than this are considered letterbox
+	constexpr int letterbox_brightness = 40;
+
+	constexpr double game_aspect_ratio = 16.0 / 9.0;
+	constexpr double aspect_ratio_tolerance = 0.03;
+
+	// find the longest run of values that are at least threshold, returns [begin, end)
+	std::pair<int, int> LongestRun(const std::vector<int>& profile, int threshold)
+	{
+		int best_begin = 0, best_end = 0;
+		int begin = -1;
+		for (int i = 0; i <= int(profile.size()); i++)
+		{
+			if (i < int(profile.size()) && profile[i] >= threshold)
+			{
+				if (begin < 0)
+					begin = i;
+			}
+			else if (begin >= 0)
+			{
+				if (i - begin > best_end - best_begin)
+				{
+					best_begin = begin;
+					best_end = i;
+				}
+				begin = -1;
+			}
+		}
+		return { best_begin, best_end };
+	}
+
+	// slide a window of the given length over [begin, end) and return the start of the window that covers the most activity
+	int BestWindow(const std::vector<int>& profile, int begin, int end, int length)
+	{
+		int sum = 0;
+		for (int i = begin; i < begin + length; i++)
+			sum += profile[i];
+		int best_sum = sum, best_start = begin;
+		for (int start = begin + 1; start + length <= end; start++)
+		{
+			sum += profile[start + length - 1] - profile[start - 1];
+			if (sum > best_sum)
+			{
+				best_sum = sum;
+				best_start = start;
+			}
+		}
+		return best_start;
+	}
+}
+
+GameAreaDetector::GameAreaDetector(int sample_interval, int num_samples, int recheck_interval)
+	: _sample_interval(sample_interval), _num_samples(num_samples), _recheck_interval(recheck_interval)
+{
+}
+
+void GameAreaDetector::Reset(cv::Size frame_size)
+{
+	_frame_size = frame_size;
+	int sample_height = std::max(int(double(frame_size.height) * sample_width / frame_size.width + 0.5), 1);
+	_sample.create(sample_height, sample_width, CV_8UC1);
+	_min.create(sample_height, sample_width, CV_8UC1);
+	_max.create(sample_height, sample_width, CV_8UC1);
+	_sum.create(sample_height, sample_width, CV_32SC1);
+	_samples_taken = 0;
+	_frames_to_next_sample = 0;
+	_game_rect = cv::Rect(0, 0, frame_size.width, frame_size.height);
+	_found = false;
+	_pending_rect = cv::Rect();
+}
+
+void GameAreaDetector::AccumulateSample(const cv::Mat& frame)
+{
+	cv::Mat small;
+	cv::resize(frame, small, _sample.size(), 0, 0, cv::INTER_AREA);
+	cv::cvtColor(small, _sample, cv::COLOR_BGR2GRAY);
+
+	for (int i = 0; i < _sample.rows; i++)
+	{
+		const uint8_t* data = _sample.ptr<uint8_t>(i);
+		uint8_t* min_data = _min.ptr<uint8_t>(i);
+		uint8_t* max_data = _max.ptr<uint8_t>(i);
+		int32_t* sum_data = _sum.ptr<int32_t>(i);
+		for (int j = 0; j < _sample.cols; j++)
+		{
+			if (_samples_taken == 0)
+			{
+				min_data[j] = max_data[j] = data[j];
+				sum_data[j] = data[j];
+			}
+			else
+			{
+				min_data[j] = std::min(min_data[j], data[j]);
+				max_data[j] = std::max(max_data[j], data[j]);
+				sum_data[j] += data[j];
+			}
+		}
+	}
+	_samples_taken++;
+}
+
+bool GameAreaDetector::Detect(cv::Rect& game_rect) const
+{
+	const int rows = _sample.rows, cols = _sample.cols;
+
+	// classify the pixels
+	cv::Mat active(rows, cols, CV_8UC1);
+	cv::Mat letterbox(rows, cols, CV_8UC1);
+	for (int i = 0; i < rows; i++)
+	{
+		const uint8_t* min_data = _min.ptr<uint8_t>(i);
+		const uint8_t* max_data = _max.ptr<uint8_t>(i);
+		uint8_t* active_data = active.ptr<uint8_t>(i);
+		uint8_t* letterbox_data = letterbox.ptr<uint8_t>(i);
+		for (int j = 0; j < cols; j++)
+		{
+			active_data[j] = max_data[j] - min_data[j] > activity_threshold;
+			letterbox_data[j] = !active_data[j] && max_data[j] < letterbox_brightness;
+		}
+	}
+
+	auto count_in_rect = [](const cv::Mat& mask, int x0, int y0, int x1, int y1) {
+		int count = 0;
+		for (int i = y0; i < y1; i++)
+		{
+			const uint8_t* data = mask.ptr<uint8_t>(i);
+			for (int j = x0; j < x1; j++)
+				count += data[j];
+		}
+		return count;
+	};
+
+	// rows that are part of the game image have lots of changing pixels, static overlays and letterbox bars have none
+	std::vector<int> row_profile(rows, 0);
+	for (int i = 0; i < rows; i++)
+		row_profile[i] = count_in_rect(active, 0, i, cols, i + 1);
+	int max_row_activity = *std::max_element(row_profile.begin(), row_profile.end());
+	if (max_row_activity < cols / 8)
+		return false;
+	int y0, y1;
+	std::tie(y0, y1) = LongestRun(row_profile, max_row_activity / 2);
+
+	std::vector<int> col_profile(cols, 0);
+	for (int j = 0; j < cols; j++)
+		col_profile[j] = count_in_rect(active, j, y0, j + 1, y1);
+	int max_col_activity = *std::max_element(col_profile.begin(), col_profile.end());
+	int x0, x1;
+	std::tie(x0, x1) = LongestRun(col_profile, max_col_activity / 2);
+
+	// snap the borders to the strongest edge of the mean image nearby, which is where the game image meets the letterbox / scene background
+	{
+		// the sums are proportional to the mean image since all pixels have the same number of samples
+		auto mean_at = [this](int row, int col) { return _sum.ptr<int32_t>(row)[col]; };
+		auto col_edge = [&](int col) {
+			int64_t strength = 0;
+			for (int i = y0; i < y1; i++)
+				strength += std::abs(mean_at(i, col) - mean_at(i, col - 1));
+			return strength;
+		};
+		auto row_edge = [&](int row) {
+			int64_t strength = 0;
+			for (int j = x0; j < x1; j++)
+				strength += std::abs(mean_at(row, j) - mean_at(row - 1, j));
+			return strength;
+		};
+		auto snap = [](int pos, int limit, auto edge_strength) {
+			constexpr int search_range = 3;
+			int best_pos = pos;
+			int64_t best_strength = 0;
+			for (int p = std::max(pos - search_range, 1); p <= std::min(pos + search_range, limit - 1); p++)
+			{
+				int64_t strength = edge_strength(p);
+				if (strength > best_strength)
+				{
+					best_strength = strength;
+					best_pos = p;
+				}
+			}
+			return best_pos;
+		};
+		if (x0 > 0)
+			x0 = snap(x0, cols, col_edge);
+		if (x1 < cols)
+			x1 = snap(x1, cols, col_edge);
+		if (y0 > 0)
+			y0 = snap(y0, rows, row_edge);
+		if (y1 < rows)
+			y1 = snap(y1, rows, row_edge);
+	}
+	if (x1 - x0 < cols / 4 || y1 - y0 < rows / 4)
+		return false;
+
+	// enforce the aspect ratio of the game.
+	// If the area is too wide / tall, either the changing region extends into something next to the game (e.g. a webcam), in which case it is cropped,
+	// or the game image itself has static dark bars (e.g. letterboxed cutscenes), in which case the area is grown into the bars.
+	double aspect_ratio = double(x1 - x0) / double(y1 - y0);
+	if (aspect_ratio > game_aspect_ratio * (1 + aspect_ratio_tolerance))
+	{
+		int height = int((x1 - x0) / game_aspect_ratio + 0.5);
+		int grow = height - (y1 - y0);
+		int grow_y0 = std::max(y0 - grow / 2, 0);
+		int grow_y1 = std::min(grow_y0 + height, rows);
+		grow_y0 = grow_y1 - height;
+		bool fits = grow_y0 >= 0;
+		if (fits && count_in_rect(letterbox, x0, grow_y0, x1, y0) + count_in_rect(letterbox, x0, y1, x1, grow_y1) > grow * (x1 - x0) * 9 / 10)
+		{
+			y0 = grow_y0;
+			y1 = grow_y1;
+		}
+		else
+		{
+			int width = int((y1 - y0) * game_aspect_ratio + 0.5);
+			std::vector<int> profile(cols, 0);
+			for (int j = x0; j < x1; j++)
+				profile[j] = count_in_rect(active, j, y0, j + 1, y1);
+			x0 = BestWindow(profile, x0, x1, width);
+			x1 = x0 + width;
+		}
+	}
+	else if (aspect_ratio < game_aspect_ratio / (1 + aspect_ratio_tolerance))
+	{
+		int width = int((y1 - y0) * game_aspect_ratio + 0.5);
+		int grow = width - (x1 - x0);
+		int grow_x0 = std::max(x0 - grow / 2, 0);
+		int grow_x1 = std::min(grow_x0 + width, cols);
+		grow_x0 = grow_x1 - width;
+		bool fits = grow_x0 >= 0;
+		if (fits && count_in_rect(letterbox, grow_x0, y0, x0, y1) + count_in_rect(letterbox, x1, y0, grow_x1, y1) > grow * (y1 - y0) * 9 / 10)
+		{
+			x0 = grow_x0;
+			x1 = grow_x1;
+		}
+		else
+		{
+			int height = int((x1 - x0) / game_aspect_ratio + 0.5);
+			std::vector<int> profile(rows, 0);
+			for (int i = y0; i < y1; i++)
+				profile[i] = count_in_rect(active, x0, i, x1, i + 1);
+			y0 = BestWindow(profile, y0, y1, height);
+			y1 = y0 + height;
+		}
+	}
+
+	// the game image should be changing almost everywhere, except for the HUD
+	if (count_in_rect(active, x0, y0, x1, y1) < (x1 - x0) * (y1 - y0) * 3 / 10)
+		return false;
+
+	// back to the input resolution
+	double scale_x = double(_frame_size.width) / cols;
+	double scale_y = double(_frame_size.height) / rows;
+	int rect_x0 = std::clamp(int(x0 * scale_x + 0.5), 0, _frame_size.width);
+	int rect_x1 = std::clamp(int(x1 * scale_x + 0.5), 0, _frame_size.width);
+	int rect_y0 = std::clamp(int(y0 * scale_y + 0.5), 0, _frame_size.height);
+	int rect_y1 = std::clamp(int(y1 * scale_y + 0.5), 0, _frame_size.height);
+	game_rect = cv::Rect(rect_x0, rect_y0, rect_x1 - rect_x0, rect_y1 - rect_y0);
+	return true;
+}
+
+bool GameAreaDetector::Update(const cv::Mat& frame)
+{
+	if (frame.cols != _frame_size.width || frame.rows != _frame_size.height)
+		Reset(frame.size());
+
+	if (_frames_to_next_sample > 0)
+	{
+		_frames_to_next_sample--;
+		return false;
+	}
+
+	AccumulateSample(frame);
+	if (_samples_taken < _num_samples)
+	{
+		_frames_to_next_sample = _sample_interval - 1;
+		return false;
+	}
+
+	cv::Rect detected;
+	bool success = Detect(detected);
+	_samples_taken = 0;
+	_frames_to_next_sample = _found ? _recheck_interval : _sample_interval - 1;
+	if (!success)
+		return false;
+
+	if (!_found)
+	{
+		_game_rect = detected;
+		_found = true;
+		_frames_to_next_sample = _recheck_interval;
+		return true;
+	}
+
+	// small differences come from sampling noise, ignore them
+	int tolerance = _frame_size.width / 50;
+	auto is_close = [tolerance](const cv::Rect& a, const cv::Rect& b) {
+		return std::abs(a.x - b.x) <= tolerance && std::abs(a.y - b.y) <= tolerance && std::abs(a.br().x - b.br().x) <= tolerance && std::abs(a.br().y - b.br().y) <= tolerance;
+	};
+	if (is_close(detected, _game_rect))
+	{
+		_pending_rect = cv::Rect();
+		return false;
+	}
+
+	// the layout has probably changed, but wait for a second detection to agree before switching
+	if (_pending_rect.area() > 0 && is_close(detected, _pending_rect))
+	{
+		_game_rect = detected;
+		_pending_rect = cv::Rect();
+		return true;
+	}
+	_pending_rect = detected;
+	_frames_to_next_sample = _sample_interval - 1;
+	return false;
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include "common.h"
+
+
+// Finds the game image inside the input frame, e.g. when the input is a whole OBS scene instead of just the game capture.
+// A few seconds of frames are sampled at low resolution. Pixels that never change are letterbox bars or static overlays,
+// the game area is the 16:9 rectangle bounded by letterbox edges that contains most of the changing pixels.
+class GameAreaDetector
+{
+private:
+	// sampled frames are downscaled to this width before analysis
+	static constexpr int sample_width = 320;
+
+	int _sample_interval;			// number of frames between two samples
+	int _num_samples;				// number of samples needed for one detection
+	int _recheck_interval;			// number of frames to wait before detecting again once the game area is known
+
+	cv::Size _frame_size;
+	cv::Mat _sample;				// downscaled gray image of the current sample
+	cv::Mat _min, _max;				// per-pixel min / max brightness over the sampled frames
+	cv::Mat _sum;					// per-pixel brightness sum over the sampled frames, for the mean image
+	int _samples_taken = 0;
+	int _frames_to_next_sample = 0;
+
+	cv::Rect _game_rect;
+	bool _found = false;
+	cv::Rect _pending_rect;			// a detection that differs from _game_rect, it has to be confirmed by the next detection before being used
+
+private:
+	void Reset(cv::Size frame_size);
+	void AccumulateSample(const cv::Mat& frame);
+
+	// analyse the accumulated samples, returns false if no game area can be found (e.g. the game image is static over the whole period)
+	bool Detect(cv::Rect& game_rect) const;
+
+public:
+	GameAreaDetector(int sample_interval = 6, int num_samples = 30, int recheck_interval = 1800);
+
+	// feed a frame of the input, returns true if the game area has changed
+	bool Update(const cv::Mat& frame);
+
+	// the whole frame is returned until the game area is found
+	cv::Rect GetGameRect() const { return _game_rect; }
+	bool IsFound() const { return _found; }
+};
@@ -0,0 +1,134 @@
+# Generates location_table.h from bin/eng_locations.txt
+# The table holds the location names with their preprocessed forms and a perfect hash of the preprocessed names,
+# run it again whenever the location list changes.
+#
+# usage: python gen_location_table.py [location_file] [output_file]
+
+import sys
+
+MASK32 = 0xFFFFFFFF
+NUM_BUCKETS = 128
+NUM_SLOTS = 512
+
+
+# same as util::NormalizeTextForMatching()
+def normalize(name):
+    return name.replace(' ', '').replace("'", '').upper()
+
+
+# same as location_table::Hash()
+def hash_key(key, seed):
+    h = (2166136261 ^ seed) & MASK32
+    for c in key.encode('ascii'):
+        h = ((h ^ c) * 16777619) & MASK32
+    h ^= h >> 15
+    h = (h * 0x2C1B3C6D) & MASK32
+    h ^= h >> 12
+    return h
+
+
+# hash and displace: the keys are put into buckets by one hash, then each bucket gets a seed that puts all its keys into free slots
+def build_perfect_hash(keys):
+    buckets = [[] for _ in range(NUM_BUCKETS)]
+    for index, key in enumerate(keys):
+        buckets[hash_key(key, 0) % NUM_BUCKETS].append(index)
+
+    seeds = [0] * NUM_BUCKETS
+    slots = [-1] * NUM_SLOTS
+    for bucket in sorted(range(NUM_BUCKETS), key=lambda b: -len(buckets[b])):
+        if not buckets[bucket]:
+            break
+        for seed in range(1, 65536):
+            positions = [hash_key(keys[i], seed) % NUM_SLOTS for i in buckets[bucket]]
+            if len(set(positions)) == len(positions) and all(slots[p] < 0 for p in positions):
+                for i, p in zip(buckets[bucket], positions):
+                    slots[p] = i
+                seeds[bucket] = seed
+                break
+        else:
+            sys.exit('No perfect hash found, increase NUM_SLOTS')
+    return seeds, slots
+
+
+def main():
+    location_file = sys.argv[1] if len(sys.argv) > 1 else 'bin/eng_locations.txt'
+    output_file = sys.argv[2] if len(sys.argv) > 2 else 'location_table.h'
+
+    with open(location_file, encoding='ascii') as f:
+        names = [line.rstrip('\r\n') for line in f if line.rstrip('\r\n')]
+    keys = [normalize(name) for name in names]
+    if len(set(keys)) != len(keys):
+        sys.exit('Locations with the same preprocessed name')
+    if len(keys) > NUM_SLOTS:
+        sys.exit('Too many locations, increase NUM_SLOTS')
+
+    seeds, slots = build_perfect_hash(keys)
+
+    out = []
+    out.append('#pragma once')
+    out.append('// Generated by gen_location_table.py from %s, do not edit.' % location_file.replace('\\', '/'))
+    out.append('#include <cstdint>')
+    out.append('#include <string_view>')
+    out.append('')
+    out.append('')
+    out.append('// The English location list built into the program, with a perfect hash of the preprocessed names for exact matching')
+    out.append('namespace location_table')
+    out.append('{')
+    out.append('\tstruct Entry')
+    out.append('\t{')
+    out.append('\t\tstd::string_view name;')
+    out.append('\t\tstd::string_view preprocessed_name;\t\t// result of util::NormalizeTextForMatching()')
+    out.append('\t};')
+    out.append('')
+    out.append('\tconstexpr Entry entries[] = {')
+    for name, key in zip(names, keys):
+        out.append('\t\t{ "%s", "%s" },' % (name, key))
+    out.append('\t};')
+    out.append('\tconstexpr size_t num_entries = sizeof(entries) / sizeof(entries[0]);')
+    out.append('')
+    out.append('\tconstexpr uint32_t num_buckets = %d;' % NUM_BUCKETS)
+    out.append('\tconstexpr uint32_t num_slots = %d;' % NUM_SLOTS)
+    out.append('')
+    out.append('\t// hash seed of each bucket')
+    out.append('\tconstexpr uint16_t seeds[num_buckets] = {')
+    for i in range(0, NUM_BUCKETS, 16):
+        out.append('\t\t' + ', '.join(str(s) for s in seeds[i:i + 16]) + ',')
+    out.append('\t};')
+    out.append('')
+    out.append('\t// index into entries, -1 for empty slots')
+    out.append('\tconstexpr int16_t slots[num_slots] = {')
+    for i in range(0, NUM_SLOTS, 16):
+        out.append('\t\t' + ', '.join(str(s) for s in slots[i:i + 16]) + ',')
+    out.append('\t};')
+    out.append('')
+    out.append('\tconstexpr uint32_t Hash(std::string_view key, uint32_t seed)')
+    out.append('\t{')
+    out.append('\t\t// FNV-1a with a final mix, so that the low bits depend on all characters')
+    out.append('\t\tuint32_t h = 2166136261u ^ seed;')
+    out.append('\t\tfor (char c : key)')
+    out.append('\t\t\th = (h ^ uint8_t(c)) * 16777619u;')
+    out.append('\t\th ^= h >> 15;')
+    out.append('\t\th *= 0x2C1B3C6Du;')
+    out.append('\t\th ^= h >> 12;')
+    out.append('\t\treturn h;')
+    out.append('\t}')
+    out.append('')
+    out.append('\t// index of the entry with exactly this preprocessed name, -1 if there is none')
+    out.append('\tconstexpr int Find(std::string_view preprocessed_name)')
+    out.append('\t{')
+    out.append('\t\tint index = slots[Hash(preprocessed_name, seeds[Hash(preprocessed_name, 0) % num_buckets]) % num_slots];')
+    out.append('\t\treturn index >= 0 && entries[index].preprocessed_name == preprocessed_name ? index : -1;')
+    out.append('\t}')
+    out.append('')
+    out.append('\t// a spot check that Hash() is still the one the table was built with')
+    out.append('\tstatic_assert(Find(entries[0].preprocessed_name) == 0 && Find(entries[num_entries - 1].preprocessed_name) == int(num_entries - 1),')
+    out.append('\t\t"location_table.h is out of date, run gen_location_table.py again");')
+    out.append('}')
+    out.append('')
+
+    with open(output_file, 'w', encoding='ascii', newline='\n') as f:
+        f.write('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()
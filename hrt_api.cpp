@@ -0,0 +1,217 @@
+#include "hrt_api.h"
+#include <cstddef>
+#include "common.h"
+#include "hud_engine.h"
+#include "hud_regions.h"
+#include "location_detector.h"
+
+struct hrt_detector
+{
+	HudEngine hud_engine;
+	std::vector<HudEvent> events;
+
+	hrt_result_callback callback = nullptr;
+	void* user_data = nullptr;
+
+	// results of the last frame, texts are copied so that they are null-terminated
+	int64_t frame_id = 0;
+	std::vector<std::string> texts;
+	size_t next_result = 0;
+};
+
+namespace
+{
+	// sizes of the structs in the first version of the API, anything smaller is not a valid struct
+	constexpr size_t config_v1_size = offsetof(hrt_config, banner_model_file) + sizeof(hrt_config::banner_model_file);
+	constexpr size_t frame_v1_size = offsetof(hrt_frame, game_height) + sizeof(hrt_frame::game_height);
+
+	// the fields of a struct the caller was built with, the rest keep the defaults of init
+	template<class T>
+	T CopyVersioned(const T* src, void (*init)(T*))
+	{
+		T dst;
+		init(&dst);
+		memcpy(&dst, src, std::min<size_t>(src->struct_size, sizeof(T)));
+		dst.struct_size = sizeof(T);
+		return dst;
+	}
+
+	// wrap the game area of a frame in a Mat without copying
+	int32_t WrapGameImage(const hrt_frame& frame, cv::Mat& game_img, bool& limited_range)
+	{
+		int type;
+		int bytes_per_pixel;
+		limited_range = false;
+		switch (frame.format)
+		{
+		case HRT_PIXEL_FORMAT_BGR:
+			type = CV_8UC3;
+			bytes_per_pixel = 3;
+			break;
+		case HRT_PIXEL_FORMAT_BGRA:
+			type = CV_8UC4;
+			bytes_per_pixel = 4;
+			break;
+		case HRT_PIXEL_FORMAT_NV12:
+			// the HUD is white text, luma alone is enough
+			type = CV_8UC1;
+			bytes_per_pixel = 1;
+			limited_range = (frame.flags & HRT_FRAME_FULL_RANGE) == 0;
+			break;
+		case HRT_PIXEL_FORMAT_GRAY:
+			type = CV_8UC1;
+			bytes_per_pixel = 1;
+			break;
+		default:
+			return HRT_ERROR_UNSUPPORTED_FORMAT;
+		}
+
+		if (!frame.data || frame.width <= 0 || frame.height <= 0 || frame.stride < frame.width * bytes_per_pixel)
+			return HRT_ERROR_INVALID_ARGUMENT;
+
+		cv::Rect game_rect(0, 0, frame.width, frame.height);
+		if (frame.game_width > 0 && frame.game_height > 0)
+		{
+			game_rect = cv::Rect(frame.game_x, frame.game_y, frame.game_width, frame.game_height);
+			if (game_rect.x < 0 || game_rect.y < 0 || game_rect.x + game_rect.width > frame.width || game_rect.y + game_rect.height > frame.height)
+				return HRT_ERROR_INVALID_ARGUMENT;
+		}
+
+		game_img = cv::Mat(frame.height, frame.width, type, (void*)frame.data, size_t(frame.stride))(game_rect);
+		return HRT_OK;
+	}
+}
+
+uint32_t hrt_get_api_version(void)
+{
+	return HRT_API_VERSION;
+}
+
+void hrt_config_init(hrt_config* config)
+{
+	if (!config)
+		return;
+
+	static const int32_t s_default_ocr_game_widths[] = { 240, 480, 0 };
+	LocationDetector::Config defaults;
+	*config = {};
+	config->struct_size = sizeof(hrt_config);
+	config->brightness_threshold = defaults.brightness_threshold;
+	config->bright_pixel_ratio_low = defaults.bright_pixel_ratio_low;
+	config->bright_pixel_ratio_high = defaults.bright_pixel_ratio_high;
+	config->ocr_game_widths = s_default_ocr_game_widths;
+	config->num_ocr_game_widths = uint32_t(std::size(s_default_ocr_game_widths));
+}
+
+void hrt_frame_init(hrt_frame* frame)
+{
+	if (!frame)
+		return;
+
+	*frame = {};
+	frame->struct_size = sizeof(hrt_frame);
+}
+
+hrt_detector* hrt_create(const hrt_config* config)
+{
+	if (!config)
+		return nullptr;
+	if (config->struct_size < config_v1_size)
+	{
+		std::cout << "hrt_create: struct_size " << config->struct_size << " is smaller than any version of hrt_config, use hrt_config_init()" << std::endl;
+		return nullptr;
+	}
+
+	try
+	{
+		hrt_config c = CopyVersioned(config, hrt_config_init);
+		LocationDetector::Config detector_config;
+		detector_config.brightness_threshold = c.brightness_threshold;
+		detector_config.bright_pixel_ratio_low = c.bright_pixel_ratio_low;
+		detector_config.bright_pixel_ratio_high = c.bright_pixel_ratio_high;
+		if (c.ocr_game_widths && c.num_ocr_game_widths > 0)
+			detector_config.ocr_game_widths.assign(c.ocr_game_widths, c.ocr_game_widths + c.num_ocr_game_widths);
+		if (c.model_file)
+			detector_config.ocr_model.file = c.model_file;
+		if (c.location_file)
+			detector_config.location_file = c.location_file;
+		if (c.banner_model_file)
+			detector_config.banner_model_file = c.banner_model_file;
+
+		std::unique_ptr<hrt_detector> detector = std::make_unique<hrt_detector>();
+		if (!InitHudEngine(detector->hud_engine, detector_config))
+			return nullptr;
+		return detector.release();
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "hrt_create: " << e.what() << std::endl;
+		return nullptr;
+	}
+}
+
+void hrt_destroy(hrt_detector* detector)
+{
+	delete detector;
+}
+
+void hrt_set_callback(hrt_detector* detector, hrt_result_callback callback, void* user_data)
+{
+	if (!detector)
+		return;
+
+	detector->callback = callback;
+	detector->user_data = user_data;
+}
+
+int32_t hrt_submit_frame(hrt_detector* detector, const hrt_frame* frame)
+{
+	if (!detector || !frame || frame->struct_size < frame_v1_size)
+		return HRT_ERROR_INVALID_ARGUMENT;
+
+	try
+	{
+		hrt_frame f = CopyVersioned(frame, hrt_frame_init);
+		cv::Mat game_img;
+		bool limited_range;
+		int32_t error = WrapGameImage(f, game_img, limited_range);
+		if (error != HRT_OK)
+			return error;
+
+		detector->hud_engine.SetLimitedRange(limited_range);
+		detector->hud_engine.Analyse(game_img, detector->events);
+
+		detector->frame_id = f.frame_id;
+		detector->texts.resize(detector->events.size());
+		for (size_t i = 0; i < detector->events.size(); i++)
+			detector->texts[i].assign(detector->events[i].text);
+		detector->next_result = 0;
+
+		if (detector->callback)
+		{
+			hrt_result result;
+			while (hrt_poll_result(detector, &result))
+				detector->callback(detector->user_data, &result);
+		}
+		return int32_t(detector->events.size());
+	}
+	catch (const std::exception& e)
+	{
+		std::cout << "hrt_submit_frame: " << e.what() << std::endl;
+		return HRT_ERROR_INTERNAL;
+	}
+}
+
+int32_t hrt_poll_result(hrt_detector* detector, hrt_result* result)
+{
+	if (!detector || !result || detector->next_result >= detector->events.size())
+		return 0;
+
+	size_t index = detector->next_result++;
+	const HudEvent& event = detector->events[index];
+	result->frame_id = detector->frame_id;
+	result->region = event.source->Name();
+	result->text = detector->texts[index].c_str();
+	result->is_new = event.is_new ? 1 : 0;
+	return 1;
+}
@@ -0,0 +1,121 @@
+#pragma once
+/*
+ * C interface of the HUD detector, built as hrt.dll by HRTLib.vcxproj.
+ *
+ * A detector runs on the thread that submits the frames, there is no thread inside the library.
+ * Different detectors can be used from different threads at the same time, one detector must only be used by one thread at a time.
+ * Frames are read in place, the pixels are never copied as a whole.
+ *
+ * The structs only ever get new fields at the end, and struct_size tells the library which version the caller was built with.
+ * Fields the caller doesn't know get the defaults of hrt_config_init() / hrt_frame_init(), a struct_size smaller than the
+ * first version is rejected.
+ */
+#include <stdint.h>
+
+#ifdef HRT_API_EXPORTS
+#define HRT_API __declspec(dllexport)
+#else
+#define HRT_API __declspec(dllimport)
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define HRT_API_VERSION 1
+
+typedef struct hrt_detector hrt_detector;
+
+typedef enum hrt_pixel_format
+{
+	HRT_PIXEL_FORMAT_BGR = 0,		/* 3 bytes per pixel */
+	HRT_PIXEL_FORMAT_BGRA = 1,		/* 4 bytes per pixel, alpha is ignored */
+	HRT_PIXEL_FORMAT_NV12 = 2,		/* only the Y plane is read */
+	HRT_PIXEL_FORMAT_GRAY = 3,		/* 1 byte per pixel */
+} hrt_pixel_format;
+
+/* hrt_frame::flags */
+#define HRT_FRAME_FULL_RANGE 0x1	/* Y of NV12 is in full range (0-255) instead of video range (16-235) */
+
+typedef enum hrt_error
+{
+	HRT_OK = 0,
+	HRT_ERROR_INVALID_ARGUMENT = -1,
+	HRT_ERROR_UNSUPPORTED_FORMAT = -2,
+	HRT_ERROR_INTERNAL = -3,
+} hrt_error;
+
+typedef struct hrt_config
+{
+	uint32_t struct_size;				/* sizeof(hrt_config) */
+
+	/* early-out, brightness in 0-255 and ratios in percentage. Defaults 240, 15, 30 */
+	int32_t brightness_threshold;
+	int32_t bright_pixel_ratio_low;
+	int32_t bright_pixel_ratio_high;
+
+	/* OCR cascade, widths the game image is shrunk to, 0 means full resolution. Default 240, 480, 0 */
+	const int32_t* ocr_game_widths;
+	uint32_t num_ocr_game_widths;
+
+	const char* model_file;				/* Tesseract model, "eng.traineddata" in the working directory if NULL */
+	const char* location_file;			/* location names one per line, the built-in list if NULL */
+	const char* banner_model_file;		/* banner classifier run before OCR (see -train of HRT.exe), none if NULL */
+} hrt_config;
+
+typedef struct hrt_frame
+{
+	uint32_t struct_size;				/* sizeof(hrt_frame) */
+
+	const uint8_t* data;				/* first row of the image, or of the Y plane for NV12 */
+	int32_t stride;						/* bytes from one row to the next */
+	int32_t width;
+	int32_t height;
+	int32_t format;						/* hrt_pixel_format */
+	uint32_t flags;						/* HRT_FRAME_* */
+
+	int64_t frame_id;					/* chosen by the caller, handed back with the results */
+
+	/* area of the game image in the frame, the whole frame if width or height is 0 */
+	int32_t game_x;
+	int32_t game_y;
+	int32_t game_width;
+	int32_t game_height;
+} hrt_frame;
+
+typedef struct hrt_result
+{
+	int64_t frame_id;
+	const char* region;					/* "location", "shrine_clear", "loading_screen" or "black_screen" */
+	const char* text;					/* e.g. the location name, empty for regions without text */
+	int32_t is_new;						/* 1 if the region had no event in the previous frame */
+} hrt_result;
+
+/* called from hrt_submit_frame() for each result, the strings are valid until the callback returns */
+typedef void (*hrt_result_callback)(void* user_data, const hrt_result* result);
+
+/* returns HRT_API_VERSION of the library */
+HRT_API uint32_t hrt_get_api_version(void);
+
+/* fill in the default settings */
+HRT_API void hrt_config_init(hrt_config* config);
+HRT_API void hrt_frame_init(hrt_frame* frame);
+
+/* returns NULL on failure, the reason is printed to stdout */
+HRT_API hrt_detector* hrt_create(const hrt_config* config);
+HRT_API void hrt_destroy(hrt_detector* detector);
+
+/* set a callback, or NULL to poll the results instead */
+HRT_API void hrt_set_callback(hrt_detector* detector, hrt_result_callback callback, void* user_data);
+
+/* Analyse one frame, frames have to be passed in order.
+ * Returns the number of results of the frame, or an hrt_error */
+HRT_API int32_t hrt_submit_frame(hrt_detector* detector, const hrt_frame* frame);
+
+/* Take the next result of the last submitted frame when there is no callback.
+ * Returns 1 and fills result, or 0 if there are no more. The strings are valid until the next hrt_submit_frame() */
+HRT_API int32_t hrt_poll_result(hrt_detector* detector, hrt_result* result);
+
+#ifdef __cplusplus
+}
+#endif
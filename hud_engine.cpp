@@ -0,0 +1,173 @@
+#include "hud_engine.h"
+
+HudFrame::HudFrame()
+{
+	_gray_rects.reserve(16);
+}
+
+void HudFrame::Reset(const cv::Mat& game_img)
+{
+	_game_img = game_img;
+	_gray_rects.clear();
+	_thumbnail_valid = false;
+	if (NeedsConversion())
+		_gray.create(game_img.size(), CV_8UC1);
+}
+
+void HudFrame::ConvertToGray(const cv::Mat& src, cv::Mat& dst) const
+{
+	if (src.type() == CV_8UC4)
+		cv::cvtColor(src, dst, cv::COLOR_BGRA2GRAY);
+	else if (src.type() == CV_8UC3)
+		cv::cvtColor(src, dst, cv::COLOR_BGR2GRAY);
+	else
+		cv::LUT(src, VideoRangeLut(), dst);
+}
+
+const cv::Mat& HudFrame::VideoRangeLut()
+{
+	// expand video range to full range, so that the brightness thresholds mean the same for all inputs
+	static const cv::Mat s_range_lut = []() {
+		cv::Mat lut(1, 256, CV_8UC1);
+		for (int i = 0; i < 256; i++)
+			lut.at<uint8_t>(i) = cv::saturate_cast<uint8_t>((i - 16) * 255.0 / 219.0);
+		return lut;
+	}();
+	return s_range_lut;
+}
+
+cv::Rect HudFrame::ToPixels(const cv::Rect2d& relative, cv::Size game_size)
+{
+	int col0 = int(relative.x * double(game_size.width) + 0.5);
+	int col1 = int((relative.x + relative.width) * double(game_size.width) + 0.5);
+	int row0 = int(relative.y * double(game_size.height) + 0.5);
+	int row1 = int((relative.y + relative.height) * double(game_size.height) + 0.5);
+	return cv::Rect(col0, row0, col1 - col0, row1 - row0);
+}
+
+cv::Mat HudFrame::Gray(const cv::Rect& rect)
+{
+	if (!NeedsConversion())
+		return _game_img(rect);
+
+	if (std::none_of(_gray_rects.begin(), _gray_rects.end(), [&rect](const cv::Rect& r) { return (r & rect) == rect; }))
+	{
+		cv::Mat gray_view = _gray(rect);
+		ConvertToGray(_game_img(rect), gray_view);
+		_gray_rects.push_back(rect);
+	}
+	return _gray(rect);
+}
+
+const cv::Mat& HudFrame::Thumbnail()
+{
+	if (_thumbnail_valid)
+		return _thumbnail;
+
+	cv::Size size(thumbnail_width, std::max(int(double(_game_img.rows) * thumbnail_width / _game_img.cols + 0.5), 1));
+	if (!NeedsConversion())
+		cv::resize(_game_img, _thumbnail, size, 0, 0, cv::INTER_AREA);
+	else
+	{
+		// shrink first so that only the thumbnail needs conversion
+		cv::resize(_game_img, _thumbnail_color, size, 0, 0, cv::INTER_AREA);
+		ConvertToGray(_thumbnail_color, _thumbnail);
+	}
+	_thumbnail_valid = true;
+	return _thumbnail;
+}
+
+void HudEngine::UpdateLayout(cv::Size game_size)
+{
+	if (_game_size == game_size)
+		return;
+	_game_size = game_size;
+
+	_cheap_order.clear();
+	for (size_t i = 0; i < _entries.size(); i++)
+	{
+		_entries[i].rect = _frame.ToPixels(_entries[i].detector->Region());
+		if (!_entries[i].detector->IsOcrBound())
+			_cheap_order.push_back(i);
+	}
+	_candidates.reserve(_entries.size());
+}
+
+bool HudEngine::DetectRegion(size_t index, std::vector<HudEvent>& events)
+{
+	Entry& entry = _entries[index];
+	HudEvent event;
+	event.source = entry.detector.get();
+	if (!entry.detector->Detect(_frame, entry.rect, event))
+		return false;
+	event.is_new = !entry.active;
+	events.push_back(event);
+	entry.detected = true;
+	return true;
+}
+
+const std::vector<size_t>& HudEngine::Screen(const cv::Mat& game_img, std::vector<HudEvent>& events)
+{
+	events.clear();
+	_frame.Reset(game_img);
+	UpdateLayout(game_img.size());
+
+	for (Entry& entry : _entries)
+		entry.detected = false;
+
+	// cheap regions first, they can tell that nothing else needs to be looked at
+	_candidates.clear();
+	for (size_t index : _cheap_order)
+	{
+		Entry& entry = _entries[index];
+		if (entry.detector->Screen(_frame, entry.rect) && DetectRegion(index, events) && entry.detector->IsExclusive())
+			return _candidates;
+	}
+
+	for (size_t i = 0; i < _entries.size(); i++)
+	{
+		Entry& entry = _entries[i];
+		if (entry.detector->IsOcrBound() && entry.detector->Screen(_frame, entry.rect))
+			_candidates.push_back(i);
+	}
+	return _candidates;
+}
+
+void HudEngine::DetectInOrder(const std::vector<size_t>& candidates, std::vector<HudEvent>& events)
+{
+	// cheapest OCR first, so that an exclusive event found there saves the expensive ones
+	_detect_order = candidates;
+	std::sort(_detect_order.begin(), _detect_order.end(), [this](size_t a, size_t b) { return _entries[a].detector->Cost() < _entries[b].detector->Cost(); });
+	for (size_t index : _detect_order)
+	{
+		if (DetectRegion(index, events) && _entries[index].detector->IsExclusive())
+			break;
+	}
+}
+
+void HudEngine::DetectCandidates(const cv::Mat& game_img, const std::vector<size_t>& candidates, std::vector<HudEvent>& events)
+{
+	_frame.Reset(game_img);
+	UpdateLayout(game_img.size());
+	DetectInOrder(candidates, events);
+}
+
+void HudEngine::Analyse(const cv::Mat& game_img, std::vector<HudEvent>& events)
+{
+	DetectInOrder(Screen(game_img, events), events);
+
+	for (Entry& entry : _entries)
+		entry.active = entry.detected;
+}
+
+void HudEventTracker::Update(std::vector<HudEvent>& events)
+{
+	_detected.clear();
+	for (HudEvent& event : events)
+	{
+		std::string_view name(event.source->Name());
+		event.is_new = std::find(_active.begin(), _active.end(), name) == _active.end();
+		_detected.push_back(name);
+	}
+	std::swap(_active, _detected);
+}
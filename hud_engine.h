@@ -0,0 +1,153 @@
+#pragma once
+#include "common.h"
+
+
+class RegionDetector;
+
+// An event detected in one region of the HUD
+struct HudEvent
+{
+	const RegionDetector* source = nullptr;
+	std::string_view text;			// e.g. the location name, owned by the source detector
+	bool is_new = false;			// true if the region didn't have an event in the previous frame
+};
+
+// Per-frame data shared by all region detectors.
+// Color conversion and downscaling happen here once per frame, on demand, so that regions covering the same pixels don't redo the work.
+class HudFrame
+{
+public:
+	// width of the downscaled whole-frame image, for regions that only need rough statistics of the game image
+	static constexpr int thumbnail_width = 160;
+
+private:
+	cv::Mat _game_img;
+	bool _limited_range = false;
+	cv::Mat _gray;							// same size as the game image, only converted where it has been requested
+	std::vector<cv::Rect> _gray_rects;		// areas of _gray that are valid for the current frame
+	cv::Mat _thumbnail_color;
+	cv::Mat _thumbnail;
+	bool _thumbnail_valid = false;
+
+private:
+	bool NeedsConversion() const { return _game_img.type() != CV_8UC1 || _limited_range; }
+	void ConvertToGray(const cv::Mat& src, cv::Mat& dst) const;
+	static const cv::Mat& VideoRangeLut();
+
+public:
+	HudFrame();
+
+	// Gray input in video range (16-235), e.g. the luma plane of NV12 video, is expanded to full range where it's used.
+	// Applies from the next Reset()
+	void SetLimitedRange(bool limited_range) { _limited_range = limited_range; }
+
+	// start a new frame, game_img is BGR, BGRA or gray. Full range gray needs no conversion at all
+	void Reset(const cv::Mat& game_img);
+
+	const cv::Mat& GameImage() const { return _game_img; }
+	cv::Size Size() const { return _game_img.size(); }
+
+	// map a rect relative to the game image size to pixels
+	static cv::Rect ToPixels(const cv::Rect2d& relative, cv::Size game_size);
+	cv::Rect ToPixels(const cv::Rect2d& relative) const { return ToPixels(relative, Size()); }
+
+	// gray view into the given area of the game image
+	cv::Mat Gray(const cv::Rect& rect);
+
+	// the table that maps gray pixels of the game image to full range, null if they are already full range (or not gray).
+	// For kernels that read the game image directly, e.g. util::PreprocessBrightText()
+	const uint8_t* RangeLut() const { return _game_img.type() == CV_8UC1 && _limited_range ? VideoRangeLut().ptr<uint8_t>() : nullptr; }
+
+	// gray image of the whole game image, thumbnail_width wide
+	const cv::Mat& Thumbnail();
+};
+
+// Detects one kind of event in a fixed region of the game image
+class RegionDetector
+{
+public:
+	virtual ~RegionDetector() = default;
+
+	virtual const char* Name() const = 0;
+
+	// bounding box of the region, relative to the game image size
+	virtual cv::Rect2d Region() const = 0;
+
+	// OCR-bound regions are only processed after all cheap regions, in order of their cost
+	virtual bool IsOcrBound() const = 0;
+
+	// estimated time of Detect() in microseconds, only used for OCR-bound regions
+	virtual double Cost() const { return 0.0; }
+
+	// If true, an event in this region means nothing else can be on screen (e.g. a black transition frame), so the other regions are skipped
+	virtual bool IsExclusive() const { return false; }
+
+	// Quick test that is run on every frame, returns false if the region certainly doesn't have an event.
+	// rect is Region() in pixels
+	virtual bool Screen(HudFrame& frame, const cv::Rect& rect) = 0;
+
+	// Full detection, only run if Screen() passes. Returns true and fills event.text if an event is detected
+	virtual bool Detect(HudFrame& frame, const cv::Rect& rect, HudEvent& event) = 0;
+};
+
+// Runs all registered region detectors on each frame with shared preprocessing
+class HudEngine
+{
+private:
+	struct Entry
+	{
+		std::unique_ptr<RegionDetector> detector;
+		cv::Rect rect;						// region in pixels
+		bool active = false;				// had an event in the previous frame
+		bool detected = false;				// has an event in the current frame
+	};
+
+	std::vector<Entry> _entries;
+	std::vector<size_t> _cheap_order;		// indices of regions that are not OCR-bound
+	std::vector<size_t> _candidates;		// indices of OCR-bound regions that passed Screen() in the current frame
+	std::vector<size_t> _detect_order;		// candidates in order of their cost
+	cv::Size _game_size;
+	HudFrame _frame;
+
+private:
+	void UpdateLayout(cv::Size game_size);
+	bool DetectRegion(size_t index, std::vector<HudEvent>& events);
+	void DetectInOrder(const std::vector<size_t>& candidates, std::vector<HudEvent>& events);
+
+public:
+	// the engine owns the detector, the returned reference stays valid for the lifetime of the engine
+	template<class T>
+	T& Register(std::unique_ptr<T> detector)
+	{
+		T& ret = *detector;
+		_entries.emplace_back().detector = std::move(detector);
+		_game_size = cv::Size();
+		return ret;
+	}
+
+	// analyse one game image, events is cleared and filled with events of all regions
+	void Analyse(const cv::Mat& game_img, std::vector<HudEvent>& events);
+
+	// see HudFrame::SetLimitedRange()
+	void SetLimitedRange(bool limited_range) { _frame.SetLimitedRange(limited_range); }
+
+	// Analyse() in two steps, so that the OCR can be done on another thread / engine.
+	// Screen() runs the cheap regions and the quick tests of the OCR-bound regions, events is cleared and filled with the events of the cheap regions.
+	// Returns the indices of the OCR-bound regions that need Detect(), valid until the next call.
+	// is_new of the events is not set, use a HudEventTracker.
+	const std::vector<size_t>& Screen(const cv::Mat& game_img, std::vector<HudEvent>& events);
+
+	// Run Detect() of the given OCR-bound regions and add their events, candidates can come from Screen() of any engine with the same registrations
+	void DetectCandidates(const cv::Mat& game_img, const std::vector<size_t>& candidates, std::vector<HudEvent>& events);
+};
+
+// Sets HudEvent::is_new for frames that are analysed with HudEngine::Screen() / DetectCandidates(), possibly on different engines.
+// Frames have to be passed in order.
+class HudEventTracker
+{
+private:
+	std::vector<std::string_view> _active;		// names of the regions that had an event in the previous frame
+	std::vector<std::string_view> _detected;
+public:
+	void Update(std::vector<HudEvent>& events);
+};
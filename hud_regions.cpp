@@ -0,0 +1,153 @@
+#include "hud_regions.h"
+
+namespace
+{
+	// pixels darker than this are considered black, there's always a bit of noise from capture and compression
+	constexpr int black_threshold = 32;
+
+	double DarkPixelRatio(const cv::Mat& gray)
+	{
+		return 1.0 - double(util::CountPixelsAbove(gray, black_threshold)) / (gray.rows * gray.cols);
+	}
+}
+
+bool BlackScreenRegion::Screen(HudFrame& frame, const cv::Rect& rect)
+{
+	return cv::mean(frame.Thumbnail())[0] < black_threshold;
+}
+
+bool BlackScreenRegion::Detect(HudFrame& frame, const cv::Rect& rect, HudEvent& event)
+{
+	return DarkPixelRatio(frame.Thumbnail()) > 0.998;
+}
+
+bool LoadingScreenRegion::Screen(HudFrame& frame, const cv::Rect& rect)
+{
+	return cv::mean(frame.Thumbnail())[0] < black_threshold;
+}
+
+bool LoadingScreenRegion::Detect(HudFrame& frame, const cv::Rect& rect, HudEvent& event)
+{
+	const cv::Mat& thumbnail = frame.Thumbnail();
+	if (DarkPixelRatio(thumbnail) < 0.9)
+		return false;
+
+	// the loading icon is in the lower right corner
+	cv::Rect corner = HudFrame::ToPixels(cv::Rect2d(0.85, 0.8, 0.15, 0.2), thumbnail.size());
+	return util::CountPixelsAbove(thumbnail(corner), 128) > uint32_t(corner.area() / 200);
+}
+
+TextRegion::TextRegion(std::string name, cv::Rect2d region, const std::vector<std::string>& phrases)
+	: _name(std::move(name)), _region(region)
+{
+	size_t max_length = 0;
+	for (const std::string& phrase : phrases)
+	{
+		Phrase& p = _phrases.emplace_back(phrase);
+		util::NormalizeTextForMatching(p.text, p.preprocessed_text);
+		max_length = std::max(max_length, phrase.size());
+	}
+	_text_preprocessed.reserve(max_length * 2);
+}
+
+TextRegion::~TextRegion()
+{
+	_tess_api.Clear();
+}
+
+bool TextRegion::Init(const char* lang, const util::OcrModel& ocr_model, int brightness_threshold, int bright_pixel_ratio_low, int bright_pixel_ratio_high, bool screen_only)
+{
+	_brightness_threshold = brightness_threshold;
+	_bright_pixel_ratio_low = bright_pixel_ratio_low / 100.0;
+	_bright_pixel_ratio_high = bright_pixel_ratio_high / 100.0;
+	if (screen_only)
+		return true;
+
+	if (!util::InitTesseract(_tess_api, lang, ocr_model))
+	{
+		std::cout << "OCRTesseract: Could not initialize tesseract for " << _name << "." << std::endl;
+		return false;
+	}
+	_tess_api.SetPageSegMode(tesseract::PageSegMode::PSM_SINGLE_LINE);
+	if (std::string_view(lang) == "eng")
+	{
+		if (!_tess_api.SetVariable("tessedit_char_whitelist", "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz'- "))
+			return false;
+	}
+	return true;
+}
+
+double TextRegion::Cost() const
+{
+	return _num_detect > 0 ? double(_detect_time_us) / _num_detect : 20000.0;
+}
+
+bool TextRegion::Screen(HudFrame& frame, const cv::Rect& rect)
+{
+	uint32_t num_bright = util::PreprocessBrightText(frame.GameImage(), rect, frame.RangeLut(), _brightness_threshold, cv::Rect(cv::Point(), rect.size()), nullptr, cv::Size());
+	double bright_pixel_ratio = double(num_bright) / rect.area();
+	return bright_pixel_ratio >= _bright_pixel_ratio_low && bright_pixel_ratio <= _bright_pixel_ratio_high;
+}
+
+bool TextRegion::Detect(HudFrame& frame, const cv::Rect& rect, HudEvent& event)
+{
+	auto tbegin = std::chrono::steady_clock::now();
+
+	// same OCR scale as the location text, the font is the same
+	double scale_factor = std::max(frame.Size().width / 480.0, 1.0);
+	util::PreprocessBrightText(frame.GameImage(), rect, frame.RangeLut(), _brightness_threshold, cv::Rect(), &_ocr_input,
+		cv::Size(int(rect.width / scale_factor), int(rect.height / scale_factor)));
+
+	PIX pix;
+	util::WrapLeptonicaPix(_ocr_input, pix);
+	_tess_api.SetImage(&pix);
+	_tess_api.Recognize(0);
+	std::unique_ptr<char[]> text(_tess_api.GetUTF8Text());
+
+	_num_detect++;
+	_detect_time_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tbegin).count();
+
+	if (!text)
+		return false;
+	util::NormalizeTextForMatching(text.get(), _text_preprocessed);
+	while (_text_preprocessed.size() > 0 && _text_preprocessed.back() == '\n')
+		_text_preprocessed.pop_back();
+
+	uint32_t max_allowed_edits = uint32_t(_text_preprocessed.size() / 5);			// allow maximum 1/5 recognition error
+	for (const Phrase& phrase : _phrases)
+	{
+		if (util::GetStringEditDistance(phrase.preprocessed_text, _text_preprocessed, max_allowed_edits) <= max_allowed_edits)
+		{
+			event.text = phrase.text;
+			return true;
+		}
+	}
+	return false;
+}
+
+std::unique_ptr<TextRegion> CreateShrineClearRegion(const char* lang, const util::OcrModel& ocr_model, bool screen_only)
+{
+	// name of the item on the item-get screen, which is centered below the item
+	std::unique_ptr<TextRegion> region = std::make_unique<TextRegion>("shrine_clear", cv::Rect2d(0.3, 0.72, 0.4, 0.08), std::vector<std::string>{ "Spirit Orb" });
+	if (!region->Init(lang, ocr_model, 240, 5, 30, screen_only))
+		return nullptr;
+	return region;
+}
+
+LocationDetector* InitHudEngine(HudEngine& hud_engine, const LocationDetector::Config& detector_config, bool screen_only)
+{
+	std::string lang = "eng";
+
+	std::unique_ptr<LocationDetector> location_detector = std::make_unique<LocationDetector>();
+	if (!location_detector->Init(lang.c_str(), detector_config, screen_only))
+		return nullptr;
+
+	std::unique_ptr<TextRegion> shrine_clear = CreateShrineClearRegion(lang.c_str(), detector_config.ocr_model, screen_only);
+	if (!shrine_clear)
+		return nullptr;
+
+	hud_engine.Register(std::make_unique<BlackScreenRegion>());
+	hud_engine.Register(std::make_unique<LoadingScreenRegion>());
+	hud_engine.Register(std::move(shrine_clear));
+	return &hud_engine.Register(std::move(location_detector));
+}
@@ -0,0 +1,74 @@
+#pragma once
+#include "common.h"
+#include "hud_engine.h"
+#include "location_detector.h"
+
+
+// Black transition frames, e.g. fading in / out of a cutscene or warping
+class BlackScreenRegion : public RegionDetector
+{
+public:
+	const char* Name() const override { return "black_screen"; }
+	cv::Rect2d Region() const override { return cv::Rect2d(0.0, 0.0, 1.0, 1.0); }
+	bool IsOcrBound() const override { return false; }
+	bool IsExclusive() const override { return true; }
+	bool Screen(HudFrame& frame, const cv::Rect& rect) override;
+	bool Detect(HudFrame& frame, const cv::Rect& rect, HudEvent& event) override;
+};
+
+// Loading screens, which are dark except for the tip text and the loading icon in the lower right corner
+class LoadingScreenRegion : public RegionDetector
+{
+public:
+	const char* Name() const override { return "loading_screen"; }
+	cv::Rect2d Region() const override { return cv::Rect2d(0.0, 0.0, 1.0, 1.0); }
+	bool IsOcrBound() const override { return false; }
+	bool IsExclusive() const override { return true; }
+	bool Screen(HudFrame& frame, const cv::Rect& rect) override;
+	bool Detect(HudFrame& frame, const cv::Rect& rect, HudEvent& event) override;
+};
+
+// Bright text at a fixed place of the screen that is matched against a list of phrases
+class TextRegion : public RegionDetector
+{
+private:
+	struct Phrase
+	{
+		std::string text;
+		std::string preprocessed_text;
+	};
+
+	std::string _name;
+	cv::Rect2d _region;
+	std::vector<Phrase> _phrases;
+	tesseract::TessBaseAPI _tess_api;
+	int _brightness_threshold = 240;
+	double _bright_pixel_ratio_low = 0.05, _bright_pixel_ratio_high = 0.3;
+	uint64_t _num_detect = 0, _detect_time_us = 0;		// for Cost()
+
+	// reusable buffers
+	cv::Mat _ocr_input;
+	std::string _text_preprocessed;
+
+public:
+	TextRegion(std::string name, cv::Rect2d region, const std::vector<std::string>& phrases);
+	~TextRegion();
+
+	// the early-out passes if the percentage of pixels brighter than brightness_threshold is in [bright_pixel_ratio_low, bright_pixel_ratio_high]
+	// with screen_only, the OCR model is not loaded and only Screen() can be used
+	bool Init(const char* lang, const util::OcrModel& ocr_model, int brightness_threshold, int bright_pixel_ratio_low, int bright_pixel_ratio_high, bool screen_only = false);
+
+	const char* Name() const override { return _name.c_str(); }
+	cv::Rect2d Region() const override { return _region; }
+	bool IsOcrBound() const override { return true; }
+	double Cost() const override;
+	bool Screen(HudFrame& frame, const cv::Rect& rect) override;
+	bool Detect(HudFrame& frame, const cv::Rect& rect, HudEvent& event) override;
+};
+
+// "Spirit Orb" on the item-get screen after a shrine is cleared
+std::unique_ptr<TextRegion> CreateShrineClearRegion(const char* lang, const util::OcrModel& ocr_model, bool screen_only = false);
+
+// Register all HUD regions, returns the location detector owned by hud_engine, or nullptr on failure.
+// With screen_only, no OCR model is loaded and the engine can only be used for HudEngine::Screen()
+LocationDetector* InitHudEngine(HudEngine& hud_engine, const LocationDetector::Config& detector_config, bool screen_only = false);
@@ -1,23 +1,32 @@
 #include "location_detector.h"
+#ifdef HRT_BUILT_IN_LOCATIONS
+#include "location_table.h"
+#endif
 
-// Pre-process the location names to make matching easier
-[[nodiscard]]
-static std::string PreprocessLocationName(const std::string& loc_in)
+bool LocationDetector::Init(const char* lang, const Config& config, bool screen_only)
 {
-	std::string ret = loc_in;
-	// spaces and single quotes are ignored since sometimes they are not correctly recognized
-	ret.erase(std::remove_if(ret.begin(), ret.end(), [](auto& c) -> bool { return c == ' ' || c == '\''; }), ret.end());
+	if (config.ocr_game_widths.empty())
+	{
+		std::cout << "OCR cascade needs at least one level" << std::endl;
+		return false;
+	}
 
-	// The Hylia Serif font (unofficial name) used by BotW has similar glyphs for upper/lower-case letters, causing the recognition to mix them sometimes.
-	// Forcing to uppercase to get rid of this confusion.
-	std::for_each(ret.begin(), ret.end(), [](auto& c) { c = std::toupper(c); });
+	_brightness_threshold = config.brightness_threshold;
+	_bright_pixel_ratio_low = config.bright_pixel_ratio_low / 100.0;
+	_bright_pixel_ratio_high = config.bright_pixel_ratio_high / 100.0;
 
-	return ret;
-}
+	_ocr_game_widths = config.ocr_game_widths;
+	_min_ocr_confidence = config.min_ocr_confidence;
+	_max_edit_percentage = config.max_edit_percentage;
+	_empty_text_game_width = config.empty_text_game_width;
+	_num_detect = _detect_time_us = 0;
+	_cascade_stats = std::vector<CascadeLevelStats>(_ocr_game_widths.size());
+	_plan = Plan();
 
-bool LocationDetector::Init(const char* lang, int brightness_threshold, int bright_pixel_ratio_low, int bright_pixel_ratio_high)
-{
-	if (_tess_api.Init(".", lang))
+	if (screen_only)
+		return true;
+
+	if (!util::InitTesseract(_tess_api, lang, config.ocr_model))
 	{
 		std::cout << "OCRTesseract: Could not initialize tesseract." << std::endl;
 		return false;
@@ -36,154 +45,383 @@ bool LocationDetector::Init(const char* lang, int brightness_threshold, int brig
 	if (!_tess_api.SetVariable("gapmap_use_ends", "true"))
 		return false;
 
-	if (!InitLocationList(lang))
+	if (!InitLocationList(lang, config.location_file))
 		return false;
 
-	_brightness_threshold = brightness_threshold;
-	_bright_pixel_ratio_low = bright_pixel_ratio_low / 100.0;
-	_bright_pixel_ratio_high = bright_pixel_ratio_high / 100.0;
+	if (config.banner_model_file.size() && !_banner_classifier.Load(config.banner_model_file))
+		return false;
 
 	return true;
 }
 
-bool LocationDetector::InitLocationList(const char* lang)
+bool LocationDetector::InitLocationList(const char* lang, const std::string& location_file)
 {
-	std::string shrine_list_file(std::string(lang) + "_locations.txt");
-	std::ifstream ifs(shrine_list_file);
-	if (!ifs.is_open())
+	_locations.clear();
+	_exact_matches.clear();
+	size_t max_name_length = 0;
+
+#ifdef HRT_BUILT_IN_LOCATIONS
+	_built_in_locations = location_file.empty() && std::string_view(lang) == "eng";
+	if (_built_in_locations)
 	{
-		std::cout << "Cannot open file " << shrine_list_file << std::endl;
-		return false;
+		_locations.reserve(location_table::num_entries);
+		for (const location_table::Entry& entry : location_table::entries)
+		{
+			_locations.push_back({ std::string(entry.name), std::string(entry.preprocessed_name) });
+			max_name_length = std::max(max_name_length, entry.name.size());
+		}
+	}
+	else
+#endif
+	{
+		_built_in_locations = false;
+		std::string shrine_list_file = location_file.empty() ? std::string(lang) + "_locations.txt" : location_file;
+		std::ifstream ifs(shrine_list_file);
+		if (!ifs.is_open())
+		{
+			std::cout << "Cannot open file " << shrine_list_file << std::endl;
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(ifs, line))
+		{
+			Location& loc = _locations.emplace_back(line);
+			util::NormalizeTextForMatching(loc.name, loc.preprocessed_name);
+			max_name_length = std::max(max_name_length, line.size());
+		}
+
+		// the keys point into _locations, which doesn't change from here on
+		for (size_t i = 0; i < _locations.size(); i++)
+			_exact_matches.emplace(_locations[i].preprocessed_name, i);
 	}
 
-	std::string line;
-	while (std::getline(ifs, line))
-		_locations.emplace_back(line, PreprocessLocationName(line));
+	// OCR results that can match anything are at most 1/4 longer than the longest name
+	_loc_in_preprocessed.reserve(max_name_length * 2);
 
 	return true;
 }
 
-bool LocationDetector::EarlyOutTest(const cv::Mat& game_img, uint32_t location_col0, uint32_t location_col1, uint32_t location_row0, uint32_t location_row1)
+cv::Rect2d LocationDetector::GetLocationRegion()
+{
+	return cv::Rect2d(location_x0, location_y0, location_x1 - location_x0, location_y1 - location_y0);
+}
+
+double LocationDetector::Cost() const
+{
+	// a typical OCR call of the location box until it's measured
+	return _num_detect > 0 ? double(_detect_time_us) / _num_detect : 20000.0;
+}
+
+cv::Rect LocationDetector::GetEarlyOutRect(const cv::Rect& location_rect)
 {
 	// Peek the left-most quarter of the location frame, the shorted location name is "Docks", which is about this wide
-	cv::Mat locationMinimalFrame;
-	cv::cvtColor(game_img(cv::Rect(location_col0, location_row0, (location_col1 - location_col0) / 4, location_row1 - location_row0)), locationMinimalFrame, cv::COLOR_BGR2GRAY);		// converting to gray
-	// scan this area for bright pixels.
+	return cv::Rect(location_rect.x, location_rect.y, location_rect.width / 4, location_rect.height);
+}
+
+cv::Size LocationDetector::GetOcrSize(const cv::Rect& location_rect, int ocr_game_width, cv::Size game_size)
+{
+	double scale_factor = ocr_game_width > 0 ? std::max(game_size.width / double(ocr_game_width), 1.0) : 1.0;
+	return cv::Size(int(location_rect.width / scale_factor), int(location_rect.height / scale_factor));
+}
+
+bool LocationDetector::EmptyTextEndsCascade(int ocr_game_width, int empty_text_game_width)
+{
+	return ocr_game_width == 0 || (empty_text_game_width > 0 && ocr_game_width >= empty_text_game_width);
+}
+
+void LocationDetector::UpdatePlan(cv::Size game_size)
+{
+	if (_plan.game_size == game_size)
+		return;
+
+	_plan.game_size = game_size;
+	_plan.location_rect = HudFrame::ToPixels(Region(), game_size);
+
+	_plan.early_out_rect = GetEarlyOutRect(_plan.location_rect);
+	_plan.early_out_kernel = location_kernels::FindEarlyOutKernel(game_size, _plan.location_rect);
+
+	// shrink the whole location frame to make OCR faster
+	_plan.levels.clear();
+	for (size_t i = 0; i < _ocr_game_widths.size(); i++)
 	{
-		uint32_t num_bright_pixel = 0;
-		for (int i = 0; i < locationMinimalFrame.rows; i++)
-		{
-			uint8_t* data = locationMinimalFrame.row(i).data;
-			for (int j = 0; j < locationMinimalFrame.cols; j++)
-				if (data[j] > _brightness_threshold)
-					num_bright_pixel++;
-		}
-		double bright_pixel_ratio = double(num_bright_pixel) / (locationMinimalFrame.rows * locationMinimalFrame.cols);
-		if (bright_pixel_ratio < _bright_pixel_ratio_low || bright_pixel_ratio > _bright_pixel_ratio_high)
-			return true;
+		cv::Size ocr_size = GetOcrSize(_plan.location_rect, _ocr_game_widths[i], game_size);
+
+		// levels that end up with the same size as a previous one wouldn't give a different result
+		if (std::any_of(_plan.levels.begin(), _plan.levels.end(), [&ocr_size](const Plan::Level& level) { return level.ocr_size == ocr_size; }))
+			continue;
+
+		Plan::Level& level = _plan.levels.emplace_back();
+		level.cascade_index = i;
+		level.ocr_size = ocr_size;
+		level.ocr_input_kernel = location_kernels::FindOcrInputKernel(game_size, _plan.location_rect, ocr_size);
+		level.empty_text_ends = EmptyTextEndsCascade(_ocr_game_widths[i], _empty_text_game_width);
+		level.ocr_input.create(ocr_size, CV_8UC4);
 	}
+}
 
-	return false;
+bool LocationDetector::EarlyOutTest(double bright_pixel_ratio) const
+{
+	return bright_pixel_ratio < _bright_pixel_ratio_low || bright_pixel_ratio > _bright_pixel_ratio_high;
 }
 
-std::string LocationDetector::FindBestLocationMatch(const std::string& loc_in)
+const LocationDetector::Location* LocationDetector::FindBestLocationMatch(std::string_view loc_in, int max_edit_percentage, uint32_t& num_edits)
 {
-	std::string loc_in_preprocessed = PreprocessLocationName(loc_in);
-	uint32_t max_allowed_edits = uint32_t(loc_in_preprocessed.size() / 5);			// allow maximum 1/5 recognition error
+	util::NormalizeTextForMatching(loc_in, _loc_in_preprocessed);
+	const std::string& loc_in_preprocessed = _loc_in_preprocessed;
+
+	// most OCR results are spelled right, those don't need the edit distance to every name
+	if (const Location* exact = FindExactLocationMatch(loc_in_preprocessed))
+	{
+		num_edits = 0;
+		return exact;
+	}
+
+	uint32_t max_allowed_edits = uint32_t(loc_in_preprocessed.size() * max_edit_percentage / 100);			// allow maximum 1/5 recognition error by default
 	uint32_t candidate_num_edits = max_allowed_edits + 1;
-	std::string candidate;
+	const Location* candidate = nullptr;
 	for (const Location& loc : _locations)
 	{
 		if (uint32_t(abs(int32_t(loc.preprocessed_name.size()) - int32_t(loc_in_preprocessed.size()))) > max_allowed_edits)
 			continue;
 
-		uint32_t num_edits = util::GetStringEditDistance(loc.preprocessed_name, loc_in_preprocessed, max_allowed_edits + 1);
+		uint32_t loc_num_edits = util::GetStringEditDistance(loc.preprocessed_name, loc_in_preprocessed, max_allowed_edits + 1);
 		// prefer shorter names if the editing distance is the same.
 		// This is because Tesseract might incorrectly recognize extra random characters inside the location bbox but after the names.
-		if (num_edits < candidate_num_edits || (num_edits == candidate_num_edits && candidate.size() > loc.name.size()))
+		if (loc_num_edits < candidate_num_edits || (loc_num_edits == candidate_num_edits && candidate && candidate->name.size() > loc.name.size()))
 		{
-			candidate_num_edits = num_edits;
-			candidate = loc.name;
+			candidate_num_edits = loc_num_edits;
+			candidate = &loc;
 		}
 	}
+	num_edits = candidate_num_edits;
 	return candidate;
 }
 
-std::string LocationDetector::GetLocation(const cv::Mat& game_img)
+const LocationDetector::Location* LocationDetector::FindExactLocationMatch(std::string_view loc_in_preprocessed) const
 {
-	// This is the bounding box of the longest location text in the lower left corner of the game screen.
-	constexpr double location_x0 = 0.038461538461;
-	constexpr double location_x1 = 0.502652519893;
-	constexpr double location_y0 = 0.838443396226;
-	constexpr double location_y1 = 0.926886792452;
-
-	// get the bounding box in rows / cols
-	uint32_t location_col0 = uint32_t(location_x0 * double(game_img.cols) + 0.5);
-	uint32_t location_col1 = uint32_t(location_x1 * double(game_img.cols) + 0.5);
-	uint32_t location_row0 = uint32_t(location_y0 * double(game_img.rows) + 0.5);
-	uint32_t location_row1 = uint32_t(location_y1 * double(game_img.rows) + 0.5);
-
-	if (EarlyOutTest(game_img, location_col0, location_col1, location_row0, location_row1))
-		return "";
-
-	// shrink the whole location frame to make OCR faster
-	cv::Mat location_frame;
-	double scale_factor = std::max(game_img.cols / 480.0, 1.0);	// according to experiments, it's still possible to recognize the location with high accuracy when the width of the game screen is 480.
-	cv::resize(game_img(cv::Rect(location_col0, location_row0, location_col1 - location_col0, location_row1 - location_row0)), location_frame, cv::Size(int((location_col1 - location_col0) / scale_factor), int((location_row1 - location_row0) / scale_factor)));
-
-	cv::cvtColor(location_frame, location_frame, cv::COLOR_BGR2GRAY);
-	for (int i = 0; i < location_frame.rows; i++)
+#ifdef HRT_BUILT_IN_LOCATIONS
+	if (_built_in_locations)
 	{
-		uint8_t* data = location_frame.row(i).data;
-		for (int j = 0; j < location_frame.cols; j++)
-			data[j] = 255 - (std::max(data[j], uint8_t(204)) - 204) * 5;		// invert the image so that the text is black-on-white. For some reason, Tesseract OCRs such text at almost double the speed compared to white-on-black text.
+		int index = location_table::Find(loc_in_preprocessed);
+		return index >= 0 ? &_locations[index] : nullptr;
 	}
-	cv::cvtColor(location_frame, location_frame, cv::COLOR_GRAY2BGRA);
-	//cv::cvtColor(location_frame, location_frame, cv::COLOR_BGR2BGRA);
+#endif
+	auto it = _exact_matches.find(loc_in_preprocessed);
+	return it != _exact_matches.end() ? &_locations[it->second] : nullptr;
+}
 
-	//imwrite("test.png", location_frame);
-	// convert to BGRA so that each pixel has 4 bytes (needed because opencv uses little-endian in Mat and leptonica uses big-endian in PIX)
-	//location_frame = cv::imread("test.png");
-	//cv::cvtColor(location_frame, location_frame, cv::COLOR_BGR2BGRA);
+void LocationDetector::OcrLocationBox(const cv::Mat& location_gray, cv::Size ocr_size, cv::Mat& ocr_input, OcrText& result)
+{
+	util::PreprocessBrightText(location_gray, cv::Rect(cv::Point(), location_gray.size()), nullptr, _brightness_threshold, cv::Rect(), &ocr_input, ocr_size);
+	RecognizeOcrInput(ocr_input, result);
+}
 
-	// reorder the channels in each pixel for leptonica
-	util::OpenCvMatBGRAToLeptonicaRGBAInplace(location_frame);
+void LocationDetector::RecognizeOcrInput(cv::Mat& ocr_input, OcrText& result)
+{
+	result.text.clear();
+	result.confidence = 0;
+	result.plausible = true;
 
-	// construct the PIX struct
+	cv::Mat& location_frame = ocr_input;
 	PIX pix;
-	memset(&pix, 0, sizeof(pix));
-	pixSetDimensions(&pix, location_frame.cols, location_frame.rows, 32);
-	pixSetWpl(&pix, location_frame.cols);
-	pixSetSpp(&pix, 4);
-	pix.refcount = 1;
-	pix.informat = IFF_UNKNOWN;
-	pixSetData(&pix, (l_uint32*)location_frame.data);
-
-	// OCR
+	util::WrapLeptonicaPix(location_frame, pix);
+
+	// OCR. Tesseract allocates on every call, that's not counted by -selftest
+	util::AllocationCountPause tesseract_allocations;
 	_tess_api.SetImage(&pix);
 	_tess_api.Recognize(0);
 
 	// some post-process
 	{
-		std::string boxes = std::unique_ptr<char[]>(_tess_api.GetBoxText(0)).get();
-		std::istringstream boxesstream(boxes);
-		std::string letter;
+		// only the first letter is checked, each line of the box text is "<letter> <x0> <y0> <x1> <y1> <page>"
+		std::unique_ptr<char[]> boxes(_tess_api.GetBoxText(0));
 		int letter_x0, letter_y0, letter_x1, letter_y1;
-		if (!(boxesstream >> letter >> letter_x0 >> letter_y0 >> letter_x1 >> letter_y1))
-			return "";
+		if (!boxes || sscanf_s(boxes.get(), "%*s %d %d %d %d", &letter_x0, &letter_y0, &letter_x1, &letter_y1) != 4)
+			return;		// nothing recognized, a higher resolution might help
 		if (letter_x0 > location_frame.rows / 2)		// text not starting from the left side of the location frame, one possibility is that dialog text is recognized (right side of the location bounding-box overlaps with the dialog box)
-			return "";
+		{
+			result.plausible = false;
+			return;
+		}
 		if (letter_x1 - letter_x0 > location_frame.rows)	// text bounding box is weird-shaped
-			return "";
+		{
+			result.plausible = false;
+			return;
+		}
 	}
 
-	std::string ret = std::unique_ptr<char[]>(_tess_api.GetUTF8Text()).get();
+	std::unique_ptr<char[]> text(_tess_api.GetUTF8Text());
+	if (!text)
+		return;
+	int confidence = _tess_api.MeanTextConf();
+	tesseract_allocations.Resume();
+	std::string_view ret(text.get());
 
 	// OCR text from tesseract sometimes ends with '\n', trim that
-	if (ret[ret.size() - 1] == '\n')
-		ret = ret.substr(0, ret.size() - 1);
+	if (ret.size() > 0 && ret[ret.size() - 1] == '\n')
+		ret.remove_suffix(1);
+	result.text.assign(ret);
+	result.confidence = confidence;
+}
+
+LocationDetector::Recognition LocationDetector::MatchLocation(const OcrText& ocr_text, int max_edit_percentage)
+{
+	Recognition result;
+	if (ocr_text.text.empty())
+		return result;
+	result.location = FindBestLocationMatch(ocr_text.text, max_edit_percentage, result.num_edits);
+	result.confidence = ocr_text.confidence;
+	return result;
+}
+
+bool LocationDetector::RecognizeLocation(const cv::Mat& location_gray, Plan::Level& level, Recognition& result)
+{
+	// the specialized kernel only fits the location box of the game size it was made for, cached boxes may come from another size
+	if (level.ocr_input_kernel && location_gray.size() == _plan.location_rect.size())
+	{
+		level.ocr_input_kernel(location_gray, level.ocr_input);
+		RecognizeOcrInput(level.ocr_input, _ocr_text);
+	}
+	else
+		OcrLocationBox(location_gray, level.ocr_size, level.ocr_input, _ocr_text);
+	if (!_ocr_text.plausible)
+		return false;
+	if (_ocr_text.text.empty())
+		return true;
 
-	return FindBestLocationMatch(ret);
+	TimeSpan& match_span = _match_spans.emplace_back();
+	match_span.begin = std::chrono::steady_clock::now();
+	result = MatchLocation(_ocr_text, _max_edit_percentage);
+	match_span.end = std::chrono::steady_clock::now();
+	return true;
+}
+
+bool LocationDetector::Cascade::Add(const Recognition& result, size_t cascade_index, int min_ocr_confidence)
+{
+	// prefer higher resolution when the results are equally good
+	if (result.location && (!best.location || result.num_edits <= best.num_edits))
+	{
+		best = result;
+		best_cascade_index = cascade_index;
+	}
+	return result.location && result.num_edits == 0 && result.confidence >= min_ocr_confidence;
+}
+
+bool LocationDetector::Screen(HudFrame& frame, const cv::Rect& rect)
+{
+	UpdatePlan(frame.Size());
+
+	// scan this area for bright pixels, straight from the game image without converting it to gray first
+	const cv::Rect& early_out_rect = _plan.early_out_rect;
+	const cv::Mat& game_img = frame.GameImage();
+	uint32_t num_bright_pixel;
+	if (_plan.early_out_kernel && !frame.RangeLut() && game_img.type() == CV_8UC3)
+		num_bright_pixel = _plan.early_out_kernel(game_img, _brightness_threshold);
+	else
+		num_bright_pixel = util::PreprocessBrightText(game_img, early_out_rect, frame.RangeLut(), _brightness_threshold,
+			cv::Rect(cv::Point(), early_out_rect.size()), nullptr, cv::Size());
+	_last_bright_pixel_ratio = double(num_bright_pixel) / early_out_rect.area();
+	return !EarlyOutTest(_last_bright_pixel_ratio);
+}
+
+bool LocationDetector::Detect(HudFrame& frame, const cv::Rect& rect, HudEvent& event)
+{
+	UpdatePlan(frame.Size());
+	// the box is converted to gray once per frame, the classifier and every cascade level read that
+	cv::Mat location_gray = frame.Gray(_plan.location_rect);
+	if (HasBannerClassifier() && !PassesBannerClassifier(location_gray))
+		return false;
+	return DetectInLocationBox(location_gray, frame.Size(), event);
+}
+
+bool LocationDetector::PassesBannerClassifier(const cv::Mat& location_gray)
+{
+	if (!_banner_classifier.IsLoaded())
+		return true;
+
+	_num_banner_checks++;
+	if (_banner_classifier.IsBanner(location_gray))
+		return true;
+	_num_banner_rejected++;
+	return false;
+}
+
+bool LocationDetector::DetectInLocationBox(const cv::Mat& location_gray, cv::Size game_size, HudEvent& event)
+{
+	UpdatePlan(game_size);
+
+	// go up the cascade until the OCR result is good enough, keep the best result in case none of them is
+	Cascade cascade;
+	_match_spans.clear();
+	auto tdetect = std::chrono::steady_clock::now();
+	for (Plan::Level& level : _plan.levels)
+	{
+		auto tbegin = std::chrono::steady_clock::now();
+		Recognition result;
+		bool plausible = RecognizeLocation(location_gray, level, result);
+		auto tend = std::chrono::steady_clock::now();
+
+		CascadeLevelStats& stats = _cascade_stats[level.cascade_index];
+		stats.num_ocr++;
+		stats.ocr_time_us += std::chrono::duration_cast<std::chrono::microseconds>(tend - tbegin).count();
+
+		// the text is at the wrong place, it's not a location at any resolution
+		if (!plausible || cascade.Add(result, level.cascade_index, _min_ocr_confidence))
+			break;
+		// no text at a resolution where a location name would be readable, a higher one won't find any either
+		if (level.empty_text_ends && _ocr_text.text.empty())
+		{
+			stats.num_empty_ends++;
+			break;
+		}
+	}
+	_num_detect++;
+	_detect_time_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tdetect).count();
+
+	if (!cascade.best.location)
+		return false;
+
+	_cascade_stats[cascade.best_cascade_index].num_resolved++;
+	event.text = cascade.best.location->name;
+	return true;
+}
+
+std::string_view LocationDetector::GetLocation(const cv::Mat& game_img)
+{
+	_frame.Reset(game_img);
+	cv::Rect rect = _frame.ToPixels(Region());
+	HudEvent event;
+	if (!Screen(_frame, rect) || !Detect(_frame, rect, event))
+		return "";
+	return event.text;
+}
+
+std::string LocationDetector::GetCascadeReport() const
+{
+	std::ostringstream os;
+	os << "OCR cascade:" << std::endl;
+	uint64_t total_resolved = 0;
+	for (const CascadeLevelStats& stats : _cascade_stats)
+		total_resolved += stats.num_resolved;
+	for (size_t i = 0; i < _cascade_stats.size(); i++)
+	{
+		const CascadeLevelStats& stats = _cascade_stats[i];
+		uint64_t num_ocr = stats.num_ocr, num_resolved = stats.num_resolved;
+		char buf[200];
+		sprintf_s(buf, "  game width %5s: %8llu OCRs, avg %6.2fms, %8llu locations (%5.1f%%), %8llu ended without text",
+			_ocr_game_widths[i] > 0 ? std::to_string(_ocr_game_widths[i]).c_str() : "full",
+			(unsigned long long)num_ocr, num_ocr ? stats.ocr_time_us / 1000.0 / num_ocr : 0.0,
+			(unsigned long long)num_resolved, total_resolved ? num_resolved * 100.0 / total_resolved : 0.0,
+			(unsigned long long)uint64_t(stats.num_empty_ends));
+		os << buf << std::endl;
+	}
+	if (_banner_classifier.IsLoaded())
+	{
+		uint64_t num_checks = _num_banner_checks, num_rejected = _num_banner_rejected;
+		os << "  banner classifier: " << num_rejected << " of " << num_checks << " boxes rejected before OCR" << std::endl;
+	}
+	return os.str();
 }
 
 LocationDetector::~LocationDetector()
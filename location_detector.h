@@ -1,35 +1,220 @@
+#pragma once
 #include "common.h"
+#include "hud_engine.h"
+#include "banner_classifier.h"
+#include "location_kernels.h"
+#include <atomic>
+#include <unordered_map>
 
 
-class LocationDetector
+class LocationDetector : public RegionDetector
 {
-private:
+public:
 	struct Location
 	{
 		std::string name;
 		std::string preprocessed_name;
 	};
 
+	// the OCR text of the location box at one size, before it's looked up in the location list
+	struct OcrText
+	{
+		std::string text;
+		int confidence = 0;
+		bool plausible = true;		// false if the text is not where a location name would be
+	};
+
+	// result of OCR on one cascade level
+	struct Recognition
+	{
+		const Location* location = nullptr;
+		uint32_t num_edits = 0;
+		int confidence = 0;
+	};
+
+	// the decision of the OCR cascade, fed with the recognitions from low to high resolution
+	struct Cascade
+	{
+		Recognition best;
+		size_t best_cascade_index = 0;
+
+		// returns true if result is good enough to stop going up the cascade
+		bool Add(const Recognition& result, size_t cascade_index, int min_ocr_confidence);
+	};
+
+private:
+
+	// Everything the detection needs that only depends on the size of the game image.
+	// It's rebuilt when the input size changes, so that the per-frame path doesn't compute the geometry again or allocate any memory.
+	struct Plan
+	{
+		// one step of the OCR cascade
+		struct Level
+		{
+			size_t cascade_index = 0;		// index into _ocr_game_widths / _cascade_stats
+			cv::Size ocr_size;				// size of the location box after shrinking
+			location_kernels::OcrInputKernel ocr_input_kernel = nullptr;		// for the common game sizes
+			bool empty_text_ends = false;		// a read without text ends the cascade here, see Config::empty_text_game_width
+
+			// reusable buffer
+			cv::Mat ocr_input;				// BGRA, channels reordered for leptonica
+		};
+
+		cv::Size game_size;
+		cv::Rect location_rect;				// bounding box of the location text
+		cv::Rect early_out_rect;			// area peeked by EarlyOutTest()
+		location_kernels::EarlyOutKernel early_out_kernel = nullptr;		// for BGR input of the common sizes
+		std::vector<Level> levels;			// cascade levels from low to high resolution, levels with the same scale are merged
+	};
+
+public:
+	struct Config
+	{
+		// location text has brightness of 245+. Use a loose threshold here to account for blur / compression loss or any filter that camera might apply
+		// This is a conservative range, usually it's around 18% - 25%
+		int brightness_threshold = 240;
+		int bright_pixel_ratio_low = 15, bright_pixel_ratio_high = 30;		// in percentage
+
+		// widths the game screen is shrunk to for OCR, tried in order until the result is good enough. 0 means full resolution
+		std::vector<int> ocr_game_widths = { 240, 480, 0 };
+		// lower levels of the cascade are only trusted if the OCR text matches a location exactly with at least this confidence (0-100)
+		int min_ocr_confidence = 70;
+		// a level of at least this width (or full resolution) that reads no text ends the cascade, most boxes that pass the early-out
+		// are snow or sky. Below it small text can vanish, so the next level is tried
+		int empty_text_game_width = 480;
+		// OCR text can differ from a location name by this percentage of its length and still match
+		int max_edit_percentage = 20;
+
+		// file to load the location list from instead of the list built into the program
+		std::string location_file;
+
+		// Tesseract model of all OCR regions
+		util::OcrModel ocr_model;
+
+		// banner classifier trained with -train, run on the boxes that pass the bright pixel ratio test before they go to OCR. None if empty
+		std::string banner_model_file;
+	};
+
+	struct TimeSpan
+	{
+		std::chrono::steady_clock::time_point begin, end;
+	};
+
+	struct CascadeLevelStats
+	{
+		std::atomic<uint64_t> num_ocr = 0;			// number of times OCR ran on this level
+		std::atomic<uint64_t> num_resolved = 0;		// number of detected locations that came from this level
+		std::atomic<uint64_t> num_empty_ends = 0;	// number of times a read without text ended the cascade on this level
+		std::atomic<uint64_t> ocr_time_us = 0;
+	};
+
 private:
 	tesseract::TessBaseAPI _tess_api;
 	std::vector<Location> _locations;
+	bool _built_in_locations = false;		// _locations is in the order of location_table
+	std::unordered_map<std::string_view, size_t> _exact_matches;		// preprocessed name to index in _locations, for a location file
 	int _brightness_threshold = 240;
 	double _bright_pixel_ratio_low = 0.15, _bright_pixel_ratio_high = 0.3;
+	double _last_bright_pixel_ratio = 0.0;		// of the last Screen()
+
+	// OCR cascade: the location box is first recognized with the game screen shrunk to the first width,
+	// the next width is only tried if the result is not good enough.
+	std::vector<int> _ocr_game_widths;
+	std::vector<CascadeLevelStats> _cascade_stats;
+	int _min_ocr_confidence = 70;
+	int _max_edit_percentage = 20;
+	int _empty_text_game_width = 480;
+
+	uint64_t _num_detect = 0, _detect_time_us = 0;		// for Cost()
+
+	BannerClassifier _banner_classifier;
+	std::atomic<uint64_t> _num_banner_checks = 0, _num_banner_rejected = 0;
+	std::vector<TimeSpan> _match_spans;		// of the last detection, for tracing
+
+	Plan _plan;
+	std::string _loc_in_preprocessed;		// buffer for FindBestLocationMatch()
+	OcrText _ocr_text;						// buffer for RecognizeLocation()
+	HudFrame _frame;						// for GetLocation()
 
 private:
-	bool InitLocationList(const char* lang);
+	bool InitLocationList(const char* lang, const std::string& location_file);
+
+	// make sure _plan matches the size of the game image
+	void UpdatePlan(cv::Size game_size);
 
 	// returns true if this image should be early-outed, i.e. it's not likely it has a location in the image
-	bool EarlyOutTest(const cv::Mat& game_img, uint32_t location_col0, uint32_t location_col1, uint32_t location_row0, uint32_t location_row1);
+	bool EarlyOutTest(double bright_pixel_ratio) const;
+
+	// OCR the gray location box on one cascade level, returns false if the text is not where a location name would be
+	bool RecognizeLocation(const cv::Mat& location_gray, Plan::Level& level, Recognition& result);
 
-	// Lookup the location list and find the best match for the detected location string
-	std::string FindBestLocationMatch(const std::string& loc_in);
+	// the OCR of a preprocessed location box, see OcrLocationBox()
+	void RecognizeOcrInput(cv::Mat& ocr_input, OcrText& result);
+
+	// Lookup the location list and find the best match for the detected location string, returns nullptr if nothing matches
+	const Location* FindBestLocationMatch(std::string_view loc_in, int max_edit_percentage, uint32_t& num_edits);
+	const Location* FindExactLocationMatch(std::string_view loc_in_preprocessed) const;
 
 public:
+	static constexpr char region_name[] = "location";
+
 	LocationDetector() = default;
 	~LocationDetector();
-	bool Init(const char* lang, int brightness_threshold, int bright_pixel_ratio_low, int bright_pixel_ratio_high);
 
-	// returns empty string if nothing is detected
-	std::string GetLocation(const cv::Mat& game_img);
+	// with screen_only, the OCR model and the location list are not loaded, only Screen() can be used
+	bool Init(const char* lang, const Config& config, bool screen_only = false);
+
+	// RegionDetector
+	const char* Name() const override { return region_name; }
+	cv::Rect2d Region() const override { return GetLocationRegion(); }
+	bool IsOcrBound() const override { return true; }
+	double Cost() const override;
+	bool Screen(HudFrame& frame, const cv::Rect& rect) override;
+	bool Detect(HudFrame& frame, const cv::Rect& rect, HudEvent& event) override;
+
+	// This is the bounding box of the longest location text in the lower left corner of the game screen, relative to the game size
+	static constexpr double location_x0 = 0.038461538461;
+	static constexpr double location_x1 = 0.502652519893;
+	static constexpr double location_y0 = 0.838443396226;
+	static constexpr double location_y1 = 0.926886792452;
+
+	// Region() without an instance
+	static cv::Rect2d GetLocationRegion();
+
+	// the area of the location box that the early-out looks at
+	static cv::Rect GetEarlyOutRect(const cv::Rect& location_rect);
+
+	// size the location box is shrunk to for OCR with the game image ocr_game_width wide, 0 means full resolution
+	static cv::Size GetOcrSize(const cv::Rect& location_rect, int ocr_game_width, cv::Size game_size);
+	// whether a read without text on the level of ocr_game_width ends the cascade
+	static bool EmptyTextEndsCascade(int ocr_game_width, int empty_text_game_width);
+
+	// the early-out and the detection on the location box alone, for re-analysing cached boxes.
+	// bright_pixel_ratio is the ratio of pixels in GetEarlyOutRect() that are brighter than BrightnessThreshold()
+	int BrightnessThreshold() const { return _brightness_threshold; }
+	bool ScreenLocationBox(double bright_pixel_ratio) const { return !EarlyOutTest(bright_pixel_ratio); }
+	double LastBrightPixelRatio() const { return _last_bright_pixel_ratio; }
+	bool DetectInLocationBox(const cv::Mat& location_gray, cv::Size game_size, HudEvent& event);
+
+	// The two steps of a cascade level on their own, for evaluating several configurations on the same OCR (see ParameterSweep).
+	// ocr_input is a reusable buffer
+	void OcrLocationBox(const cv::Mat& location_gray, cv::Size ocr_size, cv::Mat& ocr_input, OcrText& result);
+	Recognition MatchLocation(const OcrText& ocr_text, int max_edit_percentage);
+
+	// false if the banner classifier is loaded and the box doesn't look like a banner, Detect() skips the OCR then
+	bool HasBannerClassifier() const { return _banner_classifier.IsLoaded(); }
+	bool PassesBannerClassifier(const cv::Mat& location_gray);
+
+	// Detect the location on a game image without a HudEngine.
+	// returns empty string if nothing is detected.
+	// The returned string is owned by the detector and stays valid until the detector is destroyed.
+	std::string_view GetLocation(const cv::Mat& game_img);
+
+	// when the OCR text was looked up in the location list during the last detection, once per cascade level that was tried
+	const std::vector<TimeSpan>& LastMatchSpans() const { return _match_spans; }
+
+	// statistics of how often each OCR cascade level is needed, in a human-readable form
+	std::string GetCascadeReport() const;
+	// number of OCRs on one cascade level so far
+	uint64_t NumOcr(size_t cascade_index) const { return _cascade_stats[cascade_index].num_ocr; }
 };
\ No newline at end of file
@@ -0,0 +1,149 @@
+#include "location_kernels.h"
+#include "location_detector.h"
+#include <array>
+
+namespace location_kernels
+{
+	namespace
+	{
+		// HudFrame::ToPixels() of LocationDetector::GetLocationRegion(), with the same floating point steps
+		template <int GameWidth, int GameHeight>
+		struct Geometry
+		{
+			static constexpr double x0 = LocationDetector::location_x0, x1 = LocationDetector::location_x1;
+			static constexpr double y0 = LocationDetector::location_y0, y1 = LocationDetector::location_y1;
+			static constexpr int x = int(x0 * GameWidth + 0.5);
+			static constexpr int y = int(y0 * GameHeight + 0.5);
+			static constexpr int width = int((x0 + (x1 - x0)) * GameWidth + 0.5) - x;
+			static constexpr int height = int((y0 + (y1 - y0)) * GameHeight + 0.5) - y;
+			static constexpr int early_out_width = width / 4;		// LocationDetector::GetEarlyOutRect()
+		};
+
+		// LocationDetector::GetOcrSize()
+		template <int GameWidth, int GameHeight, int OcrGameWidth>
+		struct OcrSize
+		{
+			static constexpr double scale_factor = OcrGameWidth > 0 ? std::max(GameWidth / double(OcrGameWidth), 1.0) : 1.0;
+			static constexpr int width = int(Geometry<GameWidth, GameHeight>::width / scale_factor);
+			static constexpr int height = int(Geometry<GameWidth, GameHeight>::height / scale_factor);
+		};
+
+		// first source column / row of each cell and the end of the last one, as in util::PreprocessBrightText()
+		template <int Size, int NumCells>
+		constexpr std::array<int, NumCells + 1> GetCellBounds()
+		{
+			std::array<int, NumCells + 1> bounds = {};
+			for (int i = 0; i <= NumCells; i++)
+				bounds[i] = i * Size / NumCells;
+			return bounds;
+		}
+
+		template <int GameWidth, int GameHeight>
+		uint32_t CountEarlyOut(const cv::Mat& game_img, int brightness_threshold)
+		{
+			using G = Geometry<GameWidth, GameHeight>;
+			uint32_t num_bright = 0;
+			for (int row = 0; row < G::height; row++)
+			{
+				const uint8_t* src = game_img.ptr<uint8_t>(G::y + row) + G::x * 3;
+				for (int col = 0; col < G::early_out_width; col++, src += 3)
+					num_bright += util::BgrToGray(src) > brightness_threshold;
+			}
+			return num_bright;
+		}
+
+		template <int GameWidth, int GameHeight, int OcrGameWidth>
+		void MakeOcrInput(const cv::Mat& location_gray, cv::Mat& ocr_input)
+		{
+			using G = Geometry<GameWidth, GameHeight>;
+			constexpr int ocr_width = OcrSize<GameWidth, GameHeight, OcrGameWidth>::width;
+			constexpr int ocr_height = OcrSize<GameWidth, GameHeight, OcrGameWidth>::height;
+			constexpr std::array<int, ocr_width + 1> cell_cols = GetCellBounds<G::width, ocr_width>();
+			constexpr std::array<int, ocr_height + 1> cell_rows = GetCellBounds<G::height, ocr_height>();
+
+			// every cell is cell_width or cell_width + 1 columns wide, the extra column only exists if the ratio is not an integer
+			constexpr int cell_width = G::width / ocr_width;
+			constexpr bool integer_ratio = G::width % ocr_width == 0;
+
+			ocr_input.create(ocr_height, ocr_width, CV_8UC4);
+			uint32_t sums[ocr_width];
+			for (int cell_row = 0; cell_row < ocr_height; cell_row++)
+			{
+				std::fill(sums, sums + ocr_width, 0u);
+				for (int row = cell_rows[cell_row]; row < cell_rows[cell_row + 1]; row++)
+				{
+					const uint8_t* src = location_gray.ptr<uint8_t>(row);
+					for (int cell = 0; cell < ocr_width; cell++)
+					{
+						uint32_t sum = 0;
+						for (int i = 0; i < cell_width; i++)
+							sum += src[i];
+						src += cell_width;
+						if constexpr (!integer_ratio)
+						{
+							if (cell_cols[cell + 1] - cell_cols[cell] > cell_width)
+								sum += *src++;
+						}
+						sums[cell] += sum;
+					}
+				}
+
+				uint32_t* dst = ocr_input.ptr<uint32_t>(cell_row);
+				uint32_t cell_height = uint32_t(cell_rows[cell_row + 1] - cell_rows[cell_row]);
+				for (int cell = 0; cell < ocr_width; cell++)
+				{
+					uint32_t cell_area = uint32_t(cell_cols[cell + 1] - cell_cols[cell]) * cell_height;
+					dst[cell] = util::ToOcrInputPixel(int((sums[cell] + cell_area / 2) / cell_area));
+				}
+			}
+		}
+
+		struct Entry
+		{
+			cv::Size game_size;
+			cv::Rect location_rect;
+			EarlyOutKernel early_out;
+			cv::Size ocr_size;
+			OcrInputKernel ocr_input;
+		};
+
+		template <int GameWidth, int GameHeight, int OcrGameWidth>
+		Entry MakeEntry()
+		{
+			using G = Geometry<GameWidth, GameHeight>;
+			using O = OcrSize<GameWidth, GameHeight, OcrGameWidth>;
+			return { cv::Size(GameWidth, GameHeight), cv::Rect(G::x, G::y, G::width, G::height), &CountEarlyOut<GameWidth, GameHeight>,
+				cv::Size(O::width, O::height), &MakeOcrInput<GameWidth, GameHeight, OcrGameWidth> };
+		}
+
+		// the sizes FFmpegWrap captures at and the usual source size, with the default LocationDetector::Config::ocr_game_widths
+		const std::vector<Entry>& GetEntries()
+		{
+			static const std::vector<Entry> entries = {
+				MakeEntry<1280, 720, 240>(), MakeEntry<1280, 720, 480>(), MakeEntry<1280, 720, 0>(),
+				MakeEntry<1920, 1080, 240>(), MakeEntry<1920, 1080, 480>(), MakeEntry<1920, 1080, 0>(),
+			};
+			return entries;
+		}
+	}
+
+	EarlyOutKernel FindEarlyOutKernel(cv::Size game_size, const cv::Rect& location_rect)
+	{
+		for (const Entry& entry : GetEntries())
+		{
+			if (entry.game_size == game_size && entry.location_rect == location_rect)
+				return entry.early_out;
+		}
+		return nullptr;
+	}
+
+	OcrInputKernel FindOcrInputKernel(cv::Size game_size, const cv::Rect& location_rect, cv::Size ocr_size)
+	{
+		for (const Entry& entry : GetEntries())
+		{
+			if (entry.game_size == game_size && entry.location_rect == location_rect && entry.ocr_size == ocr_size)
+				return entry.ocr_input;
+		}
+		return nullptr;
+	}
+}
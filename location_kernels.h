@@ -0,0 +1,18 @@
+#pragma once
+#include "common.h"
+
+
+// Preprocessing of the location box specialized at compile time for the common capture sizes 1280x720 and 1920x1080 with the default
+// OCR cascade. The box geometry, the cell bounds of the shrinking and all loop counts are constants, and each cell sums a fixed number of
+// pixels per row. The output is the same as util::PreprocessBrightText(), any other size or input takes that generic path.
+namespace location_kernels
+{
+	// number of pixels brighter than brightness_threshold in the early-out area of the game image
+	using EarlyOutKernel = uint32_t(*)(const cv::Mat& game_img, int brightness_threshold);
+	// OCR input of the gray location box, i.e. HudFrame::Gray() of the location rect
+	using OcrInputKernel = void(*)(const cv::Mat& location_gray, cv::Mat& ocr_input);
+
+	// null if there's no kernel for the game size. location_rect is checked against the geometry the kernel was built with
+	EarlyOutKernel FindEarlyOutKernel(cv::Size game_size, const cv::Rect& location_rect);
+	OcrInputKernel FindOcrInputKernel(cv::Size game_size, const cv::Rect& location_rect, cv::Size ocr_size);
+}
@@ -0,0 +1,408 @@
+#pragma once
+// Generated by gen_location_table.py from bin/eng_locations.txt, do not edit.
+#include <cstdint>
+#include <string_view>
+
+
+// The English location list built into the program, with a perfect hash of the preprocessed names for exact matching
+namespace location_table
+{
+	struct Entry
+	{
+		std::string_view name;
+		std::string_view preprocessed_name;		// result of util::NormalizeTextForMatching()
+	};
+
+	constexpr Entry entries[] = {
+		{ "Abandoned North Mine", "ABANDONEDNORTHMINE" },
+		{ "Akh Va'quot Shrine", "AKHVAQUOTSHRINE" },
+		{ "Akkala Ancient Tech Lab", "AKKALAANCIENTTECHLAB" },
+		{ "Akkala Bridge Ruins", "AKKALABRIDGERUINS" },
+		{ "Akkala Citadel Ruins", "AKKALACITADELRUINS" },
+		{ "Akkala Parade Ground Ruins", "AKKALAPARADEGROUNDRUINS" },
+		{ "Akkala Span", "AKKALASPAN" },
+		{ "Akkala Tower", "AKKALATOWER" },
+		{ "Ancient Columns", "ANCIENTCOLUMNS" },
+		{ "Ancient Tree Stump", "ANCIENTTREESTUMP" },
+		{ "Aquame Bridge", "AQUAMEBRIDGE" },
+		{ "Arbiter's Grounds", "ARBITERSGROUNDS" },
+		{ "Bareeda Naag Shrine", "BAREEDANAAGSHRINE" },
+		{ "Big Twin Bridge", "BIGTWINBRIDGE" },
+		{ "Boneyard Bridge", "BONEYARDBRIDGE" },
+		{ "Bosh Kala Shrine", "BOSHKALASHRINE" },
+		{ "Bridge of Eldin", "BRIDGEOFELDIN" },
+		{ "Bridge of Hylia", "BRIDGEOFHYLIA" },
+		{ "Carok Bridge", "CAROKBRIDGE" },
+		{ "Castle Town Prison", "CASTLETOWNPRISON" },
+		{ "Castle Town Watchtower", "CASTLETOWNWATCHTOWER" },
+		{ "Central Square", "CENTRALSQUARE" },
+		{ "Central Tower", "CENTRALTOWER" },
+		{ "Chaas Qeta Shrine", "CHAASQETASHRINE" },
+		{ "Coliseum Ruins", "COLISEUMRUINS" },
+		{ "Daag Chokah Shrine", "DAAGCHOKAHSHRINE" },
+		{ "Dagah Keek Shrine", "DAGAHKEEKSHRINE" },
+		{ "Dah Hesho Shrine", "DAHHESHOSHRINE" },
+		{ "Dah Kaso Shrine", "DAHKASOSHRINE" },
+		{ "Daka Tuss Shrine", "DAKATUSSSHRINE" },
+		{ "Dako Tah Shrine", "DAKOTAHSHRINE" },
+		{ "Daqa Koh Shrine", "DAQAKOHSHRINE" },
+		{ "Daqo Chisay Shrine", "DAQOCHISAYSHRINE" },
+		{ "Deya Village Ruins", "DEYAVILLAGERUINS" },
+		{ "Digdogg Suspension Bridge", "DIGDOGGSUSPENSIONBRIDGE" },
+		{ "Dila Maag Shrine", "DILAMAAGSHRINE" },
+		{ "Dining Hall", "DININGHALL" },
+		{ "Divine Beast Vah Medoh", "DIVINEBEASTVAHMEDOH" },
+		{ "Divine Beast Vah Naboris", "DIVINEBEASTVAHNABORIS" },
+		{ "Divine Beast Vah Rudania", "DIVINEBEASTVAHRUDANIA" },
+		{ "Divine Beast Vah Ruta", "DIVINEBEASTVAHRUTA" },
+		{ "Docks", "DOCKS" },
+		{ "Dow Na'eh Shrine", "DOWNAEHSHRINE" },
+		{ "Dragon Bone Mire", "DRAGONBONEMIRE" },
+		{ "Dueling Peaks Stable", "DUELINGPEAKSSTABLE" },
+		{ "Dueling Peaks Tower", "DUELINGPEAKSTOWER" },
+		{ "Dunba Taag Shrine", "DUNBATAAGSHRINE" },
+		{ "Eagus Bridge", "EAGUSBRIDGE" },
+		{ "East Akkala Stable", "EASTAKKALASTABLE" },
+		{ "East Gerudo Ruins", "EASTGERUDORUINS" },
+		{ "East Passage", "EASTPASSAGE" },
+		{ "East Post Ruins", "EASTPOSTRUINS" },
+		{ "East Reservoir Lake", "EASTRESERVOIRLAKE" },
+		{ "East Sokkala Bridge", "EASTSOKKALABRIDGE" },
+		{ "Eldin Great Skeleton", "ELDINGREATSKELETON" },
+		{ "Eldin Tower", "ELDINTOWER" },
+		{ "Etsu Korima Shrine", "ETSUKORIMASHRINE" },
+		{ "Eventide Island", "EVENTIDEISLAND" },
+		{ "Exchange Ruins", "EXCHANGERUINS" },
+		{ "Faron Tower", "FARONTOWER" },
+		{ "Faron Woods", "FARONWOODS" },
+		{ "First Gatehouse", "FIRSTGATEHOUSE" },
+		{ "Flight Range", "FLIGHTRANGE" },
+		{ "Floret Sandbar", "FLORETSANDBAR" },
+		{ "Floria Bridge", "FLORIABRIDGE" },
+		{ "Foothill Stable", "FOOTHILLSTABLE" },
+		{ "Footrace Check-In", "FOOTRACECHECK-IN" },
+		{ "Forgotten Temple", "FORGOTTENTEMPLE" },
+		{ "Fort Hateno", "FORTHATENO" },
+		{ "Gatepost Town Ruins", "GATEPOSTTOWNRUINS" },
+		{ "Gee Ha'rah Shrine", "GEEHARAHSHRINE" },
+		{ "Gerudo Canyon Pass", "GERUDOCANYONPASS" },
+		{ "Gerudo Canyon Stable", "GERUDOCANYONSTABLE" },
+		{ "Gerudo Desert Gateway", "GERUDODESERTGATEWAY" },
+		{ "Gerudo Great Skeleton", "GERUDOGREATSKELETON" },
+		{ "Gerudo Tower", "GERUDOTOWER" },
+		{ "Gerudo Town", "GERUDOTOWN" },
+		{ "Gisa Crater", "GISACRATER" },
+		{ "Gleeok Bridge", "GLEEOKBRIDGE" },
+		{ "Goflam's Secret Hot Spring", "GOFLAMSSECRETHOTSPRING" },
+		{ "Goma Asaagh Shrine", "GOMAASAAGHSHRINE" },
+		{ "Goponga Village Ruins", "GOPONGAVILLAGERUINS" },
+		{ "Gorae Torr Shrine", "GORAETORRSHRINE" },
+		{ "Goron City", "GORONCITY" },
+		{ "Great Fairy Fountain", "GREATFAIRYFOUNTAIN" },
+		{ "Great Plateau", "GREATPLATEAU" },
+		{ "Great Plateau Tower", "GREATPLATEAUTOWER" },
+		{ "Guards' Chamber", "GUARDSCHAMBER" },
+		{ "Guchini Plain Barrows", "GUCHINIPLAINBARROWS" },
+		{ "Gut Check Rock", "GUTCHECKROCK" },
+		{ "Ha Dahamar Shrine", "HADAHAMARSHRINE" },
+		{ "Hateno Ancient Tech Lab", "HATENOANCIENTTECHLAB" },
+		{ "Hateno Tower", "HATENOTOWER" },
+		{ "Hateno Village", "HATENOVILLAGE" },
+		{ "Hawa Koth Shrine", "HAWAKOTHSHRINE" },
+		{ "Hebra Great Skeleton", "HEBRAGREATSKELETON" },
+		{ "Hebra Tower", "HEBRATOWER" },
+		{ "Hebra Trailhead Lodge", "HEBRATRAILHEADLODGE" },
+		{ "Helmhead Bridge", "HELMHEADBRIDGE" },
+		{ "Hia Miu Shrine", "HIAMIUSHRINE" },
+		{ "Highland Stable", "HIGHLANDSTABLE" },
+		{ "Hila Rao Shrine", "HILARAOSHRINE" },
+		{ "Horse God Bridge", "HORSEGODBRIDGE" },
+		{ "Horwell Bridge", "HORWELLBRIDGE" },
+		{ "Hyrule Castle", "HYRULECASTLE" },
+		{ "Hyrule Castle Town Ruins", "HYRULECASTLETOWNRUINS" },
+		{ "Hyrule Cathedral", "HYRULECATHEDRAL" },
+		{ "Hyrule Forest Park", "HYRULEFORESTPARK" },
+		{ "Hyrule Garrison Ruins", "HYRULEGARRISONRUINS" },
+		{ "Inogo Bridge", "INOGOBRIDGE" },
+		{ "Ishto Soh Shrine", "ISHTOSOHSHRINE" },
+		{ "Ja Baij Shrine", "JABAIJSHRINE" },
+		{ "Jeddo Bridge", "JEDDOBRIDGE" },
+		{ "Jee Noh Shrine", "JEENOHSHRINE" },
+		{ "Jitan Sa'mi Shrine", "JITANSAMISHRINE" },
+		{ "Joloo Nah Shrine", "JOLOONAHSHRINE" },
+		{ "Kaam Ya'tak Shrine", "KAAMYATAKSHRINE" },
+		{ "Kah Mael Shrine", "KAHMAELSHRINE" },
+		{ "Kah Okeo Shrine", "KAHOKEOSHRINE" },
+		{ "Kah Yah Shrine", "KAHYAHSHRINE" },
+		{ "Kakariko Bridge", "KAKARIKOBRIDGE" },
+		{ "Kakariko Village", "KAKARIKOVILLAGE" },
+		{ "Kam Urog Shrine", "KAMUROGSHRINE" },
+		{ "Kamia Omuna Shrine", "KAMIAOMUNASHRINE" },
+		{ "Ka'o Makagh Shrine", "KAOMAKAGHSHRINE" },
+		{ "Kara Kara Bazaar", "KARAKARABAZAAR" },
+		{ "Katah Chuki Shrine", "KATAHCHUKISHRINE" },
+		{ "Katosa Aug Shrine", "KATOSAAUGSHRINE" },
+		{ "Kay Noh Shrine", "KAYNOHSHRINE" },
+		{ "Kaya Wan Shrine", "KAYAWANSHRINE" },
+		{ "Kayra Mah Shrine", "KAYRAMAHSHRINE" },
+		{ "Kee Dafunia Shrine", "KEEDAFUNIASHRINE" },
+		{ "Keeha Yoog Shrine", "KEEHAYOOGSHRINE" },
+		{ "Keh Namut Shrine", "KEHNAMUTSHRINE" },
+		{ "Keive Tala Shrine", "KEIVETALASHRINE" },
+		{ "Kema Kosassa Shrine", "KEMAKOSASSASHRINE" },
+		{ "Kema Zoos Shrine", "KEMAZOOSSHRINE" },
+		{ "Ke'nai Shakah Shrine", "KENAISHAKAHSHRINE" },
+		{ "Keo Ruug Shrine", "KEORUUGSHRINE" },
+		{ "Ketoh Wawai Shrine", "KETOHWAWAISHRINE" },
+		{ "Kiah Toza Shrine", "KIAHTOZASHRINE" },
+		{ "Kihiro Moh Shrine", "KIHIROMOHSHRINE" },
+		{ "King's Study", "KINGSSTUDY" },
+		{ "Kolomo Garrison Ruins", "KOLOMOGARRISONRUINS" },
+		{ "Korgu Chideh Shrine", "KORGUCHIDEHSHRINE" },
+		{ "Korok Forest", "KOROKFOREST" },
+		{ "Korsh O'hu Shrine", "KORSHOHUSHRINE" },
+		{ "Kuh Takkar Shrine", "KUHTAKKARSHRINE" },
+		{ "Kuhn Sidajj Shrine", "KUHNSIDAJJSHRINE" },
+		{ "Lake Tower", "LAKETOWER" },
+		{ "Lakeside Stable", "LAKESIDESTABLE" },
+		{ "Lakna Rokee Shrine", "LAKNAROKEESHRINE" },
+		{ "Lanayru Promenade", "LANAYRUPROMENADE" },
+		{ "Lanayru Road - East Gate", "LANAYRUROAD-EASTGATE" },
+		{ "Lanayru Road - West Gate", "LANAYRUROAD-WESTGATE" },
+		{ "Lanayru Tower", "LANAYRUTOWER" },
+		{ "Lanno Kooh Shrine", "LANNOKOOHSHRINE" },
+		{ "Library", "LIBRARY" },
+		{ "Little Twin Bridge", "LITTLETWINBRIDGE" },
+		{ "Lockup", "LOCKUP" },
+		{ "Lomei Labyrinth Island", "LOMEILABYRINTHISLAND" },
+		{ "Lost Woods", "LOSTWOODS" },
+		{ "Lurelin Village", "LURELINVILLAGE" },
+		{ "Luto's Crossing", "LUTOSCROSSING" },
+		{ "Maag Halan Shrine", "MAAGHALANSHRINE" },
+		{ "Maag No'rah Shrine", "MAAGNORAHSHRINE" },
+		{ "Mabe Village Ruins", "MABEVILLAGERUINS" },
+		{ "Mah Eliya Shrine", "MAHELIYASHRINE" },
+		{ "Maka Rah Shrine", "MAKARAHSHRINE" },
+		{ "Malanya Spring", "MALANYASPRING" },
+		{ "Manhala Bridge", "MANHALABRIDGE" },
+		{ "Maritta Exchange Ruins", "MARITTAEXCHANGERUINS" },
+		{ "Maw of Death Mountain", "MAWOFDEATHMOUNTAIN" },
+		{ "Mezza Lo Shrine", "MEZZALOSHRINE" },
+		{ "Mijah Rokee Shrine", "MIJAHROKEESHRINE" },
+		{ "Military Training Camp", "MILITARYTRAININGCAMP" },
+		{ "Mirro Shaz Shrine", "MIRROSHAZSHRINE" },
+		{ "Misae Suma Shrine", "MISAESUMASHRINE" },
+		{ "Mo'a Keet Shrine", "MOAKEETSHRINE" },
+		{ "Moat Bridge", "MOATBRIDGE" },
+		{ "Mogg Latan Shrine", "MOGGLATANSHRINE" },
+		{ "Monya Toma Shrine", "MONYATOMASHRINE" },
+		{ "Moor Garrison Ruins", "MOORGARRISONRUINS" },
+		{ "Mounted Archery Camp", "MOUNTEDARCHERYCAMP" },
+		{ "Mozo Shenno Shrine", "MOZOSHENNOSHRINE" },
+		{ "Muwo Jeem Shrine", "MUWOJEEMSHRINE" },
+		{ "Myahm Agana Shrine", "MYAHMAGANASHRINE" },
+		{ "Namika Ozz Shrine", "NAMIKAOZZSHRINE" },
+		{ "Ne'ez Yohma Shrine", "NEEZYOHMASHRINE" },
+		{ "Noe Rajee Shrine", "NOERAJEESHRINE" },
+		{ "North Lomei Labyrinth", "NORTHLOMEILABYRINTH" },
+		{ "Northern Icehouse", "NORTHERNICEHOUSE" },
+		{ "Noya Neha Shrine", "NOYANEHASHRINE" },
+		{ "Observation Room", "OBSERVATIONROOM" },
+		{ "Oman Au Shrine", "OMANAUSHRINE" },
+		{ "Oren Bridge", "ORENBRIDGE" },
+		{ "Orsedd Bridge", "ORSEDDBRIDGE" },
+		{ "Outpost Ruins", "OUTPOSTRUINS" },
+		{ "Outskirt Stable", "OUTSKIRTSTABLE" },
+		{ "Owa Daim Shrine", "OWADAIMSHRINE" },
+		{ "Owlan Bridge", "OWLANBRIDGE" },
+		{ "Palmorae Ruins", "PALMORAERUINS" },
+		{ "Pondo's Lodge", "PONDOSLODGE" },
+		{ "Princess Zelda's Room", "PRINCESSZELDASROOM" },
+		{ "Princess Zelda's Study", "PRINCESSZELDASSTUDY" },
+		{ "Proxim Bridge", "PROXIMBRIDGE" },
+		{ "Pumaag Nitae Shrine", "PUMAAGNITAESHRINE" },
+		{ "Qaza Tokki Shrine", "QAZATOKKISHRINE" },
+		{ "Qua Raym Shrine", "QUARAYMSHRINE" },
+		{ "Qukah Nata Shrine", "QUKAHNATASHRINE" },
+		{ "Raqa Zunzo Shrine", "RAQAZUNZOSHRINE" },
+		{ "Rauru Settlement Ruins", "RAURUSETTLEMENTRUINS" },
+		{ "Rebonae Bridge", "REBONAEBRIDGE" },
+		{ "Ree Dahee Shrine", "REEDAHEESHRINE" },
+		{ "Ridgeland Tower", "RIDGELANDTOWER" },
+		{ "Rin Oyaa Shrine", "RINOYAASHRINE" },
+		{ "Rinu Honika Shrine", "RINUHONIKASHRINE" },
+		{ "Ritaag Zumo Shrine", "RITAAGZUMOSHRINE" },
+		{ "Rito Stable", "RITOSTABLE" },
+		{ "Rito Village", "RITOVILLAGE" },
+		{ "Riverside Stable", "RIVERSIDESTABLE" },
+		{ "Rohta Chigah Shrine", "ROHTACHIGAHSHRINE" },
+		{ "Rok Uwog Shrine", "ROKUWOGSHRINE" },
+		{ "Rona Kachta Shrine", "RONAKACHTASHRINE" },
+		{ "Rota Ooh Shrine", "ROTAOOHSHRINE" },
+		{ "Royal Ancient Lab Ruins", "ROYALANCIENTLABRUINS" },
+		{ "Rucco Maag Shrine", "RUCCOMAAGSHRINE" },
+		{ "Ruvo Korbah Shrine", "RUVOKORBAHSHRINE" },
+		{ "Saas Ko'sah Shrine", "SAASKOSAHSHRINE" },
+		{ "Sacred Ground Ruins", "SACREDGROUNDRUINS" },
+		{ "Sage Temple Ruins", "SAGETEMPLERUINS" },
+		{ "Sah Dahaj Shrine", "SAHDAHAJSHRINE" },
+		{ "Sanctum", "SANCTUM" },
+		{ "Sand-Seal Rally", "SAND-SEALRALLY" },
+		{ "Sanidin Park Ruins", "SANIDINPARKRUINS" },
+		{ "Sarjon Bridge", "SARJONBRIDGE" },
+		{ "Sasa Kai Shrine", "SASAKAISHRINE" },
+		{ "Sato Koda Shrine", "SATOKODASHRINE" },
+		{ "Second Gatehouse", "SECONDGATEHOUSE" },
+		{ "Selmie's Spot", "SELMIESSPOT" },
+		{ "Serenne Stable", "SERENNESTABLE" },
+		{ "Sha Gehma Shrine", "SHAGEHMASHRINE" },
+		{ "Sha Warvo Shrine", "SHAWARVOSHRINE" },
+		{ "Shada Naw Shrine", "SHADANAWSHRINE" },
+		{ "Shadow Hamlet Ruins", "SHADOWHAMLETRUINS" },
+		{ "Shae Katha Shrine", "SHAEKATHASHRINE" },
+		{ "Shae Loya Shrine", "SHAELOYASHRINE" },
+		{ "Shae Mo'sah Shrine", "SHAEMOSAHSHRINE" },
+		{ "Shai Utoh Shrine", "SHAIUTOHSHRINE" },
+		{ "Shai Yota Shrine", "SHAIYOTASHRINE" },
+		{ "Sharo Lun Shrine", "SHAROLUNSHRINE" },
+		{ "Shee Vaneer Shrine", "SHEEVANEERSHRINE" },
+		{ "Shee Venath Shrine", "SHEEVENATHSHRINE" },
+		{ "Sheem Dagoze Shrine", "SHEEMDAGOZESHRINE" },
+		{ "Sheh Rata Shrine", "SHEHRATASHRINE" },
+		{ "Sherfin's Secret Hot Spring", "SHERFINSSECRETHOTSPRING" },
+		{ "Shira Gomar Shrine", "SHIRAGOMARSHRINE" },
+		{ "Sho Dantu Shrine", "SHODANTUSHRINE" },
+		{ "Shoda Sah Shrine", "SHODASAHSHRINE" },
+		{ "Shoqa Tatone Shrine", "SHOQATATONESHRINE" },
+		{ "Shora Hah Shrine", "SHORAHAHSHRINE" },
+		{ "Shrine of Resurrection", "SHRINEOFRESURRECTION" },
+		{ "Snowfield Stable", "SNOWFIELDSTABLE" },
+		{ "Soh Kofi Shrine", "SOHKOFISHRINE" },
+		{ "Sokkala Bridge", "SOKKALABRIDGE" },
+		{ "South Akkala Stable", "SOUTHAKKALASTABLE" },
+		{ "South Lomei Labyrinth", "SOUTHLOMEILABYRINTH" },
+		{ "Southern Mine", "SOUTHERNMINE" },
+		{ "Spring of Courage", "SPRINGOFCOURAGE" },
+		{ "Spring of Power", "SPRINGOFPOWER" },
+		{ "Spring of Wisdom", "SPRINGOFWISDOM" },
+		{ "Statue of the Eighth Heroine", "STATUEOFTHEEIGHTHHEROINE" },
+		{ "Stolock Bridge", "STOLOCKBRIDGE" },
+		{ "Sturnida Secret Hot Spring", "STURNIDASECRETHOTSPRING" },
+		{ "Suma Sahma Shrine", "SUMASAHMASHRINE" },
+		{ "Tabantha Bridge Stable", "TABANTHABRIDGESTABLE" },
+		{ "Tabantha Great Bridge", "TABANTHAGREATBRIDGE" },
+		{ "Tabantha Tower", "TABANTHATOWER" },
+		{ "Tabantha Village Ruins", "TABANTHAVILLAGERUINS" },
+		{ "Tah Muhl Shrine", "TAHMUHLSHRINE" },
+		{ "Tahno O'ah Shrine", "TAHNOOAHSHRINE" },
+		{ "Takama Shiri Shrine", "TAKAMASHIRISHRINE" },
+		{ "Ta'loh Naeg Shrine", "TALOHNAEGSHRINE" },
+		{ "Tanagar Canyon Course", "TANAGARCANYONCOURSE" },
+		{ "Tarrey Town", "TARREYTOWN" },
+		{ "Tawa Jinn Shrine", "TAWAJINNSHRINE" },
+		{ "Temple of Time", "TEMPLEOFTIME" },
+		{ "Tena Ko'sah Shrine", "TENAKOSAHSHRINE" },
+		{ "Thims Bridge", "THIMSBRIDGE" },
+		{ "Tho Kayu Shrine", "THOKAYUSHRINE" },
+		{ "Thundra Plateau", "THUNDRAPLATEAU" },
+		{ "To Quomo Shrine", "TOQUOMOSHRINE" },
+		{ "Toh Yahsa Shrine", "TOHYAHSASHRINE" },
+		{ "Toto Sah Shrine", "TOTOSAHSHRINE" },
+		{ "Tu Ka'loh Shrine", "TUKALOHSHRINE" },
+		{ "Tutsuwa Nima Shrine", "TUTSUWANIMASHRINE" },
+		{ "Voo Lota Shrine", "VOOLOTASHRINE" },
+		{ "Wahgo Katta Shrine", "WAHGOKATTASHRINE" },
+		{ "Warbler's Nest", "WARBLERSNEST" },
+		{ "Wasteland Tower", "WASTELANDTOWER" },
+		{ "Water Reservoir", "WATERRESERVOIR" },
+		{ "West Passage", "WESTPASSAGE" },
+		{ "West Sokkala Bridge", "WESTSOKKALABRIDGE" },
+		{ "Wetland Stable", "WETLANDSTABLE" },
+		{ "Woodland Stable", "WOODLANDSTABLE" },
+		{ "Woodland Tower", "WOODLANDTOWER" },
+		{ "Ya Naga Shrine", "YANAGASHRINE" },
+		{ "Yah Rin Shrine", "YAHRINSHRINE" },
+		{ "Yiga Clan Hideout", "YIGACLANHIDEOUT" },
+		{ "Yowaka Ita Shrine", "YOWAKAITASHRINE" },
+		{ "Zalta Wa Shrine", "ZALTAWASHRINE" },
+		{ "Ze Kasho Shrine", "ZEKASHOSHRINE" },
+		{ "Zonai Ruins", "ZONAIRUINS" },
+		{ "Zora's Domain", "ZORASDOMAIN" },
+		{ "Zuna Kai Shrine", "ZUNAKAISHRINE" },
+	};
+	constexpr size_t num_entries = sizeof(entries) / sizeof(entries[0]);
+
+	constexpr uint32_t num_buckets = 128;
+	constexpr uint32_t num_slots = 512;
+
+	// hash seed of each bucket
+	constexpr uint16_t seeds[num_buckets] = {
+		0, 3, 4, 1, 1, 2, 4, 1, 1, 5, 2, 2, 1, 1, 1, 1,
+		3, 3, 2, 2, 7, 3, 2, 1, 1, 2, 2, 1, 3, 1, 6, 1,
+		1, 0, 5, 0, 2, 1, 1, 8, 1, 2, 1, 2, 1, 1, 1, 6,
+		1, 1, 5, 3, 6, 5, 2, 4, 3, 4, 0, 2, 1, 1, 2, 1,
+		2, 1, 12, 4, 6, 1, 4, 1, 0, 8, 6, 1, 1, 4, 2, 3,
+		1, 2, 1, 3, 1, 1, 1, 1, 3, 2, 2, 4, 0, 2, 2, 2,
+		2, 0, 0, 4, 3, 3, 3, 0, 1, 0, 4, 2, 3, 1, 4, 1,
+		5, 1, 14, 1, 2, 8, 1, 2, 2, 1, 8, 2, 1, 1, 3, 9,
+	};
+
+	// index into entries, -1 for empty slots
+	constexpr int16_t slots[num_slots] = {
+		-1, 101, 38, 31, 12, 270, 106, 43, 130, 220, 194, 275, -1, 238, 109, 239,
+		84, -1, 304, 104, 76, 82, 307, 279, 240, 137, -1, -1, -1, 258, 241, 14,
+		159, -1, 96, -1, 67, -1, 305, -1, -1, -1, -1, 250, 48, -1, -1, 204,
+		74, -1, 41, -1, -1, -1, 274, -1, 8, 163, -1, 189, 55, -1, -1, -1,
+		-1, -1, -1, 176, -1, 157, 36, 310, 172, 294, 224, 288, 312, -1, 267, -1,
+		-1, 234, 134, 3, -1, 147, 207, -1, 78, 215, -1, 148, -1, 115, 169, 278,
+		139, -1, -1, -1, 29, -1, 81, -1, 62, 33, 216, 313, 271, 73, -1, -1,
+		117, -1, -1, 309, -1, 168, -1, -1, -1, 193, -1, 170, 202, -1, -1, 133,
+		-1, -1, -1, -1, 209, 297, -1, 174, 233, -1, -1, -1, 87, 164, 114, 121,
+		301, -1, 281, 153, 24, 146, 97, 272, 59, 120, 244, -1, -1, 214, 185, -1,
+		-1, 208, 264, 129, 225, 141, 98, 45, 126, 91, 262, 280, -1, 236, 230, 175,
+		-1, -1, 165, 138, 155, 61, 123, 151, 54, 93, 213, -1, 56, -1, -1, -1,
+		291, 132, 79, -1, -1, -1, -1, 143, 9, -1, 154, -1, 71, -1, 18, 42,
+		-1, 292, 302, 300, -1, -1, -1, 46, -1, 111, -1, -1, 86, -1, -1, 65,
+		182, -1, -1, 127, -1, -1, 246, -1, -1, 2, 17, -1, 268, 11, -1, 177,
+		180, -1, 50, -1, 92, 173, 52, 70, 248, -1, 53, -1, -1, -1, 107, 21,
+		-1, 23, -1, 34, -1, -1, -1, 10, 6, -1, -1, 188, -1, -1, 122, -1,
+		251, -1, -1, 205, 255, 142, -1, 311, 257, 256, 200, -1, 150, 260, -1, -1,
+		269, 192, 296, -1, 183, 161, 178, -1, 0, 83, -1, -1, -1, 135, 245, -1,
+		-1, -1, 227, 285, 118, 166, 116, 195, -1, -1, 212, -1, 160, -1, -1, -1,
+		-1, 277, 289, -1, 51, 37, -1, 44, -1, 179, 40, -1, -1, -1, 75, 197,
+		80, -1, 181, 125, 22, -1, 206, -1, 68, -1, 306, 89, 28, -1, -1, 119,
+		-1, -1, -1, 1, 60, 235, -1, 57, 237, -1, 113, -1, 265, 211, 243, -1,
+		252, -1, -1, -1, -1, 231, -1, 85, -1, -1, 253, 226, 39, 156, 136, -1,
+		-1, 64, -1, -1, 282, 15, -1, 13, 263, -1, 88, -1, 16, 187, 20, -1,
+		-1, 201, 171, 203, 259, -1, -1, 314, 303, -1, 27, 32, -1, 242, 66, -1,
+		152, 218, 276, 25, 149, 254, 35, -1, 299, 140, 110, 19, -1, 261, 284, 158,
+		112, 190, 228, 283, 210, 30, -1, -1, -1, 273, 295, 128, 94, 184, -1, 286,
+		49, 199, -1, 144, -1, -1, 58, 72, -1, 131, -1, 196, -1, 69, 298, 223,
+		186, 219, 47, 293, 217, 90, 124, 4, 145, 95, 247, -1, 198, 100, 232, 290,
+		105, 103, 5, 63, 222, 308, 229, 108, 287, 77, -1, -1, 167, -1, 266, 102,
+		-1, -1, -1, 7, 221, 191, 162, -1, -1, -1, 26, -1, -1, -1, 99, 249,
+	};
+
+	constexpr uint32_t Hash(std::string_view key, uint32_t seed)
+	{
+		// FNV-1a with a final mix, so that the low bits depend on all characters
+		uint32_t h = 2166136261u ^ seed;
+		for (char c : key)
+			h = (h ^ uint8_t(c)) * 16777619u;
+		h ^= h >> 15;
+		h *= 0x2C1B3C6Du;
+		h ^= h >> 12;
+		return h;
+	}
+
+	// index of the entry with exactly this preprocessed name, -1 if there is none
+	constexpr int Find(std::string_view preprocessed_name)
+	{
+		int index = slots[Hash(preprocessed_name, seeds[Hash(preprocessed_name, 0) % num_buckets]) % num_slots];
+		return index >= 0 && entries[index].preprocessed_name == preprocessed_name ? index : -1;
+	}
+
+	// a spot check that Hash() is still the one the table was built with
+	static_assert(Find(entries[0].preprocessed_name) == 0 && Find(entries[num_entries - 1].preprocessed_name) == int(num_entries - 1),
+		"location_table.h is out of date, run gen_location_table.py again");
+}
@@ -0,0 +1,343 @@
+#include "logger.h"
+
+namespace
+{
+	// how often the progress line is refreshed, and how long the writer sleeps when there is nothing to write
+	constexpr std::chrono::milliseconds progress_interval(100);
+	constexpr std::chrono::milliseconds writer_idle_sleep(10);
+
+	void CopyTruncated(char* dest, size_t dest_size, std::string_view src)
+	{
+		size_t length = std::min(src.size(), dest_size - 1);
+		memcpy(dest, src.data(), length);
+		dest[length] = '\0';
+	}
+
+	void PadTo(std::string& str, size_t width)
+	{
+		if (str.size() < width)
+			str.append(width - str.size(), ' ');
+	}
+}
+
+Logger::~Logger()
+{
+	Stop();
+}
+
+void Logger::Start(const Config& config)
+{
+	if (_running)
+		return;
+
+	_config = config;
+	_json = false;
+	if (_config.output_file.size())
+	{
+		std::string_view extension(".jsonl");
+		_json = _config.output_file.size() >= extension.size() && std::string_view(_config.output_file).substr(_config.output_file.size() - extension.size()) == extension;
+		_ofs.open(_config.output_file);
+		if (!_ofs.is_open())
+			std::cout << "Cannot open output file " << _config.output_file << ". Result will not be output to file" << std::endl;
+	}
+
+	_cells = std::make_unique<Cell[]>(queue_size);
+	for (size_t i = 0; i < queue_size; i++)
+		_cells[i].sequence.store(i, std::memory_order_relaxed);
+	_enqueue_pos = 0;
+	_dequeue_pos = 0;
+	_num_dropped = 0;
+	_overflow = std::make_unique<Record[]>(overflow_size);
+	_overflow_batch = std::make_unique<Record[]>(overflow_size);
+	_num_overflow = 0;
+	_overflowing = false;
+	_num_dropped_results = 0;
+
+	_progress = std::make_unique<ProgressSlot[]>(std::max(_config.num_streams, 1));
+	_last_progress_stream = 0;
+
+	_system_base = std::chrono::system_clock::now();
+	_steady_base = std::chrono::steady_clock::now();
+
+	_running = true;
+	_writer_thread = std::thread([this]() { WriterThread(); });
+}
+
+void Logger::Stop()
+{
+	if (!_running)
+		return;
+
+	_running = false;
+	_writer_thread.join();
+	_ofs.close();
+
+	if (_num_dropped > 0)
+		std::cout << _num_dropped << " console messages were dropped because the log queue was full" << std::endl;
+	if (_num_dropped_results > 0)
+		std::cout << _num_dropped_results << " locations and events were dropped because the log queue and its overflow buffer were full" << std::endl;
+}
+
+void Logger::Push(RecordType type, int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, int64_t elapsed_us, std::string_view region, std::string_view text)
+{
+	if (!_running)
+		return;
+
+	// locations and events keep going to the overflow buffer until the writer has emptied it
+	bool result = type != RecordType::Message;
+	if (result && _overflowing.load(std::memory_order_acquire))
+	{
+		if (!PushOverflow(type, stream, frame_number, frame_time, elapsed_us, region, text))
+			_num_dropped_results++;
+		return;
+	}
+
+	// claim a cell. If the writer is too far behind, console messages are dropped and locations and events overflow
+	size_t pos = _enqueue_pos.load(std::memory_order_relaxed);
+	Cell* cell;
+	while (1)
+	{
+		cell = &_cells[pos & (queue_size - 1)];
+		size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		intptr_t diff = intptr_t(sequence) - intptr_t(pos);
+		if (diff == 0)
+		{
+			if (_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (diff < 0)
+		{
+			if (!result)
+				_num_dropped++;
+			else if (!PushOverflow(type, stream, frame_number, frame_time, elapsed_us, region, text))
+				_num_dropped_results++;
+			return;
+		}
+		else
+			pos = _enqueue_pos.load(std::memory_order_relaxed);
+	}
+
+	FillRecord(cell->record, type, stream, frame_number, frame_time, elapsed_us, region, text);
+	cell->sequence.store(pos + 1, std::memory_order_release);
+}
+
+void Logger::FillRecord(Record& record, RecordType type, int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, int64_t elapsed_us, std::string_view region, std::string_view text)
+{
+	record.type = type;
+	record.stream = stream;
+	record.frame_number = frame_number;
+	record.frame_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(frame_time.time_since_epoch()).count();
+	record.elapsed_us = elapsed_us;
+	CopyTruncated(record.region, sizeof(record.region), region);
+	CopyTruncated(record.text, sizeof(record.text), text);
+}
+
+bool Logger::PushOverflow(RecordType type, int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, int64_t elapsed_us, std::string_view region, std::string_view text)
+{
+	std::lock_guard<std::mutex> lg(_overflow_mutex);
+	if (_num_overflow >= overflow_size)
+		return false;
+	FillRecord(_overflow[_num_overflow++], type, stream, frame_number, frame_time, elapsed_us, region, text);
+	_overflowing.store(true, std::memory_order_release);
+	return true;
+}
+
+bool Logger::WriteOverflow()
+{
+	// the records are copied out under the mutex and written without it, so that the callers never wait for the output
+	size_t num_records;
+	{
+		std::lock_guard<std::mutex> lg(_overflow_mutex);
+		num_records = _num_overflow;
+		std::copy(_overflow.get(), _overflow.get() + num_records, _overflow_batch.get());
+		_num_overflow = 0;
+		_overflowing.store(false, std::memory_order_release);
+	}
+	for (size_t i = 0; i < num_records; i++)
+		Write(_overflow_batch[i]);
+	return num_records > 0;
+}
+
+bool Logger::Pop(Record& record)
+{
+	// only the writer thread takes records
+	size_t pos = _dequeue_pos.load(std::memory_order_relaxed);
+	Cell& cell = _cells[pos & (queue_size - 1)];
+	size_t sequence = cell.sequence.load(std::memory_order_acquire);
+	if (intptr_t(sequence) - intptr_t(pos + 1) < 0)
+		return false;
+
+	record = cell.record;
+	cell.sequence.store(pos + queue_size, std::memory_order_release);
+	_dequeue_pos.store(pos + 1, std::memory_order_relaxed);
+	return true;
+}
+
+void Logger::Location(int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, std::string_view location, int64_t elapsed_us)
+{
+	Push(RecordType::Location, stream, frame_number, frame_time, elapsed_us, "", location);
+}
+
+void Logger::Event(int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, std::string_view region, std::string_view text)
+{
+	Push(RecordType::Event, stream, frame_number, frame_time, -1, region, text);
+}
+
+void Logger::Message(int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, std::string_view text)
+{
+	Push(RecordType::Message, stream, frame_number, frame_time, -1, "", text);
+}
+
+void Logger::Progress(int stream, int frame_number, std::chrono::steady_clock::time_point frame_time)
+{
+	if (!_running || stream < 0 || stream >= _config.num_streams)
+		return;
+
+	ProgressSlot& slot = _progress[stream];
+	slot.frame_time_ns.store(std::chrono::duration_cast<std::chrono::nanoseconds>(frame_time.time_since_epoch()).count(), std::memory_order_relaxed);
+	slot.frame_number.store(frame_number, std::memory_order_release);
+	_last_progress_stream.store(stream, std::memory_order_relaxed);
+}
+
+void Logger::WriterThread()
+{
+	auto next_progress = std::chrono::steady_clock::now();
+	int shown_stream = -1, shown_frame = -1;
+	while (1)
+	{
+		// read the flag before draining, so that everything pushed before Stop() is written
+		bool running = _running;
+
+		// the queue has the records from before the overflow started, the overflow buffer the ones after
+		bool written = false;
+		Record record;
+		while (Pop(record))
+		{
+			Write(record);
+			written = true;
+		}
+		written = WriteOverflow() || written;
+		if (written && _ofs.is_open())
+			_ofs.flush();
+		if (!running)
+			break;
+
+		auto now = std::chrono::steady_clock::now();
+		if (now >= next_progress)
+		{
+			next_progress = now + progress_interval;
+			int stream = _last_progress_stream.load(std::memory_order_relaxed);
+			const ProgressSlot& slot = _progress[stream];
+			int frame_number = slot.frame_number.load(std::memory_order_acquire);
+			if (frame_number >= 0 && (frame_number != shown_frame || stream != shown_stream))
+			{
+				std::string line = FormatLabel(stream, frame_number, slot.frame_time_ns.load(std::memory_order_relaxed));
+				PadTo(line, 70);
+				std::cout << line << '\r' << std::flush;
+				shown_stream = stream;
+				shown_frame = frame_number;
+			}
+		}
+
+		if (!written)
+			std::this_thread::sleep_for(writer_idle_sleep);
+	}
+	std::cout << std::flush;
+}
+
+void Logger::Write(const Record& record)
+{
+	std::string label = FormatLabel(record.stream, record.frame_number, record.frame_time_ns);
+	char console_end = _config.status_line ? '\r' : '\n';
+
+	switch (record.type)
+	{
+	case RecordType::Location:
+	{
+		std::string line = label + ": " + record.text;
+		if (record.elapsed_us >= 0)
+		{
+			PadTo(line, 60);
+			line += std::to_string(record.elapsed_us / 1000) + "ms";
+		}
+		std::string console_line = line;
+		PadTo(console_line, 70);
+		std::cout << console_line << console_end;
+		if (_ofs.is_open() && !_json)
+			_ofs << line << '\n';
+		break;
+	}
+	case RecordType::Event:
+	{
+		std::string line = label + ": [" + record.region + "] " + record.text;
+		PadTo(line, 70);
+		std::cout << line << console_end;
+		break;
+	}
+	case RecordType::Message:
+	{
+		std::string line = label + ": " + record.text;
+		PadTo(line, 70);
+		std::cout << line << '\n';
+		return;
+	}
+	}
+
+	if (_ofs.is_open() && _json)
+	{
+		_ofs << "{";
+		if (_config.num_streams > 1)
+			_ofs << "\"stream\":" << record.stream << ",";
+		_ofs << "\"frame\":" << record.frame_number << ",\"time\":";
+		util::WriteJsonString(_ofs, FormatTime(record.frame_number, record.frame_time_ns));
+		if (record.type == RecordType::Location)
+		{
+			_ofs << ",\"location\":";
+			util::WriteJsonString(_ofs, record.text);
+			if (record.elapsed_us >= 0)
+				_ofs << ",\"ms\":" << record.elapsed_us / 1000.0;
+		}
+		else
+		{
+			_ofs << ",\"region\":";
+			util::WriteJsonString(_ofs, record.region);
+			_ofs << ",\"text\":";
+			util::WriteJsonString(_ofs, record.text);
+		}
+		_ofs << "}\n";
+	}
+}
+
+std::string Logger::FormatLabel(int stream, int frame_number, int64_t frame_time_ns) const
+{
+	char buf[80];
+	if (_config.num_streams > 1)
+		snprintf(buf, sizeof(buf), "#%d [%6d] %s", stream, frame_number, FormatTime(frame_number, frame_time_ns).c_str());
+	else
+		snprintf(buf, sizeof(buf), "[%6d] %s", frame_number, FormatTime(frame_number, frame_time_ns).c_str());
+	return buf;
+}
+
+std::string Logger::FormatTime(int frame_number, int64_t frame_time_ns) const
+{
+	char buf[40];
+	if (_config.video_fps > 0.0)
+	{
+		double sec_lf;
+		double frac = _config.video_time_us ? std::modf(_config.video_time_us(frame_number) / 1000000.0, &sec_lf) : std::modf(frame_number / _config.video_fps, &sec_lf);
+		int frame_in_sec = int(frac * _config.video_fps + 0.5);
+		int sec = int(sec_lf);
+		snprintf(buf, sizeof(buf), "%02d:%02d:%02d.%02d", sec / 3600, sec % 3600 / 60, sec % 60, frame_in_sec);
+		return buf;
+	}
+
+	std::chrono::steady_clock::time_point frame_time{ std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::nanoseconds(frame_time_ns)) };
+	auto time = std::chrono::time_point_cast<std::chrono::milliseconds>(_system_base + std::chrono::duration_cast<std::chrono::system_clock::duration>(frame_time - _steady_base));
+	std::time_t time_t = std::chrono::system_clock::to_time_t(time);
+	int ms = int(time.time_since_epoch().count() % 1000);
+	std::tm tm;
+	localtime_s(&tm, &time_t);
+	size_t length = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+	snprintf(buf + length, sizeof(buf) - length, ".%03d", ms);
+	return buf;
+}
@@ -0,0 +1,128 @@
+#pragma once
+#include "common.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <mutex>
+
+
+// Console and output file logging of the analysis loops, done on a background thread.
+// The detection threads only copy a fixed-size record into a lock-free queue, the frame labels and timestamps are formatted by the writer.
+// The caller never waits for the writer's console or file output. When the queue is full, console messages are dropped. Locations and
+// events go to a bounded overflow buffer instead, which only takes a mutex for the copy of one record, and are dropped and counted
+// only when that is full too.
+// The progress line on the console is refreshed at a fixed rate instead of on every frame.
+class Logger
+{
+public:
+	struct Config
+	{
+		std::string output_file;		// detected locations are written here, one JSON object per line if the name ends with ".jsonl"
+		double video_fps = 0.0;			// frames are labelled with the video time if > 0, otherwise with the time they were captured
+		std::function<int64_t(int)> video_time_us;		// exact video time of a frame in microseconds, instead of the frame number divided by video_fps
+		int num_streams = 1;			// the stream index is shown if there are several
+		bool status_line = true;		// locations and events overwrite each other on one console line, instead of each getting a line
+	};
+
+private:
+	enum class RecordType : uint8_t
+	{
+		Location,
+		Event,
+		Message,
+	};
+
+	struct Record
+	{
+		RecordType type;
+		int stream;
+		int frame_number;
+		int64_t frame_time_ns;			// steady clock
+		int64_t elapsed_us;				// for locations, time from capture (live) or from the start of the frame (video) to the result
+		char region[24];
+		char text[104];
+	};
+
+	// bounded multi-producer queue with a sequence number in each cell, after Dmitry Vyukov's MPMC queue
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		Record record;
+	};
+	static constexpr size_t queue_size = 1024;		// power of 2
+	static constexpr size_t overflow_size = 4096;	// locations and events that didn't fit into the queue
+
+	struct ProgressSlot
+	{
+		std::atomic<int> frame_number = -1;
+		std::atomic<int64_t> frame_time_ns = 0;
+	};
+
+	Config _config;
+	bool _json = false;
+	std::ofstream _ofs;
+
+	std::unique_ptr<Cell[]> _cells;
+	alignas(64) std::atomic<size_t> _enqueue_pos = 0;
+	alignas(64) std::atomic<size_t> _dequeue_pos = 0;
+	std::atomic<uint64_t> _num_dropped = 0;
+
+	// While the overflow buffer has records, locations and events go there as well, so that they are written in order.
+	// The writer moves them into _overflow_batch under the mutex and writes them after the queue
+	std::mutex _overflow_mutex;
+	std::unique_ptr<Record[]> _overflow;
+	size_t _num_overflow = 0;
+	std::atomic<bool> _overflowing = false;
+	std::atomic<uint64_t> _num_dropped_results = 0;
+	std::unique_ptr<Record[]> _overflow_batch;		// only used by the writer
+
+	std::unique_ptr<ProgressSlot[]> _progress;
+	std::atomic<int> _last_progress_stream = 0;
+
+	std::atomic<bool> _running = false;
+	std::thread _writer_thread;
+
+	// the steady clock of the records is turned into wall-clock time with this offset
+	std::chrono::system_clock::time_point _system_base;
+	std::chrono::steady_clock::time_point _steady_base;
+
+private:
+	void Push(RecordType type, int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, int64_t elapsed_us, std::string_view region, std::string_view text);
+	bool Pop(Record& record);
+	void FillRecord(Record& record, RecordType type, int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, int64_t elapsed_us, std::string_view region, std::string_view text);
+	// returns false if the overflow buffer is full
+	bool PushOverflow(RecordType type, int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, int64_t elapsed_us, std::string_view region, std::string_view text);
+	// write what's in the overflow buffer, returns false if it was empty
+	bool WriteOverflow();
+
+	void WriterThread();
+	void Write(const Record& record);
+
+	// "[frame] hh:mm:ss.ff" of a video frame, or "[frame] date time.ms" of a captured frame, prefixed with the stream index if there are several
+	std::string FormatLabel(int stream, int frame_number, int64_t frame_time_ns) const;
+	std::string FormatTime(int frame_number, int64_t frame_time_ns) const;
+
+public:
+	Logger() = default;
+	Logger(const Logger&) = delete;
+	Logger& operator=(const Logger&) = delete;
+	~Logger();
+
+	// a missing output file is reported, the console output works regardless
+	void Start(const Config& config);
+
+	// writes everything that is still queued
+	void Stop();
+
+	void Location(int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, std::string_view location, int64_t elapsed_us);
+	void Event(int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, std::string_view region, std::string_view text);
+	// a line that stays on the console, e.g. that the game area was found
+	void Message(int stream, int frame_number, std::chrono::steady_clock::time_point frame_time, std::string_view text);
+
+	// the frame a stream is at, only the newest is shown when the progress line is refreshed
+	void Progress(int stream, int frame_number, std::chrono::steady_clock::time_point frame_time);
+
+	// console messages lost because the queue was full, and locations and events lost because the overflow buffer was full as well
+	uint64_t NumDropped() const { return _num_dropped; }
+	uint64_t NumDroppedResults() const { return _num_dropped_results; }
+};
@@ -1,180 +1,999 @@
 #include "common.h"
 #include "location_detector.h"
+#include "hud_engine.h"
+#include "hud_regions.h"
+#include "game_area_detector.h"
+#include "detector_pool.h"
+#include "analysis_cache.h"
+#include "roi_ring.h"
+#include "logger.h"
 #include "ffmpeg_wrap.h"
 #include "server.h"
+#include "tracer.h"
+#include "parameter_sweep.h"
+#include "video_index.h"
+#include "frame_sampler.h"
 
 //cv::Rect gameRect(412, 114, 1920 - 412, 962 - 114);
 
 Server g_server;
 
-void AnalyseVideo(const std::string &video_file, cv::Rect game_rect, int frame_start, int frame_length, const std::string &output_file, int brightness_threshold, int bright_pixel_ratio_low, int bright_pixel_ratio_high)
+// counts the allocations of the thread that set util::g_count_allocations, for -selftest
+void* operator new(size_t size)
 {
-	std::string lang = "eng";
+	if (util::g_count_allocations)
+		util::g_num_allocations++;
+	if (void* ptr = malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
 
-	LocationDetector location_detector;
-	if (!location_detector.Init(lang.c_str(), brightness_threshold, bright_pixel_ratio_low, bright_pixel_ratio_high))
-		return;
+void operator delete(void* ptr) noexcept
+{
+	free(ptr);
+}
 
-	std::ofstream ofs;
-	if (output_file.size())
+// returns the detected location in the events, and logs the other new events
+std::string_view ProcessHudEvents(const std::vector<HudEvent>& hud_events, Logger& logger, int stream, int frame_number, std::chrono::steady_clock::time_point frame_time)
+{
+	std::string_view location;
+	for (const HudEvent& event : hud_events)
 	{
-		ofs.open(output_file);
-		if (!ofs.is_open())
-			std::cout << "Cannot open output file " << output_file << ". Result will not be output to file" << std::endl;
+		if (std::string_view(event.source->Name()) == LocationDetector::region_name)
+			location = event.text;
+		else if (event.is_new)
+			logger.Event(stream, frame_number, frame_time, event.source->Name(), event.text);
 	}
+	return location;
+}
 
-	cv::VideoCapture cap(video_file);
-	if (cap.isOpened())
+// With a sweep_file, the configurations in it are compared instead of detecting with detector_config, see ParameterSweep
+void AnalyseVideo(const std::string &video_file, cv::Rect game_rect, int frame_start, int frame_length, const std::string &output_file, const std::string &cache_file, const LocationDetector::Config &detector_config, const std::string &sweep_file)
+{
+	HudEngine hud_engine;
+	ParameterSweep sweep;
+	LocationDetector* location_detector = nullptr;
+	if (sweep_file.size())
+	{
+		if (!sweep.Init(sweep_file, detector_config))
+			return;
+	}
+	else
+	{
+		location_detector = InitHudEngine(hud_engine, detector_config);
+		if (!location_detector)
+			return;
+	}
+	std::vector<HudEvent> hud_events;
+
+	// the seek index gives the exact frame count and time of every frame, and a seek straight to the keyframe before frame_start
+	VideoReader reader;
+	if (reader.Open(video_file))
 	{
-		double width = cap.get(cv::CAP_PROP_FRAME_WIDTH);
-		double height = cap.get(cv::CAP_PROP_FRAME_HEIGHT);
+		const VideoIndex& index = reader.Index();
+		int width = reader.Width();
+		int height = reader.Height();
 		std::cout << "File: " << video_file << std::endl;
 		std::cout << "Frame size: " << width << "x" << height << std::endl;
-		double num_frames = cap.get(cv::CAP_PROP_FRAME_COUNT);
-		std::cout << "Number of frames: " << (int)num_frames << std::endl;
+		int num_frames = index.NumFrames();
+		std::cout << "Number of frames: " << num_frames << std::endl;
 
-		// Get the frame rate of the video
-		double fps = cap.get(cv::CAP_PROP_FPS);
+		// average frame rate, the labels take the seconds from the time stamp of each frame
+		double fps = index.GetAverageFps();
 		std::cout << "Frame rate: " << fps << std::endl;
-		double duration_sec = num_frames / fps;
+		double duration_sec = index.GetFrameTimeUs(num_frames - 1) / 1000000.0;
 		std::cout << "Duration: " << duration_sec << " seconds" << std::endl;
 
-		double format = cap.get(cv::CAP_PROP_FORMAT);
-		std::cout << "Format: " << format << std::endl;
-
 		if (frame_start < 0 || frame_start >= num_frames)
 			return;
 		if (frame_length < 0)
-			frame_length = (int)num_frames;
+			frame_length = num_frames;
 
-		if (frame_start > 0)
-			cap.set(cv::CAP_PROP_POS_FRAMES, frame_start - 1);			// VideoCapture.read() reads the next frame
+		// frames are numbered from 1 as before, frame_start 0 and 1 both start at the first frame
+		if (!reader.Seek(std::max(frame_start - 1, 0)))
+			return;
 
-		if (game_rect.width <= 0 || game_rect.height <= 0)
+		// detect the game area automatically if it's not specified
+		bool auto_game_rect = game_rect.width <= 0 || game_rect.height <= 0;
+		GameAreaDetector game_area_detector;
+		if (auto_game_rect)
 		{
 			game_rect.x = 0;
 			game_rect.y = 0;
-			game_rect.width = (int)width;
-			game_rect.height = (int)height;
+			game_rect.width = width;
+			game_rect.height = height;
+			std::cout << "Game area: auto-detect" << std::endl;
 		}
-
-		if (game_rect.x < 0 || game_rect.y < 0 || game_rect.x + game_rect.width >(int)width || game_rect.y + game_rect.height >(int)height)
+		else
 		{
-			std::cout << "Error: game image area outside video frame" << std::endl;
-			return;
+			if (game_rect.x < 0 || game_rect.y < 0 || game_rect.x + game_rect.width > width || game_rect.y + game_rect.height > height)
+			{
+				std::cout << "Error: game image area outside video frame" << std::endl;
+				return;
+			}
+			std::cout << "Game area: (" << game_rect.x << ", " << game_rect.y << ") + (" << game_rect.width << ", " << game_rect.height << ")" << std::endl;
 		}
-		std::cout << "Game area: (" << game_rect.x << ", " << game_rect.y << ") + (" << game_rect.width << ", " << game_rect.height << ")" << std::endl;
 
+		AnalysisCacheWriter cache_writer;
+		if (cache_file.size() && !cache_writer.Open(cache_file, fps, detector_config))
+			return;
+
+		Logger logger;
+		Logger::Config logger_config;
+		logger_config.output_file = output_file;
+		logger_config.video_fps = fps;
+		logger_config.video_time_us = [&index](int frame_number) { return index.GetLabelTimeUs(frame_number); };
+		logger.Start(logger_config);
+
+		if (location_detector)
+			g_server.SetStatsProvider([location_detector]() { return location_detector->GetCascadeReport(); });
 		for (int32_t frame_number = frame_start; frame_number < frame_start + frame_length; frame_number++)
 		{
-			DWORD tbegin = ::timeGetTime();
+			auto tbegin = std::chrono::steady_clock::now();
 			cv::Mat frame;
-			if (!cap.read(frame))
+			int frame_index;
+			if (!reader.Read(frame, frame_index))
 				break;
 
-			int cur_frame = int(cap.get(cv::CAP_PROP_POS_FRAMES));
-			char buf[30];
+			int cur_frame = frame_index + 1;
+			logger.Progress(0, cur_frame, tbegin);
+
+			if (auto_game_rect && game_area_detector.Update(frame))
 			{
-				double sec_lf;
-				int frame_in_sec = int(std::modf(cur_frame / fps, &sec_lf) * fps + 0.5);
-				int sec = int(sec_lf);
-				sprintf_s(buf, "[%6d] %02d:%02d:%02d.%02d", cur_frame, sec / 3600, sec % 3600 / 60, sec % 60 , frame_in_sec);
+				game_rect = game_area_detector.GetGameRect();
+				std::ostringstream os;
+				os << "Game area detected (" << game_rect.x << ", " << game_rect.y << ") + (" << game_rect.width << ", " << game_rect.height << ")";
+				logger.Message(0, cur_frame, tbegin, os.str());
 			}
 
 			g_server.SetLastImage(frame(game_rect));
-			std::string location = location_detector.GetLocation(frame(game_rect));
-			DWORD tend = ::timeGetTime();
+			if (cache_writer.IsOpen())
+				cache_writer.AddFrame(cur_frame, index.GetLabelTimeUs(cur_frame), frame(game_rect));
+			if (sweep_file.size())
+			{
+				sweep.AddFrame(frame(game_rect));
+				continue;
+			}
+			hud_engine.Analyse(frame(game_rect), hud_events);
+			std::string_view location = ProcessHudEvents(hud_events, logger, 0, cur_frame, tbegin);
 			if (location.size() > 0)
 			{
-				if (location[location.size() - 1] == '\n')
-					location = location.substr(0, location.size() - 1);
-				g_server.PushMessage(location);
-				std::ostringstream os;
-				os << buf << ": " << location;
+				g_server.PushMessage(std::string(location));
+				logger.Location(0, cur_frame, tbegin, location, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - tbegin).count());
+			}
+		}
+		g_server.SetStatsProvider(nullptr);
+		logger.Stop();
+		if (cache_writer.IsOpen() && !cache_writer.Close())
+			std::cout << std::endl << "Failed to write analysis cache " << cache_file << std::endl;
+
+		std::cout << std::endl << (location_detector ? location_detector->GetCascadeReport() : sweep.GetReport());
+	}
+	else
+	{
+		std::cout << "Cannot open video file " << video_file << std::endl;
+	}
+}
+
+// OCR false positives with and without the banner classifier, over the boxes that pass the bright pixel ratio test
+struct BannerClassifierEvaluation
+{
+	uint32_t num_boxes = 0;
+	uint32_t num_no_location = 0;			// OCR found nothing, i.e. false positives of the ratio test alone
+	uint32_t num_passed = 0;				// boxes the classifier let through to OCR
+	uint32_t num_passed_no_location = 0;	// false positives left with the classifier
+	uint32_t num_locations_rejected = 0;	// frames with a location the classifier rejected
+	double ocr_ms = 0.0, passed_ocr_ms = 0.0;
+
+	// Consecutive frames with the same location (less than a second apart) are one appearance of its banner.
+	// An appearance is only lost if the classifier rejected all of its frames
+	uint32_t num_appearances = 0, num_appearances_lost = 0;
+	std::string_view appearance_location;
+	int appearance_last_frame = -1;
+	bool appearance_passed = false;
+
+	void AddLocation(std::string_view location, int frame_number, bool passed, double fps)
+	{
+		if (location != appearance_location || frame_number - appearance_last_frame > fps)
+		{
+			EndAppearance();
+			appearance_location = location;
+			appearance_passed = false;
+		}
+		appearance_last_frame = frame_number;
+		appearance_passed |= passed;
+	}
+
+	void EndAppearance()
+	{
+		if (appearance_location.empty())
+			return;
+		num_appearances++;
+		if (!appearance_passed)
+			num_appearances_lost++;
+		appearance_location = {};
+	}
+
+	void Print() const
+	{
+		auto percent = [](uint32_t part, uint32_t total) { return total ? part * 100.0 / total : 0.0; };
+		std::cout << std::fixed << std::setprecision(1);
+		std::cout << "Without the banner classifier: " << num_boxes << " OCRs, " << num_no_location << " without a location ("
+			<< percent(num_no_location, num_boxes) << "% false positives), " << ocr_ms / 1000.0 << "s of OCR" << std::endl;
+		std::cout << "With the banner classifier:    " << num_passed << " OCRs, " << num_passed_no_location << " without a location ("
+			<< percent(num_passed_no_location, num_passed) << "% false positives), " << passed_ocr_ms / 1000.0 << "s of OCR" << std::endl;
+		std::cout << "The classifier rejected " << num_locations_rejected << " of " << num_boxes - num_no_location << " frames with a location, "
+			<< num_appearances_lost << " of " << num_appearances << " location banners were lost entirely" << std::endl;
+		std::cout << std::defaultfloat;
+	}
+};
+
+// banners have to be kept, each frame of one that is rejected has to be made up by the others of the same banner
+constexpr double banner_min_recall = 0.99;
+
+// Run the early-out and location OCR again on an analysis cache written by AnalyseVideo(), without the video.
+// With banner_train_file, the boxes that pass the early-out are labelled by OCR and a banner classifier is trained on them.
+// With a banner classifier in detector_config, it's evaluated against OCR of all boxes
+void ReanalyseCache(const std::string &cache_file, const std::string &output_file, const LocationDetector::Config &detector_config, const std::string &banner_train_file)
+{
+	AnalysisCacheReader cache;
+	if (!cache.Open(cache_file))
+		return;
+	const analysis_cache::Header& header = cache.GetHeader();
+	if (detector_config.brightness_threshold < analysis_cache::min_threshold || detector_config.brightness_threshold > 254)
+	{
+		std::cout << "Error: the analysis cache only has statistics for brightness thresholds in [" << analysis_cache::min_threshold << ", 254]" << std::endl;
+		return;
+	}
+
+	bool train = banner_train_file.size() > 0;
+	LocationDetector::Config config = detector_config;
+	if (train)
+		config.banner_model_file.clear();
+	LocationDetector location_detector;
+	if (!location_detector.Init("eng", config))
+		return;
+	bool evaluate = location_detector.HasBannerClassifier();
+
+	BannerClassifier banner_classifier;
+	banner_classifier.SetBrightnessThreshold(detector_config.brightness_threshold);
+	std::vector<BannerClassifier::Sample> samples;
+	BannerClassifierEvaluation evaluation;
+
+	std::cout << "Analysis cache: " << cache_file << std::endl;
+	if (cache.NumRecords() == 0)
+	{
+		std::cout << "The analysis cache has no frames" << std::endl;
+		return;
+	}
+	std::cout << "Frames: " << cache.GetRecord(0).frame_number << " - " << cache.GetRecord(cache.NumRecords() - 1).frame_number << std::endl;
+	std::cout << "Boxes stored with early out parameters " << header.brightness_threshold << " " << header.bright_pixel_ratio_low << " " << header.bright_pixel_ratio_high << std::endl;
+
+	Logger logger;
+	Logger::Config logger_config;
+	logger_config.output_file = output_file;
+	logger_config.video_fps = header.fps;
+	logger_config.video_time_us = [&cache](int frame_number) { return cache.GetFrameTimeUs(frame_number); };		// the same labels as -v
+	logger_config.status_line = false;
+	logger.Start(logger_config);
+
+	auto tbegin = std::chrono::steady_clock::now();
+	uint32_t num_candidates = 0, num_missing = 0, num_locations = 0;
+	cv::Mat location_gray;
+	for (uint32_t i = 0; i < cache.NumRecords(); i++)
+	{
+		const analysis_cache::FrameRecord& record = cache.GetRecord(i);
+		if (!location_detector.ScreenLocationBox(AnalysisCacheReader::GetBrightRatio(record, detector_config.brightness_threshold)))
+			continue;
+		num_candidates++;
 
-				if (os.str().length() < 60)
-					os << std::string(60 - os.str().length(), ' ');
-				os << tend - tbegin << "ms";
+		// the box was dropped when the cache was written because it was too far from the early-out parameters at the time
+		if (!cache.DecodeLocationBox(record, location_gray))
+		{
+			num_missing++;
+			continue;
+		}
+
+		// when evaluating, the boxes the classifier rejects get OCR as well, to see what was lost
+		bool passed = location_detector.PassesBannerClassifier(location_gray);
+		if (!passed && !evaluate)
+			continue;
+
+		int frame_number = record.frame_number;
+		auto tocr = std::chrono::steady_clock::now();
+		HudEvent event;
+		bool found = location_detector.DetectInLocationBox(location_gray, cv::Size(record.game_width, record.game_height), event);
+		double ocr_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tocr).count();
 
-				std::cout << os.str() << "  \r";
-				if (ofs.is_open())
-					ofs << os.str() << std::endl;
+		if (train)
+		{
+			BannerClassifier::Sample& sample = samples.emplace_back();
+			banner_classifier.ComputeFeatures(location_gray, sample.features);
+			sample.is_banner = found;
+		}
+		if (evaluate)
+		{
+			evaluation.num_boxes++;
+			evaluation.ocr_ms += ocr_ms;
+			evaluation.num_no_location += !found;
+			if (passed)
+			{
+				evaluation.num_passed++;
+				evaluation.passed_ocr_ms += ocr_ms;
+				evaluation.num_passed_no_location += !found;
 			}
 			else
+				evaluation.num_locations_rejected += found;
+			if (found)
+				evaluation.AddLocation(event.text, frame_number, passed, header.fps);
+		}
+
+		if (!found || !passed)
+			continue;
+		num_locations++;
+		logger.Location(0, frame_number, {}, event.text, -1);
+	}
+	logger.Stop();
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tbegin).count();
+
+	std::cout << num_candidates << " frames passed the early out, " << num_locations << " with a location, in " << seconds << " seconds" << std::endl;
+	if (num_missing > 0)
+		std::cout << "Warning: " << num_missing << " of them have no stored box, analyse the video again with parameters closer to these to include them" << std::endl;
+	std::cout << location_detector.GetCascadeReport();
+
+	if (evaluate)
+	{
+		evaluation.EndAppearance();
+		evaluation.Print();
+	}
+
+	if (train)
+	{
+		BannerClassifier::TrainingReport report = banner_classifier.Train(samples, banner_min_recall);
+		if (report.num_banners == 0 || report.num_others == 0)
+		{
+			std::cout << "Cannot train the banner classifier, the boxes need to include frames with and without a location" << std::endl;
+			return;
+		}
+		std::cout << "Banner classifier trained on " << report.num_banners << " boxes with a location and " << report.num_others << " without" << std::endl;
+		std::cout << "At threshold " << banner_classifier.Threshold() << " it rejects " << report.num_banners_rejected << " of the boxes with a location and "
+			<< report.num_others_rejected << " of the ones without" << std::endl;
+		if (banner_classifier.Save(banner_train_file))
+			std::cout << "Saved to " << banner_train_file << ", evaluate it on another analysis cache with -a cache_file -g " << banner_train_file << std::endl;
+	}
+}
+
+// Time the preprocessing of the location box on one game image: the separate cvtColor / resize / BrightTextToOcrInput() steps
+// against util::PreprocessBrightText(), and check that both give the same early-out count and OCR input
+void BenchmarkPreprocessing(const std::string& image_file, const cv::Rect& game_rect, const LocationDetector::Config& detector_config)
+{
+	cv::Mat img = cv::imread(image_file, cv::IMREAD_COLOR);
+	if (img.empty())
+	{
+		std::cout << "Cannot read image " << image_file << std::endl;
+		return;
+	}
+	cv::Mat game_img = game_rect.area() > 0 ? img(game_rect & cv::Rect(0, 0, img.cols, img.rows)) : img;
+	cv::Rect location_rect = HudFrame::ToPixels(LocationDetector::GetLocationRegion(), game_img.size());
+	cv::Rect early_out_rect = LocationDetector::GetEarlyOutRect(location_rect);
+	int threshold = detector_config.brightness_threshold;
+
+	// same sizes as the OCR cascade of the detector
+	std::vector<cv::Size> ocr_sizes;
+	for (int width : detector_config.ocr_game_widths)
+		ocr_sizes.push_back(LocationDetector::GetOcrSize(location_rect, width, game_img.size()));
+
+	constexpr int num_runs = 1000;
+	cv::Mat early_out_gray, location_gray, shrunk_gray, ocr_input;
+	cv::Rect location_box(cv::Point(), location_rect.size());		// all of location_gray
+	uint32_t separate_count = 0, fused_count = 0;
+
+	// what Screen() and Detect() did before: convert the early-out area, then the whole box, then shrink and invert it on each level.
+	// Now the early-out counts straight from the game image, and each level shrinks and inverts the gray box in one pass
+	auto tseparate = std::chrono::steady_clock::now();
+	for (int run = 0; run < num_runs; run++)
+	{
+		cv::cvtColor(game_img(early_out_rect), early_out_gray, cv::COLOR_BGR2GRAY);
+		separate_count = util::CountPixelsAbove(early_out_gray, threshold);
+		cv::cvtColor(game_img(location_rect), location_gray, cv::COLOR_BGR2GRAY);
+		for (const cv::Size& size : ocr_sizes)
+		{
+			cv::resize(location_gray, shrunk_gray, size);
+			util::BrightTextToOcrInput(shrunk_gray, ocr_input);
+		}
+	}
+	auto tfused = std::chrono::steady_clock::now();
+	for (int run = 0; run < num_runs; run++)
+	{
+		fused_count = util::PreprocessBrightText(game_img, early_out_rect, nullptr, threshold, cv::Rect(cv::Point(), early_out_rect.size()), nullptr, cv::Size());
+		cv::cvtColor(game_img(location_rect), location_gray, cv::COLOR_BGR2GRAY);
+		for (const cv::Size& size : ocr_sizes)
+			util::PreprocessBrightText(location_gray, location_box, nullptr, threshold, cv::Rect(), &ocr_input, size);
+	}
+	auto tend = std::chrono::steady_clock::now();
+
+	// the kernels for a fixed game size, if there are ones for this size
+	location_kernels::EarlyOutKernel early_out_kernel = location_kernels::FindEarlyOutKernel(game_img.size(), location_rect);
+	std::vector<location_kernels::OcrInputKernel> ocr_input_kernels;
+	for (const cv::Size& size : ocr_sizes)
+		ocr_input_kernels.push_back(location_kernels::FindOcrInputKernel(game_img.size(), location_rect, size));
+	bool has_kernels = early_out_kernel && std::all_of(ocr_input_kernels.begin(), ocr_input_kernels.end(), [](location_kernels::OcrInputKernel kernel) { return kernel != nullptr; });
+	uint32_t fixed_count = 0;
+	int max_fixed_difference = 0;
+	auto tfixed = std::chrono::steady_clock::now();
+	if (has_kernels)
+	{
+		for (int run = 0; run < num_runs; run++)
+		{
+			fixed_count = early_out_kernel(game_img, threshold);
+			cv::cvtColor(game_img(location_rect), location_gray, cv::COLOR_BGR2GRAY);
+			for (location_kernels::OcrInputKernel kernel : ocr_input_kernels)
+				kernel(location_gray, ocr_input);
+		}
+		tfixed = std::chrono::steady_clock::now();
+
+		cv::Mat fixed_input;
+		cv::cvtColor(game_img(location_rect), location_gray, cv::COLOR_BGR2GRAY);
+		for (size_t i = 0; i < ocr_sizes.size(); i++)
+		{
+			util::PreprocessBrightText(location_gray, location_box, nullptr, threshold, cv::Rect(), &ocr_input, ocr_sizes[i]);
+			ocr_input_kernels[i](location_gray, fixed_input);
+			for (int row = 0; row < ocr_sizes[i].height; row++)
 			{
-				if (cur_frame % 30 == 0)
-					std::cout << buf << std::string(70 - strlen(buf), ' ') << '\r';
+				const uint32_t* a = ocr_input.ptr<uint32_t>(row);
+				const uint32_t* b = fixed_input.ptr<uint32_t>(row);
+				for (int col = 0; col < ocr_sizes[i].width; col++)
+					max_fixed_difference = std::max(max_fixed_difference, std::abs(int(a[col] >> 24) - int(b[col] >> 24)));
 			}
 		}
 	}
+
+	// the fused kernel shrinks by averaging, compare it with INTER_AREA. They are the same for integer scales
+	int max_difference = 0;
+	cv::Mat reference;
+	cv::cvtColor(game_img(location_rect), location_gray, cv::COLOR_BGR2GRAY);
+	for (const cv::Size& size : ocr_sizes)
+	{
+		cv::resize(location_gray, shrunk_gray, size, 0.0, 0.0, cv::INTER_AREA);
+		util::BrightTextToOcrInput(shrunk_gray, reference);
+		util::PreprocessBrightText(location_gray, location_box, nullptr, threshold, cv::Rect(), &ocr_input, size);
+		for (int row = 0; row < size.height; row++)
+		{
+			const uint32_t* a = reference.ptr<uint32_t>(row);
+			const uint32_t* b = ocr_input.ptr<uint32_t>(row);
+			for (int col = 0; col < size.width; col++)
+				max_difference = std::max(max_difference, std::abs(int(a[col] >> 24) - int(b[col] >> 24)));
+		}
+	}
+
+	double separate_us = std::chrono::duration<double, std::micro>(tfused - tseparate).count() / num_runs;
+	double fused_us = std::chrono::duration<double, std::micro>(tend - tfused).count() / num_runs;
+	std::cout << "Game image " << game_img.cols << "x" << game_img.rows << ", location box " << location_rect.width << "x" << location_rect.height << ", OCR sizes";
+	for (const cv::Size& size : ocr_sizes)
+		std::cout << " " << size.width << "x" << size.height;
+	std::cout << std::endl;
+	std::cout << "Separate steps: " << separate_us << "us per frame" << std::endl;
+	std::cout << "Fused kernel:   " << fused_us << "us per frame (" << separate_us / fused_us << "x)" << std::endl;
+	std::cout << "Bright pixels in the early-out area: " << separate_count << " separate, " << fused_count << " fused" << std::endl;
+	std::cout << "Largest difference of the OCR input to INTER_AREA shrinking: " << max_difference << std::endl;
+	if (has_kernels)
+	{
+		double fixed_us = std::chrono::duration<double, std::micro>(tfixed - tend).count() / num_runs;
+		std::cout << "Fixed size:     " << fixed_us << "us per frame (" << fused_us / fixed_us << "x of fused)" << std::endl;
+		std::cout << "Bright pixels in the early-out area: " << fixed_count << " fixed size, largest difference of its OCR input to the fused kernel: " << max_fixed_difference << std::endl;
+	}
 	else
+		std::cout << "No fixed size kernels for this game size" << std::endl;
+}
+
+// Checks that detecting the location on a screenshot doesn't allocate memory once the plan of its size is set up.
+// The screenshot is detected as it is and with the location box dark, which stops at the early-out. Allocations inside Tesseract are not counted.
+bool CheckDetectionAllocations(const std::string& image_file, const cv::Rect& game_rect, const LocationDetector::Config& detector_config)
+{
+	cv::Mat img = cv::imread(image_file, cv::IMREAD_COLOR);
+	if (img.empty())
 	{
-		std::cout << "Cannot open video file " << video_file << std::endl;
+		std::cout << "Cannot read image " << image_file << std::endl;
+		return false;
+	}
+	cv::Mat game_img = game_rect.area() > 0 ? img(game_rect & cv::Rect(0, 0, img.cols, img.rows)) : img;
+	cv::Mat dark_img = game_img.clone();
+	dark_img(HudFrame::ToPixels(LocationDetector::GetLocationRegion(), dark_img.size())).setTo(cv::Scalar(0, 0, 0));
+
+	LocationDetector detector;
+	if (!detector.Init("eng", detector_config))
+		return false;
+
+	// the first detections fill the plan, the buffers and the edit distance table
+	constexpr int num_warm_up_runs = 3;
+	constexpr int num_runs = 100;
+	bool passed = true;
+	for (const auto& [name, frame] : { std::make_pair("screenshot", &game_img), std::make_pair("dark location box", &dark_img) })
+	{
+		std::string_view location;
+		for (int run = 0; run < num_warm_up_runs; run++)
+			location = detector.GetLocation(*frame);
+
+		util::g_num_allocations = 0;
+		util::g_count_allocations = true;
+		for (int run = 0; run < num_runs; run++)
+			detector.GetLocation(*frame);
+		util::g_count_allocations = false;
+
+		uint64_t num_allocations = util::g_num_allocations;
+		std::cout << name << ": " << (location.size() ? location : "no location") << ", " << num_allocations << " allocations in " << num_runs << " detections" << std::endl;
+		passed = passed && num_allocations == 0;
 	}
+	std::cout << (passed ? "Passed" : "Failed, the detection allocates memory on every frame") << std::endl;
+	return passed;
 }
 
-void AnalyseLiveStream(int brightness_threshold, int bright_pixel_ratio_low, int bright_pixel_ratio_high)
+// Checks that a frame which passes the early-out but has no text, like snow or sky, doesn't go up the whole OCR cascade.
+// The location box of the screenshot is made dark with a bright bar over the middle of the early-out area
+bool CheckEmptyTextCascade(const std::string& image_file, const cv::Rect& game_rect, const LocationDetector::Config& detector_config)
 {
-	std::string lang = "eng";
+	cv::Mat img = cv::imread(image_file, cv::IMREAD_COLOR);
+	if (img.empty())
+	{
+		std::cout << "Cannot read image " << image_file << std::endl;
+		return false;
+	}
+	cv::Mat game_img = (game_rect.area() > 0 ? img(game_rect & cv::Rect(0, 0, img.cols, img.rows)) : img).clone();
+	cv::Rect location_rect = HudFrame::ToPixels(LocationDetector::GetLocationRegion(), game_img.size());
+	cv::Rect early_out_rect = LocationDetector::GetEarlyOutRect(location_rect);
+	game_img(location_rect).setTo(cv::Scalar(0, 0, 0));
+	int bar_height = early_out_rect.height * (detector_config.bright_pixel_ratio_low + detector_config.bright_pixel_ratio_high) / 200;
+	game_img(cv::Rect(early_out_rect.x, early_out_rect.y + (early_out_rect.height - bar_height) / 2, early_out_rect.width, bar_height)).setTo(cv::Scalar(255, 255, 255));
 
-	LocationDetector location_detector;
-	if (!location_detector.Init(lang.c_str(), brightness_threshold, bright_pixel_ratio_low, bright_pixel_ratio_high))
-		return;
+	LocationDetector detector;
+	if (!detector.Init("eng", detector_config))
+		return false;
+	std::string_view location = detector.GetLocation(game_img);
 
+	// the levels after the first one where a read without text ends the cascade must not be reached
+	const std::vector<int>& widths = detector_config.ocr_game_widths;
+	size_t last_level = widths.size() - 1;
+	for (size_t i = 0; i < widths.size(); i++)
+	{
+		if (LocationDetector::EmptyTextEndsCascade(widths[i], detector_config.empty_text_game_width))
+		{
+			last_level = i;
+			break;
+		}
+	}
+	bool passed = true;
+	std::cout << "box without text: " << (location.size() ? location : "no location") << ", OCRs per level";
+	for (size_t i = 0; i < widths.size(); i++)
+	{
+		std::cout << " " << detector.NumOcr(i);
+		passed = passed && (i <= last_level || detector.NumOcr(i) == 0);
+	}
+	std::cout << std::endl;
+	std::cout << (passed ? "Passed" : "Failed, the OCR cascade went past the first level that should end it without text") << std::endl;
+	return passed;
+}
+
+// per-stream state of the live mode
+struct LiveStream
+{
+	std::string cam_name;				// or the file name of a recording
+	FFmpegWrap capture;
 	int last_frame = -1;
+	uint64_t num_replaced = 0;			// frames the capture replaced before this loop got to them, i.e. lost to a slow consumer
 	cv::Mat mat;
-	while (1)
+	cv::Rect game_rect;
+	GameAreaDetector game_area_detector;
+	HudEngine screen_engine;			// runs the early-out of every frame, without OCR
+	LocationDetector* screen_location_detector = nullptr;
+	std::unique_ptr<RoiRing> roi_ring;		// recent location boxes, served on /replay
+	FrameSampler sampler;
+
+	// only accessed by the result handler of the detector pool
+	HudEventTracker event_tracker;
+
+	// The loop got to frame_number, to take it or to let the sampler skip it. Only the frames in between count as replaced,
+	// the frames the sampler skips are counted by the sampler
+	void AdvanceTo(int frame_number)
+	{
+		num_replaced += frame_number - std::max(last_frame, 0) - 1;
+		last_frame = frame_number;
+	}
+};
+
+// scheduling and latency settings of the live mode
+struct LiveConfig
+{
+	int num_workers = 0;
+	std::chrono::milliseconds deadline{ 0 };			// frames older than this are dropped instead of being processed, 0 means no deadline
+	util::ThreadScheduling capture_scheduling;
+	util::ThreadScheduling detection_scheduling;
+	int replay_seconds = 10;			// length of the location box history of each stream, 0 means no history
+	std::string record_file;			// the captured frames are saved here, with ".N" before the extension for stream N if there are several
+	bool play_recordings = false;		// the stream names are recordings to play instead of cameras
+	bool play_realtime = true;			// play recordings with their original timing, otherwise as fast as the frames are taken
+	bool shared_memory = false;			// the stream names are shared memory ring buffers of local producers, see shared_frames.h
+	std::string trace_file;				// the stage times of the frames are written here as a Chrome trace
+	std::chrono::milliseconds sample_delay{ 0 };		// frames are sampled while no banner is near, delaying a detection by at most this much. 0 processes every frame
+
+	bool UsesCameras() const { return !play_recordings && !shared_memory; }
+};
+
+// trace the stages a frame went through, from the capture to the result
+void TraceJob(int stream, const DetectorPool::Job& job)
+{
+	g_tracer.AddSpan("decode", stream, Tracer::CaptureLane, job.frame_number, job.arrival_time, job.frame_time);
+	g_tracer.AddSpan("early-out", stream, Tracer::LiveLoopLane, job.frame_number, job.screen_begin, job.screen_end);
+	if (job.candidates.empty())
+		return;
+	int worker_lane = Tracer::WorkerLane + job.worker_index;
+	g_tracer.AddSpan("queue", stream, Tracer::QueueLane, job.frame_number, job.screen_end, job.ocr_begin);
+	g_tracer.AddSpan("ocr", stream, worker_lane, job.frame_number, job.ocr_begin, job.ocr_end);
+	for (const LocationDetector::TimeSpan& span : job.match_spans)
+		g_tracer.AddSpan("match", stream, worker_lane, job.frame_number, span.begin, span.end);
+}
+
+// the websocket message of a location in live mode, with the times of the stages in microseconds since the Unix epoch
+std::string FormatTimedLocation(std::string_view location, const DetectorPool::Job& job, std::chrono::steady_clock::time_point result_time)
+{
+	std::ostringstream os;
+	os << "{\"location\":";
+	util::WriteJsonString(os, location);
+	os << ",\"frame\":" << job.frame_number << ",\"pts\":" << job.pts_us
+		<< ",\"arrival\":" << Tracer::ToEpochMicroseconds(job.arrival_time)
+		<< ",\"decoded\":" << Tracer::ToEpochMicroseconds(job.frame_time)
+		<< ",\"screened\":" << Tracer::ToEpochMicroseconds(job.screen_end)
+		<< ",\"ocr_begin\":" << Tracer::ToEpochMicroseconds(job.ocr_begin)
+		<< ",\"ocr_end\":" << Tracer::ToEpochMicroseconds(job.ocr_end)
+		<< ",\"pushed\":" << Tracer::ToEpochMicroseconds(result_time) << "}";
+	return os.str();
+}
+
+// record_file of stream N
+std::string GetRecordFileName(const std::string& record_file, int stream_index, int num_streams)
+{
+	if (num_streams <= 1)
+		return record_file;
+	size_t dot = record_file.find_last_of('.');
+	if (dot == std::string::npos || record_file.find_first_of("/\\", dot) != std::string::npos)
+		dot = record_file.size();
+	return record_file.substr(0, dot) + "." + std::to_string(stream_index) + record_file.substr(dot);
+}
+
+// game width the location boxes of the history are kept at
+constexpr int replay_game_width = 480;
+
+// handles "/replay" with the location box history of the streams
+bool ServeReplay(const std::vector<std::unique_ptr<LiveStream>>& streams, const LocationDetector::Config& detector_config,
+	std::unique_ptr<LocationDetector>& replay_detector, const Server::ReplayRequest& request, Server::ReplayResponse& response)
+{
+	if (request.channel >= int(streams.size()) || !streams[request.channel]->roi_ring)
+		return false;
+
+	std::vector<RoiRing::Entry> entries;
+	streams[request.channel]->roi_ring->GetWindow(request.from_frame, request.to_frame, entries);
+
+	if (request.action == "image")
+	{
+		// the boxes stacked from top to bottom, oldest first
+		if (entries.empty())
+			return false;
+		int width = 0;
+		for (const RoiRing::Entry& entry : entries)
+			width = std::max(width, entry.location_gray.cols);
+		std::vector<cv::Mat> rows;
+		for (const RoiRing::Entry& entry : entries)
+		{
+			cv::Mat row;
+			cv::copyMakeBorder(entry.location_gray, row, 0, 0, 0, width - entry.location_gray.cols, cv::BORDER_CONSTANT, cv::Scalar(0));
+			rows.push_back(row);
+		}
+		cv::Mat image;
+		cv::vconcat(rows, image);
+		std::vector<uint8_t> png;
+		cv::imencode(".png", image, png);
+		response.content_type = "image/png";
+		response.body.assign(png.begin(), png.end());
+		return true;
+	}
+
+	bool ocr = request.action == "ocr";
+	if (!ocr && request.action != "list")
+		return false;
+
+	// the OCR models are only loaded when the first OCR request comes in
+	if (ocr && !replay_detector)
+	{
+		replay_detector = std::make_unique<LocationDetector>();
+		if (!replay_detector->Init("eng", detector_config))
+		{
+			replay_detector.reset();
+			return false;
+		}
+	}
+
+	std::ostringstream os;
+	os << entries.size() << " frames" << std::endl;
+	for (RoiRing::Entry& entry : entries)
 	{
-		DWORD tbegin = ::timeGetTime();
-		int cur_frame = FFmpegWrap::GetLatestFrame(last_frame, mat);
-		if (cur_frame != last_frame)
+		os << "[" << std::setw(6) << entry.frame_number << "] " << std::fixed << std::setprecision(2) << entry.bright_pixel_ratio * 100.0 << "% bright, "
+			<< (entry.passed_early_out ? "passed" : "skipped");
+		if (ocr)
 		{
-			char buf[50];
+			HudEvent event;
+			if (replay_detector->DetectInLocationBox(entry.location_gray, entry.game_size, event))
+				os << ": " << event.text;
+		}
+		os << std::endl;
+	}
+	response.body = os.str();
+	return true;
+}
+
+// the pool has its workers loaded already
+void AnalyseLiveStreams(const std::vector<std::string> &cam_names, cv::Rect game_rect, const std::string &output_file, const LocationDetector::Config &detector_config, const LiveConfig &live_config, DetectorPool &pool)
+{
+	FrameSignal frame_signal;
+	std::vector<std::unique_ptr<LiveStream>> streams;
+	for (const std::string& cam_name : cam_names)
+	{
+		LiveStream& stream = *streams.emplace_back(std::make_unique<LiveStream>());
+		stream.cam_name = cam_name;
+		stream.game_rect = game_rect;
+		stream.capture.SetFrameSignal(&frame_signal);
+		stream.capture.SetThreadScheduling(live_config.capture_scheduling);
+		if (live_config.play_recordings)
+		{
+			if (!stream.capture.ReplayRecording(cam_name, live_config.play_realtime))
+				return;
+			continue;
+		}
+		if (live_config.shared_memory)
+		{
+			if (!stream.capture.CaptureSharedMemory(cam_name))
+				return;
+			continue;
+		}
+		if (live_config.record_file.size())
+			stream.capture.SetRecordFile(GetRecordFileName(live_config.record_file, int(streams.size()) - 1, int(cam_names.size())));
+		if (FFmpegWrap::IsStreamUrl(cam_name))
+		{
+			if (!stream.capture.CaptureStream(cam_name))
 			{
-				auto now = std::chrono::system_clock::now();
-				auto now_ms = std::chrono::time_point_cast<std::chrono::milliseconds>(now);
-				auto diff = now_ms.time_since_epoch();
-				auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(diff) % 1000;
+				std::cout << "Failed to receive stream " << cam_name << "." << std::endl;
+				return;
+			}
+		}
+		else if (!stream.capture.CaptureCamera(cam_name))
+		{
+			std::cout << "Failed to capture camera " << cam_name << "." << std::endl;
+			return;
+		}
+	}
+	bool multi_stream = streams.size() > 1;
 
-				std::time_t time = std::chrono::system_clock::to_time_t(now);
-				std::ostringstream os;
-#pragma warning(push)
-#pragma warning(disable: 4996)
-				os << std::put_time(std::localtime(&time), "%Y-%m-%d %H:%M:%S") << '.' << std::setfill('0') << std::setw(3) << ms.count();
-#pragma warning(pop)
+	// detect the game area automatically if it's not specified
+	bool auto_game_rect = game_rect.width <= 0 || game_rect.height <= 0;
 
-				sprintf_s(buf, "[%6d] %s", cur_frame, os.str().c_str());
+	for (std::unique_ptr<LiveStream>& stream : streams)
+	{
+		stream->screen_location_detector = InitHudEngine(stream->screen_engine, detector_config, true);
+		if (!stream->screen_location_detector)
+			return;
+		if (live_config.replay_seconds > 0)
+			stream->roi_ring = std::make_unique<RoiRing>(std::chrono::seconds(live_config.replay_seconds), replay_game_width);
+		stream->sampler.Init(live_config.sample_delay, detector_config.bright_pixel_ratio_low / 100.0, detector_config.bright_pixel_ratio_high / 100.0);
+	}
+
+	Logger logger;
+	Logger::Config logger_config;
+	logger_config.output_file = output_file;
+	logger_config.num_streams = int(streams.size());
+	logger.Start(logger_config);
+
+	if (live_config.trace_file.size())
+		g_tracer.Start(live_config.trace_file, int(streams.size()));
+
+	// results come in frame order for each stream, the time logged is from the arrival of the frame to the result
+	auto handle_result = [&](int stream_index, DetectorPool::Job& job) {
+		LiveStream& stream = *streams[stream_index];
+		stream.event_tracker.Update(job.events);
+
+		auto result_time = std::chrono::steady_clock::now();
+		TraceJob(stream_index, job);
+
+		std::string_view location = ProcessHudEvents(job.events, logger, stream_index, job.frame_number, job.frame_time);
+		if (location.size() > 0)
+		{
+			g_server.PushTimedMessage(FormatTimedLocation(location, job, result_time), job.frame_number, stream_index);
+			logger.Location(stream_index, job.frame_number, job.frame_time, location, std::chrono::duration_cast<std::chrono::microseconds>(result_time - job.arrival_time).count());
+		}
+	};
+
+	if (!pool.Start(int(streams.size()), handle_result))
+		return;
+	if (multi_stream)
+		std::cout << streams.size() << " streams, " << pool.NumWorkers() << " OCR workers" << std::endl;
+	g_server.SetStatsProvider([&pool, &streams]() {
+		std::string report = pool.GetStreamReport() + pool.GetCascadeReport();
+		for (size_t i = 0; i < streams.size(); i++)
+		{
+			if (streams[i]->sampler.IsEnabled())
+				report += "Stream " + std::to_string(i) + " sampling: " + streams[i]->sampler.GetReport() + "\n";
+		}
+		return report;
+	});
+
+	// the server calls the provider under a lock, so the replay detector needs no lock of its own
+	std::unique_ptr<LocationDetector> replay_detector;
+	if (live_config.replay_seconds > 0)
+	{
+		g_server.SetReplayProvider([&](const Server::ReplayRequest& request, Server::ReplayResponse& response) {
+			return ServeReplay(streams, detector_config, replay_detector, request, response);
+		});
+	}
+
+	// The capture threads signal each new frame, the timeout is only there to check the error flag.
+	// The early-out is done here on every frame the sampler lets through, only frames that need OCR wait for a worker.
+	// The loop ends when all captures have ended, i.e. the recordings have been played to the end
+	auto tbegin = std::chrono::steady_clock::now();
+	std::chrono::microseconds cpu_begin = util::GetProcessCpuTime();
+	uint64_t signal_count = 0;
+	bool error = false;
+	bool all_ended = false;
+	while (!error && !all_ended)
+	{
+		signal_count = frame_signal.Wait(signal_count, std::chrono::milliseconds(100));
+		all_ended = true;
+		for (size_t i = 0; i < streams.size() && !error; i++)
+		{
+			LiveStream& stream = *streams[i];
+			FFmpegWrap::FrameTiming timing;
+			// read before taking the frame, so that a frame delivered right before the end isn't missed
+			bool ended = stream.capture.CaptureEnded();
+			int latest_frame = stream.capture.LatestFrameIndex();
+			if (latest_frame == stream.last_frame)
+			{
+				all_ended &= ended;
+				continue;
 			}
+			all_ended = false;
 
-			g_server.SetLastImage(mat);
-			std::string location = location_detector.GetLocation(mat);
-			DWORD tend = ::timeGetTime();
-			if (location.size() > 0)
+			// a frame the sampler skips isn't taken, so it's not converted either
+			auto tprocess = std::chrono::steady_clock::now();
+			if (!stream.sampler.ShouldProcess(latest_frame, tprocess))
 			{
-				if (location[location.size() - 1] == '\n')
-					location = location.substr(0, location.size() - 1);
-				g_server.PushMessage(location);
-				std::ostringstream os;
-				os << buf << ": " << location;
+				stream.AdvanceTo(latest_frame);
+				stream.capture.SkipFrame(latest_frame);
+				continue;
+			}
 
-				if (os.str().length() < 60)
-					os << std::string(60 - os.str().length(), ' ');
-				os << tend - tbegin << "ms";
+			int cur_frame = stream.capture.GetLatestFrame(stream.last_frame, stream.mat, &timing);
+			std::chrono::steady_clock::time_point frame_time = timing.frame_time;
+			if (cur_frame == stream.last_frame)
+				continue;
+			stream.AdvanceTo(cur_frame);
+			logger.Progress(int(i), cur_frame, frame_time);
 
-				os << '\r';
+			if (auto_game_rect)
+			{
+				if (stream.game_area_detector.Update(stream.mat))
+				{
+					stream.game_rect = stream.game_area_detector.GetGameRect();
+					std::ostringstream os;
+					os << "Game area detected (" << stream.game_rect.x << ", " << stream.game_rect.y << ") + (" << stream.game_rect.width << ", " << stream.game_rect.height << ")";
+					logger.Message(int(i), cur_frame, frame_time, os.str());
+				}
+				else if (!stream.game_area_detector.IsFound())
+					stream.game_rect = cv::Rect(0, 0, stream.mat.cols, stream.mat.rows);
+			}
+			else if (stream.game_rect.x < 0 || stream.game_rect.y < 0 || stream.game_rect.x + stream.game_rect.width > stream.mat.cols || stream.game_rect.y + stream.game_rect.height > stream.mat.rows)
+			{
+				logger.Message(int(i), cur_frame, frame_time, "Error: game image area outside input frame of " + stream.cam_name);
+				error = true;
+				break;
+			}
+
+			g_server.SetLastImage(stream.mat(stream.game_rect), int(i));
+
+			std::unique_ptr<DetectorPool::Job> job = pool.NewJob();
+			job->frame_number = cur_frame;
+			job->frame_time = frame_time;
+			job->game_rect = stream.game_rect;
+			job->pts_us = timing.pts_us;
+			job->arrival_time = timing.arrival_time;
+			job->screen_begin = std::chrono::steady_clock::now();
+			job->candidates = stream.screen_engine.Screen(stream.mat(stream.game_rect), job->events);
+			job->screen_end = std::chrono::steady_clock::now();
 
-				std::cout << os.str();
+			// the early-out result of the location box, unless a black or loading screen ended the screening before it.
+			// LastBrightPixelRatio() is of an earlier frame then
+			bool location_screened = std::none_of(job->events.begin(), job->events.end(), [](const HudEvent& event) { return event.source->IsExclusive(); });
+			double bright_pixel_ratio = location_screened ? stream.screen_location_detector->LastBrightPixelRatio() : 0.0;
+			if (stream.roi_ring)
+			{
+				stream.roi_ring->Add(cur_frame, frame_time, stream.mat(stream.game_rect), bright_pixel_ratio,
+					location_screened && stream.screen_location_detector->ScreenLocationBox(bright_pixel_ratio));
 			}
-			else
-				std::cout << buf << std::string(70 - strlen(buf), ' ') << '\r';
 
-			last_frame = cur_frame;
+			// the worker needs the pixels, the stream gets the old buffer of the job to capture the next frame into
+			bool passed = job->candidates.size() > 0;
+			if (passed)
+				cv::swap(job->frame, stream.mat);
+			pool.Submit(int(i), std::move(job));
+
+			auto tprocessed = std::chrono::steady_clock::now();
+			stream.sampler.Update(location_screened, bright_pixel_ratio, passed, tprocessed,
+				std::chrono::duration_cast<std::chrono::microseconds>(tprocessed - tprocess));
 		}
-		else
+	}
+
+	g_server.SetStatsProvider(nullptr);
+	g_server.SetReplayProvider(nullptr);
+	pool.Stop();
+	logger.Stop();
+	g_tracer.Stop();
+
+	if (all_ended)
+	{
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - tbegin).count();
+		double cpu_seconds = std::chrono::duration<double>(util::GetProcessCpuTime() - cpu_begin).count();
+		std::cout << std::endl << "All input streams ended after " << seconds << " seconds, " << cpu_seconds << " seconds of CPU time" << std::endl;
+		for (size_t i = 0; i < streams.size(); i++)
+		{
+			const LiveStream& stream = *streams[i];
+			std::cout << "Stream " << i << ": " << stream.last_frame << " frames captured, " << stream.num_replaced << " replaced before they were taken";
+			if (stream.capture.RecordFailed())
+				std::cout << ", the recording failed";
+			else if (stream.capture.NumRecordStalls() > 0)
+				std::cout << ", the capture waited for the recording " << stream.capture.NumRecordStalls() << " times";
+			if (stream.capture.NumLateFrames() > 0 || stream.capture.NumDroppedPackets() > 0 || stream.capture.NumBadPackets() > 0)
+				std::cout << ", " << stream.capture.NumLateFrames() << " decoded after a newer one arrived, " << stream.capture.NumDroppedPackets() << " packets dropped, "
+					<< stream.capture.NumBadPackets() << " rejected by the decoder";
+			std::cout << std::endl;
+			if (stream.sampler.IsEnabled())
+				std::cout << "  sampling: " << stream.sampler.GetReport() << std::endl;
+		}
+		std::cout << pool.GetStreamReport();
+	}
+}
+
+// Reference producer of -shm: play a video file into a shared memory ring buffer in real time, in BGRA as a capture plugin would deliver it
+void FeedSharedMemory(const std::string& name, const std::string& video_file)
+{
+	cv::VideoCapture cap(video_file);
+	if (!cap.isOpened())
+	{
+		std::cout << "Cannot open video file " << video_file << std::endl;
+		return;
+	}
+	double fps = cap.get(cv::CAP_PROP_FPS);
+	if (fps <= 0.0)
+		fps = 60.0;
+	int width = int(cap.get(cv::CAP_PROP_FRAME_WIDTH));
+	int height = int(cap.get(cv::CAP_PROP_FRAME_HEIGHT));
+
+	SharedFrameWriter writer;
+	if (!writer.Create(name, uint64_t(width) * height * 4))
+		return;
+	std::cout << "Playing " << video_file << " into shared memory " << name << ", run HRT with -shm " << name << " to take the frames" << std::endl;
+
+	cv::Mat frame, bgra;
+	uint64_t num_frames = 0;
+	auto start_time = std::chrono::steady_clock::now();
+	while (cap.read(frame))
+	{
+		std::this_thread::sleep_until(start_time + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(num_frames / fps)));
+		cv::cvtColor(frame, bgra, cv::COLOR_BGR2BGRA);
+		int64_t timestamp_us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+		if (!writer.Write(shared_frames::format_bgra, bgra.cols, bgra.rows, int(bgra.step), bgra.ptr(), timestamp_us))
 		{
-			::Sleep(1);
+			std::cout << "Frame " << num_frames << " doesn't fit into the ring buffer" << std::endl;
+			break;
 		}
+		num_frames++;
 	}
+	writer.Close();
+	std::cout << num_frames << " frames written" << std::endl;
 }
 
 void DisplayHelpText()
@@ -182,8 +1001,9 @@ void DisplayHelpText()
 	std::cout << "Options:" << std::endl;
 	std::cout << "  -v file start length      take a video file as input" << std::endl;
 	std::cout << "                            start and length specifies the frame range" << std::endl;
+	std::cout << "                            a seek index is saved next to the video on the first run, as <file>.hrtidx" << std::endl;
 	std::cout << "  -b x y w h                specify the area of the game image" << std::endl;
-	std::cout << "                            (if not specified, the whole input image is used)" << std::endl;
+	std::cout << "                            (if not specified, the game area is detected automatically)" << std::endl;
 	std::cout << "  -e threshold ratio_low ratio_high" << std::endl;
 	std::cout << "                            specify the early out parameters" << std::endl;
 	std::cout << "                            if percentage of pixels in the location box that are brighter than" << std::endl;
@@ -191,6 +1011,60 @@ void DisplayHelpText()
 	std::cout << "                            Brightness in range 0-255, ratios are in percentage." << std::endl;
 	std::cout << "                            Default values are 240 15 30." << std::endl;
 	std::cout << "  -o output_file            output detected locations with timestamp to a file" << std::endl;
+	std::cout << "                            if the file name ends with .jsonl, each location and HUD event is written as a JSON object on its own line" << std::endl;
+	std::cout << "  -s width[,width...]       specify the OCR cascade" << std::endl;
+	std::cout << "                            OCR is first done with the game image shrunk to the first width, and retried" << std::endl;
+	std::cout << "                            with the next widths if the text doesn't match a location exactly. 0 means full resolution." << std::endl;
+	std::cout << "                            A width of 480 or more that reads no text at all ends the cascade." << std::endl;
+	std::cout << "                            Default value is 240,480,0." << std::endl;
+	std::cout << "                            OCR statistics of each width are shown on http://localhost:12177/stats" << std::endl;
+	std::cout << "  -m model_file             Tesseract model to use instead of eng.traineddata, e.g. one pruned to fewer components" << std::endl;
+	std::cout << "  -nd                       don't load the word lists of the Tesseract model, which makes loading faster" << std::endl;
+	std::cout << "  -l location_file          load the location names from a file, one per line, instead of using the built-in list" << std::endl;
+	std::cout << "  -r cache_file             with -v, also write an analysis cache of the video" << std::endl;
+	std::cout << "                            it holds the early out statistics of all frames and the location boxes of likely frames," << std::endl;
+	std::cout << "                            so that -a can run the detection again with different -e / -s in seconds" << std::endl;
+	std::cout << "  -a cache_file             analyse an analysis cache written with -r instead of a video" << std::endl;
+	std::cout << "                            The brightness threshold of -e has to be in range 192-254." << std::endl;
+	std::cout << "  -train model_file         with -a, train a banner classifier on the boxes of the cache that pass the early out" << std::endl;
+	std::cout << "                            each box is labelled by whether OCR finds a location in it" << std::endl;
+	std::cout << "  -g model_file             run a banner classifier trained with -train before OCR, boxes that don't look like a location banner are skipped" << std::endl;
+	std::cout << "                            with -a, the OCR false positives with and without it are compared" << std::endl;
+	std::cout << "  -sweep sweep_file         with -v, compare the location detection with the configurations in a file in one pass over the video" << std::endl;
+	std::cout << "                            each line is \"threshold ratio_low ratio_high [widths [min_confidence [max_edit_percentage]]]\"," << std::endl;
+	std::cout << "                            e.g. \"240 15 30 240,480,0 70 20\". Missing values are taken from -e / -s" << std::endl;
+	std::cout << "                            a banner classifier given with -g is run before the OCR of all of them, -o can't be used" << std::endl;
+	std::cout << "  -c camera_name            capture from the given camera instead of choosing one interactively" << std::endl;
+	std::cout << "                            a URL like srt://host:port, udp://@:port (MPEG-TS) or rtmp://host/app/key receives a stream over the network" << std::endl;
+	std::cout << "                            repeat to track several streams at once, stream N is shown on http://localhost:12177/?stream=N" << std::endl;
+	std::cout << "  -w workers                number of OCR threads shared by the streams" << std::endl;
+	std::cout << "                            Default value is twice the number of streams, up to half the number of CPU cores." << std::endl;
+	std::cout << "  -d milliseconds           drop live frames that are older than this when an OCR thread becomes free" << std::endl;
+	std::cout << "                            Default value is 0, which means no frames are dropped for being late." << std::endl;
+	std::cout << "  -sample milliseconds      process fewer live frames while no location banner is near, to save CPU" << std::endl;
+	std::cout << "                            a location is detected at most this much plus one frame later. Default value is 0, which processes every frame." << std::endl;
+	std::cout << "  -tc priority affinity     scheduling of the capture threads" << std::endl;
+	std::cout << "  -td priority affinity     scheduling of the OCR threads" << std::endl;
+	std::cout << "                            priority is in range -2 (lowest) to 2 (highest), affinity is a bit mask of CPU cores, 0 means any core." << std::endl;
+	std::cout << "  -k seconds                keep the location boxes of the last seconds of each live stream" << std::endl;
+	std::cout << "                            http://localhost:12177/replay/N/list, /image and /ocr show them, with ?from=frame&to=frame to pick a window" << std::endl;
+	std::cout << "                            Default value is 10, 0 disables it." << std::endl;
+	std::cout << "  -rec file                 save the frames captured from cameras or network streams with their arrival times to a file," << std::endl;
+	std::cout << "                            to play them back later with -p" << std::endl;
+	std::cout << "                            with several cameras, the stream index is added before the extension. Frames are stored as lossless PNG" << std::endl;
+	std::cout << "  -p file                   play a file saved with -rec instead of capturing a camera, with the original timing" << std::endl;
+	std::cout << "  -pf file                  same as -p, but each frame is played as soon as the previous one was taken" << std::endl;
+	std::cout << "                            repeat to play several streams at once. Frame counts, latencies and CPU time are shown at the end" << std::endl;
+	std::cout << "  -bench image_file         time the preprocessing of the location box on a screenshot, the old separate steps against" << std::endl;
+	std::cout << "                            the fused kernel, with the game area of -b and the parameters of -e / -s" << std::endl;
+	std::cout << "  -selftest image_file      check that detecting the location on a screenshot makes no memory allocations once it's set up" << std::endl;
+	std::cout << "                            and that a location box without text doesn't go up the whole OCR cascade" << std::endl;
+	std::cout << "                            (except inside Tesseract), with the game area of -b. Exits with 1 if it does" << std::endl;
+	std::cout << "  -shm name                 take the frames a local producer writes into the shared memory ring buffer name, instead of a camera" << std::endl;
+	std::cout << "                            the layout is described in shared_frames.h. Repeat to track several streams at once" << std::endl;
+	std::cout << "  -shmfeed name video_file  reference producer for -shm: play a video file into the shared memory ring buffer name in real time" << std::endl;
+	std::cout << "  -trace file               write the time each live frame spent in decoding, early-out, waiting, OCR, matching and sending" << std::endl;
+	std::cout << "                            to a file in the Chrome trace format, to be opened in https://ui.perfetto.dev or chrome://tracing" << std::endl;
 }
 
 bool str_to_int(const std::string& in_str, int& out_int)
@@ -200,14 +1074,26 @@ bool str_to_int(const std::string& in_str, int& out_int)
 	return pos == in_str.size();
 }
 
+bool str_to_int_list(const std::string& in_str, std::vector<int>& out_ints)
+{
+	out_ints.clear();
+	std::istringstream is(in_str);
+	std::string item;
+	while (std::getline(is, item, ','))
+	{
+		int value;
+		if (!str_to_int(item, value))
+			return false;
+		out_ints.push_back(value);
+	}
+	return out_ints.size() > 0;
+}
+
 int main(int argc, char* argv[])
 {
 	// just in case of non-ansi text in console
 	::SetConsoleOutputCP(CP_UTF8);
 
-	// for shorter thread time slices
-	::timeBeginPeriod(1);
-
 	// disable sleep mode
 	::SetThreadExecutionState(ES_CONTINUOUS | ES_SYSTEM_REQUIRED);
 
@@ -218,10 +1104,17 @@ int main(int argc, char* argv[])
 	std::string video_file_name;
 	int bbox_x = 0, bbox_y = 0, bbox_w = 0, bbox_h = 0;
 	std::string output_file_name;
-
-	// location text has brightness of 245+. Use a loose threshold here to account for blur / compression loss or any filter that camera might apply
-	// This is a conservative range, usually it's around 18% - 25%
-	int brightness_threshold = 240, bright_pixel_ratio_low = 15, bright_pixel_ratio_high = 30;
+	LocationDetector::Config detector_config;
+	std::string cache_file_name;
+	bool reanalyse_mode = false;
+	std::vector<std::string> cam_names;
+	std::vector<std::string> source_names;		// recordings or shared memory ring buffers
+	std::string feed_name, feed_video_file;
+	LiveConfig live_config;
+	std::string banner_train_file;
+	std::string bench_image_file;
+	std::string selftest_image_file;
+	std::string sweep_file;
 
 	for (int i = 1; i < argc; i++)
 	{
@@ -263,7 +1156,7 @@ int main(int argc, char* argv[])
 				DisplayHelpText();
 				return 0;
 			}
-			if (!str_to_int(argv[i + 1], brightness_threshold) || !str_to_int(argv[i + 2], bright_pixel_ratio_low) || !str_to_int(argv[i + 3], bright_pixel_ratio_high))
+			if (!str_to_int(argv[i + 1], detector_config.brightness_threshold) || !str_to_int(argv[i + 2], detector_config.bright_pixel_ratio_low) || !str_to_int(argv[i + 3], detector_config.bright_pixel_ratio_high))
 			{
 				DisplayHelpText();
 				return 0;
@@ -280,6 +1173,229 @@ int main(int argc, char* argv[])
 			output_file_name = argv[i + 1];
 			i += 1;
 		}
+		else if (cur_arg == "-s")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			if (!str_to_int_list(argv[i + 1], detector_config.ocr_game_widths) || std::any_of(detector_config.ocr_game_widths.begin(), detector_config.ocr_game_widths.end(), [](int w) { return w < 0; }))
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			i += 1;
+		}
+		else if (cur_arg == "-m")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			detector_config.ocr_model.file = argv[i + 1];
+			i += 1;
+		}
+		else if (cur_arg == "-nd")
+			detector_config.ocr_model.dictionary = false;
+		else if (cur_arg == "-l")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			detector_config.location_file = argv[i + 1];
+			i += 1;
+		}
+		else if (cur_arg == "-g")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			detector_config.banner_model_file = argv[i + 1];
+			i += 1;
+		}
+		else if (cur_arg == "-train")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			banner_train_file = argv[i + 1];
+			i += 1;
+		}
+		else if (cur_arg == "-sweep")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			sweep_file = argv[i + 1];
+			i += 1;
+		}
+		else if (cur_arg == "-bench")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			bench_image_file = argv[i + 1];
+			i += 1;
+		}
+		else if (cur_arg == "-selftest")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			selftest_image_file = argv[i + 1];
+			i += 1;
+		}
+		else if (cur_arg == "-r" || cur_arg == "-a")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			cache_file_name = argv[i + 1];
+			reanalyse_mode = cur_arg == "-a";
+			i += 1;
+		}
+		else if (cur_arg == "-c")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			cam_names.push_back(argv[i + 1]);
+			i += 1;
+		}
+		else if (cur_arg == "-w")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			if (!str_to_int(argv[i + 1], live_config.num_workers) || live_config.num_workers <= 0)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			i += 1;
+		}
+		else if (cur_arg == "-d")
+		{
+			int deadline_ms;
+			if (argc <= i + 1 || !str_to_int(argv[i + 1], deadline_ms) || deadline_ms < 0)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			live_config.deadline = std::chrono::milliseconds(deadline_ms);
+			i += 1;
+		}
+		else if (cur_arg == "-sample")
+		{
+			int sample_delay_ms;
+			if (argc <= i + 1 || !str_to_int(argv[i + 1], sample_delay_ms) || sample_delay_ms < 0)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			live_config.sample_delay = std::chrono::milliseconds(sample_delay_ms);
+			i += 1;
+		}
+		else if (cur_arg == "-k")
+		{
+			if (argc <= i + 1 || !str_to_int(argv[i + 1], live_config.replay_seconds) || live_config.replay_seconds < 0)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			i += 1;
+		}
+		else if (cur_arg == "-rec")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			live_config.record_file = argv[i + 1];
+			i += 1;
+		}
+		else if (cur_arg == "-trace")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			live_config.trace_file = argv[i + 1];
+			i += 1;
+		}
+		else if (cur_arg == "-p" || cur_arg == "-pf")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			live_config.play_recordings = true;
+			live_config.play_realtime = cur_arg == "-p";
+			source_names.push_back(argv[i + 1]);
+			i += 1;
+		}
+		else if (cur_arg == "-shm")
+		{
+			if (argc <= i + 1)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			live_config.shared_memory = true;
+			source_names.push_back(argv[i + 1]);
+			i += 1;
+		}
+		else if (cur_arg == "-shmfeed")
+		{
+			if (argc <= i + 2)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			feed_name = argv[i + 1];
+			feed_video_file = argv[i + 2];
+			i += 2;
+		}
+		else if (cur_arg == "-tc" || cur_arg == "-td")
+		{
+			if (argc <= i + 2)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			util::ThreadScheduling& scheduling = cur_arg == "-tc" ? live_config.capture_scheduling : live_config.detection_scheduling;
+			int affinity;
+			if (!str_to_int(argv[i + 1], scheduling.priority) || scheduling.priority < THREAD_PRIORITY_LOWEST || scheduling.priority > THREAD_PRIORITY_HIGHEST || !str_to_int(argv[i + 2], affinity) || affinity < 0)
+			{
+				DisplayHelpText();
+				return 0;
+			}
+			scheduling.affinity_mask = uint64_t(affinity);
+			i += 2;
+		}
 		else
 		{
 			DisplayHelpText();
@@ -287,7 +1403,73 @@ int main(int argc, char* argv[])
 		}
 	}
 
-	if (video_mode)
+	if (cam_names.size() > 0 && source_names.size() > 0)
+	{
+		std::cout << "Cameras can't be used together with recordings or shared memory" << std::endl;
+		return 0;
+	}
+	if (live_config.play_recordings && live_config.shared_memory)
+	{
+		std::cout << "Recordings and shared memory can't be used together" << std::endl;
+		return 0;
+	}
+	if (live_config.record_file.size() && (live_config.play_recordings || live_config.shared_memory))
+	{
+		std::cout << "-rec only records cameras and network streams, it can't be used with -p, -pf or -shm" << std::endl;
+		return 0;
+	}
+
+	if (feed_name.size())
+	{
+		FeedSharedMemory(feed_name, feed_video_file);
+		return 0;
+	}
+
+	if (banner_train_file.size() && !reanalyse_mode)
+	{
+		std::cout << "-train needs an analysis cache given with -a" << std::endl;
+		return 0;
+	}
+
+	if (cache_file_name.size() && !reanalyse_mode && !video_mode)
+	{
+		std::cout << "-r needs a video given with -v" << std::endl;
+		return 0;
+	}
+
+	if (sweep_file.size() && !video_mode)
+	{
+		std::cout << "-sweep needs a video given with -v" << std::endl;
+		return 0;
+	}
+
+	if (sweep_file.size() && output_file_name.size())
+	{
+		std::cout << "-o can't be used with -sweep, the configurations don't have one result to write" << std::endl;
+		return 0;
+	}
+
+	if (bench_image_file.size())
+	{
+		BenchmarkPreprocessing(bench_image_file, cv::Rect(bbox_x, bbox_y, bbox_w, bbox_h), detector_config);
+		return 0;
+	}
+
+	if (selftest_image_file.size())
+	{
+		cv::Rect game_rect(bbox_x, bbox_y, bbox_w, bbox_h);
+		bool passed = CheckDetectionAllocations(selftest_image_file, game_rect, detector_config);
+		passed = CheckEmptyTextCascade(selftest_image_file, game_rect, detector_config) && passed;
+		return passed ? 0 : 1;
+	}
+
+	if (reanalyse_mode)
+	{
+		std::cout << "Running in re-analysis mode" << std::endl;
+		ReanalyseCache(cache_file_name, output_file_name, detector_config, banner_train_file);
+		return 0;
+	}
+	else if (video_mode)
 	{
 		if (!g_server.Start())
 			return 0;
@@ -299,48 +1481,120 @@ int main(int argc, char* argv[])
 		std::cout << "Run \"webui.bat\" to start the web-ui" << std::endl;
 		::SetConsoleTextAttribute(hConsole, 7);
 
-		AnalyseVideo(video_file_name, cv::Rect(bbox_x, bbox_y, bbox_w, bbox_h), frame_start, num_frame, output_file_name, brightness_threshold, bright_pixel_ratio_low, bright_pixel_ratio_high);
+		AnalyseVideo(video_file_name, cv::Rect(bbox_x, bbox_y, bbox_w, bbox_h), frame_start, num_frame, output_file_name, cache_file_name, detector_config, sweep_file);
 	}
 	else
 	{
-		std::vector<std::string> cams = FFmpegWrap::ListCameras();
-		if (cams.size() == 0)
+		// Listing the cameras, loading the OCR models and starting the server don't depend on each other, so they run at the same time.
+		// The time spent waiting for the choice of cameras is not counted
+		auto tstartup = std::chrono::steady_clock::now();
+		std::chrono::steady_clock::duration prompt_time{ 0 }, cameras_time{ 0 }, workers_time{ 0 }, server_time{ 0 };
+
+		// network streams are given with -c too, the cameras are only listed if there's any other name or none at all
+		bool list_cameras = live_config.UsesCameras()
+			&& (cam_names.empty() || std::any_of(cam_names.begin(), cam_names.end(), [](const std::string& name) { return !FFmpegWrap::IsStreamUrl(name); }));
+		std::future<std::vector<std::string>> cams_future;
+		if (!live_config.UsesCameras())
+			cam_names = source_names;
+		else if (list_cameras)
 		{
-			std::cout << "No cameras found." << std::endl;
-			return 0;
+			cams_future = std::async(std::launch::async, [&cameras_time]() {
+				auto tbegin = std::chrono::steady_clock::now();
+				std::vector<std::string> cams = FFmpegWrap::ListCameras();
+				cameras_time = std::chrono::steady_clock::now() - tbegin;
+				return cams;
+			});
 		}
 
-		std::cout << "Found " << cams.size() << " cameras" << std::endl;
+		// each worker has its own OCR engine, leave some cores to the capture threads and the rest of the system.
+		// Two per stream let the OCR of a frame start while the previous one is still running during a burst of banners
+		auto get_num_workers = [&live_config](int num_streams) {
+			return live_config.num_workers > 0 ? live_config.num_workers : std::clamp(int(std::thread::hardware_concurrency() / 2), 1, num_streams * 2);
+		};
+		DetectorPool pool;
+		pool.SetDeadline(live_config.deadline);
+		pool.SetThreadScheduling(live_config.detection_scheduling);
+		auto init_worker = [&detector_config](DetectorPool::Worker& worker) {
+			worker.location_detector = InitHudEngine(worker.hud_engine, detector_config);
+			return worker.location_detector != nullptr;
+		};
+		// until the cameras are chosen, load the workers of a single stream
+		auto add_workers = [&](int num_workers) {
+			auto tbegin = std::chrono::steady_clock::now();
+			bool success = pool.AddWorkers(num_workers - pool.NumWorkers(), init_worker);
+			workers_time += std::chrono::steady_clock::now() - tbegin;
+			return success;
+		};
+		std::future<bool> workers_future = std::async(std::launch::async, add_workers, get_num_workers(std::max(int(cam_names.size()), 1)));
 
-		for (int i = 0; i < int(cams.size()); i++)
-			std::cout << "[" << i + 1 << "]: " << cams[i] << std::endl;
-		std::cout << "Choose your input stream (1-" << cams.size() << "): ";
-		std::string input;
-		std::cin >> input;
-		int choice = -1;
-		if (!str_to_int(input, choice) || choice <=0 || choice > int(cams.size()))
+		// recordings, shared memory and network streams are used as given, cameras are checked against the ones found or chosen interactively
+		if (list_cameras)
 		{
-			std::cout << "Invalid input, please enter a number in the given range" << std::endl;
-			return 0;
+			std::vector<std::string> cams = cams_future.get();
+			if (cams.size() == 0)
+			{
+				std::cout << "No cameras found." << std::endl;
+				return 0;
+			}
+
+			if (cam_names.size() == 0)
+			{
+				std::cout << "Found " << cams.size() << " cameras" << std::endl;
+
+				for (int i = 0; i < int(cams.size()); i++)
+					std::cout << "[" << i + 1 << "]: " << cams[i] << std::endl;
+				std::cout << "Choose your input stream (1-" << cams.size() << "), or several separated by commas: ";
+				auto tprompt = std::chrono::steady_clock::now();
+				std::string input;
+				std::cin >> input;
+				prompt_time = std::chrono::steady_clock::now() - tprompt;
+				std::vector<int> choices;
+				if (!str_to_int_list(input, choices) || std::any_of(choices.begin(), choices.end(), [&cams](int choice) { return choice <= 0 || choice > int(cams.size()); }))
+				{
+					std::cout << "Invalid input, please enter numbers in the given range" << std::endl;
+					return 0;
+				}
+				for (int choice : choices)
+					cam_names.push_back(cams[choice - 1]);
+			}
+			else
+			{
+				for (const std::string& cam_name : cam_names)
+				{
+					if (!FFmpegWrap::IsStreamUrl(cam_name) && std::find(cams.begin(), cams.end(), cam_name) == cams.end())
+					{
+						std::cout << "Camera \"" << cam_name << "\" not found." << std::endl;
+						return 0;
+					}
+				}
+			}
 		}
 
-		if (!FFmpegWrap::CaptureCamera(cams[choice - 1]))
+		std::future<bool> server_future = std::async(std::launch::async, [&server_time, num_channels = int(cam_names.size())]() {
+			auto tbegin = std::chrono::steady_clock::now();
+			bool success = g_server.Start(num_channels);
+			server_time = std::chrono::steady_clock::now() - tbegin;
+			return success;
+		});
+		bool workers_loaded = workers_future.get() && add_workers(get_num_workers(int(cam_names.size())));
+		if (!server_future.get())
+			return 0;
+		if (!workers_loaded)
 		{
-			std::cout << "Failed to capture camera." << std::endl;
+			g_server.Stop();
 			return 0;
 		}
 
-		if (!g_server.Start())
-			return 0;
+		auto to_ms = [](std::chrono::steady_clock::duration duration) { return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count(); };
+		std::cout << "Startup took " << to_ms(std::chrono::steady_clock::now() - tstartup - prompt_time) << "ms: listing cameras " << to_ms(cameras_time)
+			<< "ms, loading " << pool.NumWorkers() << " OCR workers " << to_ms(workers_time) << "ms, starting the server " << to_ms(server_time) << "ms" << std::endl;
 
 		HANDLE hConsole = ::GetStdHandle(STD_OUTPUT_HANDLE);
 		::SetConsoleTextAttribute(hConsole, 10);
 		std::cout << "Run \"webui.bat\" to start the web-ui" << std::endl;
 		::SetConsoleTextAttribute(hConsole, 7);
 
-		AnalyseLiveStream(brightness_threshold, bright_pixel_ratio_low, bright_pixel_ratio_high);
-
-		FFmpegWrap::StopCapture();
+		AnalyseLiveStreams(cam_names, cv::Rect(bbox_x, bbox_y, bbox_w, bbox_h), output_file_name, detector_config, live_config, pool);
 	}
 
 	g_server.Stop();
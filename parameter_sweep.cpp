@@ -0,0 +1,211 @@
+#include "parameter_sweep.h"
+
+bool ParameterSweep::ParseConfig(const std::string& line, LocationDetector::Config& config) const
+{
+	std::istringstream is(line);
+	if (!(is >> config.brightness_threshold >> config.bright_pixel_ratio_low >> config.bright_pixel_ratio_high))
+		return false;
+	if (config.brightness_threshold < 0 || config.brightness_threshold > 254 || config.bright_pixel_ratio_low > config.bright_pixel_ratio_high)
+		return false;
+
+	std::string widths;
+	if (is >> widths)
+	{
+		config.ocr_game_widths.clear();
+		std::istringstream ws(widths);
+		std::string item;
+		while (std::getline(ws, item, ','))
+		{
+			size_t pos;
+			int width = std::stoi(item, &pos);
+			if (pos != item.size() || width < 0)
+				return false;
+			config.ocr_game_widths.push_back(width);
+		}
+		if (config.ocr_game_widths.empty())
+			return false;
+	}
+	if (is >> config.min_ocr_confidence)
+		is >> config.max_edit_percentage;
+
+	// nothing but the optional values
+	is.clear();
+	std::string rest;
+	return !(is >> rest) && config.max_edit_percentage >= 0;
+}
+
+bool ParameterSweep::Init(const std::string& sweep_file, const LocationDetector::Config& base_config)
+{
+	std::ifstream ifs(sweep_file);
+	if (!ifs.is_open())
+	{
+		std::cout << "Cannot open sweep file " << sweep_file << std::endl;
+		return false;
+	}
+
+	_results.clear();
+	std::string line;
+	for (int line_number = 1; std::getline(ifs, line); line_number++)
+	{
+		if (line.empty() || line[0] == '#' || line.find_first_not_of(" \t\r") == std::string::npos)
+			continue;
+
+		LocationDetector::Config config = base_config;
+		bool valid;
+		try
+		{
+			valid = ParseConfig(line, config);
+		}
+		catch (const std::exception&)
+		{
+			valid = false;
+		}
+		if (!valid)
+		{
+			std::cout << sweep_file << ":" << line_number << ": expected \"threshold ratio_low ratio_high [widths [min_confidence [max_edit_percentage]]]\"" << std::endl;
+			return false;
+		}
+		_results.emplace_back().config = config;
+	}
+	if (_results.empty())
+	{
+		std::cout << "No configurations in sweep file " << sweep_file << std::endl;
+		return false;
+	}
+
+	_num_frames = _num_ocr = 0;
+	_ocr_ms = 0.0;
+	_num_banner_checks = _num_banner_rejected = 0;
+	return _detector.Init("eng", base_config);
+}
+
+const ParameterSweep::CachedOcr& ParameterSweep::GetOcr(const cv::Rect& location_rect, cv::Size ocr_size)
+{
+	for (size_t i = 0; i < _num_cached; i++)
+	{
+		if (_ocr_cache[i].ocr_size == ocr_size)
+			return _ocr_cache[i];
+	}
+
+	if (_num_cached == _ocr_cache.size())
+		_ocr_cache.emplace_back();
+	CachedOcr& cached = _ocr_cache[_num_cached++];
+	cached.ocr_size = ocr_size;
+	auto tbegin = std::chrono::steady_clock::now();
+	_detector.OcrLocationBox(_frame.Gray(location_rect), ocr_size, _ocr_input, cached.ocr_text);
+	cached.time_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - tbegin).count();
+	_num_ocr++;
+	_ocr_ms += cached.time_ms;
+	return cached;
+}
+
+std::string_view ParameterSweep::Detect(Result& result, const cv::Rect& location_rect)
+{
+	// same cascade as LocationDetector::DetectInLocationBox(), with the OCR shared between the configurations
+	const LocationDetector::Config& config = result.config;
+	LocationDetector::Cascade cascade;
+	_tried_sizes.clear();
+	for (size_t i = 0; i < config.ocr_game_widths.size(); i++)
+	{
+		cv::Size ocr_size = LocationDetector::GetOcrSize(location_rect, config.ocr_game_widths[i], _frame.Size());
+		if (std::find(_tried_sizes.begin(), _tried_sizes.end(), ocr_size) != _tried_sizes.end())
+			continue;
+		_tried_sizes.push_back(ocr_size);
+
+		const CachedOcr& cached = GetOcr(location_rect, ocr_size);
+		result.num_ocr++;
+		result.ocr_ms += cached.time_ms;
+		if (!cached.ocr_text.plausible)
+			break;
+		if (cascade.Add(_detector.MatchLocation(cached.ocr_text, config.max_edit_percentage), i, config.min_ocr_confidence))
+			break;
+		if (cached.ocr_text.text.empty() && LocationDetector::EmptyTextEndsCascade(config.ocr_game_widths[i], config.empty_text_game_width))
+			break;
+	}
+	return cascade.best.location ? std::string_view(cascade.best.location->name) : std::string_view();
+}
+
+void ParameterSweep::AddFrame(const cv::Mat& game_img)
+{
+	_frame.Reset(game_img);
+	_num_frames++;
+	_num_cached = 0;
+
+	// same geometry as LocationDetector
+	cv::Rect location_rect = _frame.ToPixels(LocationDetector::GetLocationRegion());
+	cv::Rect early_out_rect = LocationDetector::GetEarlyOutRect(location_rect);
+
+	// number of pixels brighter than each threshold, from one histogram of the early-out area
+	cv::Mat early_out_gray = _frame.Gray(early_out_rect);
+	uint32_t histogram[256] = {};
+	for (int i = 0; i < early_out_gray.rows; i++)
+	{
+		const uint8_t* data = early_out_gray.ptr<uint8_t>(i);
+		for (int j = 0; j < early_out_gray.cols; j++)
+			histogram[data[j]]++;
+	}
+	uint32_t num_brighter[256] = {};
+	for (int t = 254; t >= 0; t--)
+		num_brighter[t] = num_brighter[t + 1] + histogram[t + 1];
+	double area = double(early_out_rect.area());
+
+	// whether the banner classifier lets the box through to OCR, checked when the first configuration passes the early-out
+	int passes_classifier = -1;
+	for (Result& result : _results)
+	{
+		const LocationDetector::Config& config = result.config;
+		double ratio = num_brighter[config.brightness_threshold] / area;
+		result.location = {};
+		if (ratio >= config.bright_pixel_ratio_low / 100.0 && ratio <= config.bright_pixel_ratio_high / 100.0)
+		{
+			result.num_screened++;
+			if (passes_classifier < 0 && _detector.HasBannerClassifier())
+			{
+				passes_classifier = _detector.PassesBannerClassifier(_frame.Gray(location_rect));
+				_num_banner_checks++;
+				_num_banner_rejected += !passes_classifier;
+			}
+			if (passes_classifier != 0)
+				result.location = Detect(result, location_rect);
+		}
+
+		if (result.location.size())
+		{
+			result.num_locations++;
+			if (result.location != result.last_location)
+				result.num_appearances++;
+		}
+		if (result.location != _results[0].location)
+			result.num_differences++;
+		result.last_location = result.location;
+	}
+}
+
+std::string ParameterSweep::GetReport() const
+{
+	std::ostringstream os;
+	uint64_t num_unshared = 0;
+	for (const Result& result : _results)
+		num_unshared += result.num_ocr;
+	os << "Parameter sweep of " << _results.size() << " configurations over " << _num_frames << " frames: " << _num_ocr << " OCR calls in "
+		<< _ocr_ms / 1000.0 << "s, " << num_unshared << " without sharing" << std::endl;
+	if (_detector.HasBannerClassifier())
+		os << "The banner classifier rejected " << _num_banner_rejected << " of " << _num_banner_checks << " boxes before OCR" << std::endl;
+	os << "   #  thr  low high  widths          conf edits   early-out       OCRs   OCR time  locations  appearances  diff to #1" << std::endl;
+	for (size_t i = 0; i < _results.size(); i++)
+	{
+		const Result& result = _results[i];
+		const LocationDetector::Config& config = result.config;
+		std::string widths;
+		for (int width : config.ocr_game_widths)
+			widths += (widths.empty() ? "" : ",") + std::to_string(width);
+		char buf[256];
+		sprintf_s(buf, "%4zu  %3d  %3d  %3d  %-15s  %3d  %3d%%  %10llu %10llu %9.2fs %10llu %12llu %11llu",
+			i + 1, config.brightness_threshold, config.bright_pixel_ratio_low, config.bright_pixel_ratio_high, widths.c_str(),
+			config.min_ocr_confidence, config.max_edit_percentage,
+			(unsigned long long)result.num_screened, (unsigned long long)result.num_ocr, result.ocr_ms / 1000.0,
+			(unsigned long long)result.num_locations, (unsigned long long)result.num_appearances, (unsigned long long)result.num_differences);
+		os << buf << std::endl;
+	}
+	return os.str();
+}
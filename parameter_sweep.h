@@ -0,0 +1,67 @@
+#pragma once
+#include "common.h"
+#include "location_detector.h"
+
+
+// Evaluates many location detector configurations on the same video in one pass, for tuning.
+// Each frame is decoded and converted once. The early-out of all configurations comes from one histogram of the early-out area,
+// and the OCR of a box size is only run once per frame, the configurations that need it share the text and only differ in matching.
+// A banner classifier in the configuration of the command line is applied to all configurations, it's run once per frame that needs OCR.
+//
+// Sweep file: one configuration per line, empty lines and lines starting with '#' are skipped
+//   threshold ratio_low ratio_high [widths [min_confidence [max_edit_percentage]]]
+// e.g. "240 15 30 240,480,0 70 20". Missing values are taken from the command line configuration.
+class ParameterSweep
+{
+private:
+	struct Result
+	{
+		LocationDetector::Config config;
+		uint64_t num_screened = 0;			// frames that passed the early-out
+		uint64_t num_ocr = 0;				// OCR calls the configuration would make on its own
+		double ocr_ms = 0.0;				// time of those calls, shared calls are counted for each configuration
+		uint64_t num_locations = 0;			// frames with a location
+		uint64_t num_appearances = 0;		// runs of consecutive frames with the same location
+		uint64_t num_differences = 0;		// frames with a different result than the first configuration
+		std::string_view location;			// of the current frame
+		std::string_view last_location;		// of the previous frame
+	};
+
+	struct CachedOcr
+	{
+		cv::Size ocr_size;
+		LocationDetector::OcrText ocr_text;
+		double time_ms = 0.0;
+	};
+
+	std::vector<Result> _results;
+	LocationDetector _detector;				// runs the OCR and the matching of all configurations
+	HudFrame _frame;
+	uint64_t _num_frames = 0;
+	uint64_t _num_ocr = 0;					// OCR calls that actually ran
+	double _ocr_ms = 0.0;
+	uint64_t _num_banner_checks = 0, _num_banner_rejected = 0;
+
+	// OCR of the current frame by box size, the first _num_cached entries are valid. Entries are reused so that their strings keep their capacity
+	std::vector<CachedOcr> _ocr_cache;
+	size_t _num_cached = 0;
+
+	// reusable buffers
+	std::vector<cv::Size> _tried_sizes;
+	cv::Mat _ocr_input;
+
+private:
+	bool ParseConfig(const std::string& line, LocationDetector::Config& config) const;
+	const CachedOcr& GetOcr(const cv::Rect& location_rect, cv::Size ocr_size);
+	std::string_view Detect(Result& result, const cv::Rect& location_rect);
+
+public:
+	// base_config gives the defaults of the sweep file and the OCR model / location list of all configurations
+	bool Init(const std::string& sweep_file, const LocationDetector::Config& base_config);
+
+	// game_img is BGR
+	void AddFrame(const cv::Mat& game_img);
+
+	// comparison table of the detections and the OCR cost of each configuration
+	std::string GetReport() const;
+};
@@ -0,0 +1,51 @@
+#include "roi_ring.h"
+#include "hud_engine.h"
+#include "location_detector.h"
+
+RoiRing::RoiRing(std::chrono::seconds duration, int game_width)
+	: _duration(duration), _game_width(game_width)
+{
+	// the slots are added as the ring grows, the vector itself is never reallocated
+	_entries.reserve(size_t(duration.count()) * max_frame_rate);
+}
+
+void RoiRing::Add(int frame_number, std::chrono::steady_clock::time_point frame_time, const cv::Mat& game_img, double bright_pixel_ratio, bool passed_early_out)
+{
+	if (_entries.capacity() == 0)
+		return;
+
+	cv::Rect location_rect = HudFrame::ToPixels(LocationDetector::GetLocationRegion(), game_img.size());
+	cv::Size game_size(_game_width, std::max(int(double(game_img.rows) * _game_width / game_img.cols + 0.5), 1));
+	cv::Size box_size = HudFrame::ToPixels(LocationDetector::GetLocationRegion(), game_size).size();
+	cv::resize(game_img(location_rect), _location_bgr, box_size, 0, 0, cv::INTER_AREA);
+
+	std::lock_guard<std::mutex> lg(_mutex);
+	// a new slot in front of the oldest box while that is still within the duration, i.e. the ring holds fewer frames than the stream
+	// delivers in that time
+	if (_entries.size() < _entries.capacity() && (_entries.empty() || frame_time - _entries[_next].frame_time < _duration))
+		_entries.emplace(_entries.begin() + _next);
+	Entry& entry = _entries[_next];
+	entry.frame_number = frame_number;
+	entry.frame_time = frame_time;
+	entry.bright_pixel_ratio = bright_pixel_ratio;
+	entry.passed_early_out = passed_early_out;
+	entry.game_size = game_size;
+	cv::cvtColor(_location_bgr, entry.location_gray, cv::COLOR_BGR2GRAY);
+
+	_next = (_next + 1) % _entries.size();
+	_count = std::min(_count + 1, _entries.size());
+}
+
+void RoiRing::GetWindow(int from_frame, int to_frame, std::vector<Entry>& entries) const
+{
+	entries.clear();
+	std::lock_guard<std::mutex> lg(_mutex);
+	for (size_t i = 0; i < _count; i++)
+	{
+		const Entry& entry = _entries[(_next + _entries.size() - _count + i) % _entries.size()];
+		if (entry.frame_number < from_frame || entry.frame_number > to_frame)
+			continue;
+		Entry& copy = entries.emplace_back(entry);
+		copy.location_gray = entry.location_gray.clone();
+	}
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "common.h"
+#include <mutex>
+#include <chrono>
+
+// The location boxes of the last frames of a live stream, so that a missed location can be looked into afterwards.
+// The boxes are kept in gray at a small OCR scale. The ring grows while its oldest box is younger than the duration it keeps,
+// so it fits the frame rate of the stream, and no memory is allocated once it has filled.
+class RoiRing
+{
+public:
+	struct Entry
+	{
+		int frame_number = -1;
+		std::chrono::steady_clock::time_point frame_time;		// when the frame was captured
+		double bright_pixel_ratio = 0.0;		// early-out statistic of the frame
+		bool passed_early_out = false;
+		cv::Size game_size;						// size of the scaled game image the box is cut from
+		cv::Mat location_gray;
+	};
+
+private:
+	// the ring doesn't grow beyond this frame rate
+	static constexpr int max_frame_rate = 240;
+
+	std::vector<Entry> _entries;
+	size_t _next = 0;				// slot for the next frame
+	size_t _count = 0;				// number of valid slots
+	std::chrono::steady_clock::duration _duration;
+	int _game_width;
+	mutable std::mutex _mutex;
+
+	// reusable buffer
+	cv::Mat _location_bgr;
+
+public:
+	// duration is how far back the boxes are kept, game_width is the width the game image is shrunk to before the box is cut out
+	RoiRing(std::chrono::seconds duration, int game_width);
+
+	// Add a frame, replacing the oldest one when the ring has filled. game_img is BGR.
+	// bright_pixel_ratio and passed_early_out are the result of the early-out on the frame, which has been done already
+	void Add(int frame_number, std::chrono::steady_clock::time_point frame_time, const cv::Mat& game_img, double bright_pixel_ratio, bool passed_early_out);
+
+	// copy the entries with frame numbers in [from_frame, to_frame], oldest first
+	void GetWindow(int from_frame, int to_frame, std::vector<Entry>& entries) const;
+};
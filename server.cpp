@@ -1,12 +1,36 @@
 #include "common.h"
 #include "server.h"
-#include <timeapi.h>
+#include "tracer.h"
+#include <charconv>
 
-bool Server::Start()
+int Server::GetChannel(const std::smatch& path_match) const
+{
+	if (path_match.size() <= 2 || !path_match[2].matched)
+		return _last_images.empty() ? -1 : 0;
+
+	// any number can come in the url, one that doesn't fit in an int is no channel either
+	int channel = -1;
+	const char* first = &*path_match[2].first;
+	const char* last = first + path_match[2].length();
+	auto [end, ec] = std::from_chars(first, last, channel);
+	if (ec != std::errc() || end != last)
+		return -1;
+	return channel >= 0 && channel < int(_last_images.size()) ? channel : -1;
+}
+
+bool Server::Start(int num_channels)
 {
 	if (_is_running)
 		return true;
 
+	_ws_connections.resize(num_channels);
+	_last_images.clear();
+	for (int i = 0; i < num_channels; i++)
+		_last_images.push_back(std::make_unique<LastImage>());
+
+	// both servers are brought up at the same time, then waited for
+	std::promise<unsigned short> http_server_port, ws_server_port;
+
 	// start http server
 	{
 		_http_server.config.port = 12177;
@@ -42,11 +66,22 @@ bool Server::Start()
 			}
 		};
 
-		_http_server.resource["^/img$"]["GET"] = [this](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
-			std::lock_guard<std::mutex> lg(_last_image_mutex);
-			if (!_last_image_jpg_valid)
+		_http_server.resource["^/img(/([0-9]+))?$"]["GET"] = [this](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+			int channel = GetChannel(request->path_match);
+			if (channel < 0)
+			{
+				SimpleWeb::CaseInsensitiveMultimap header;
+				header.emplace("Content-Length", "10");
+				header.emplace("Content-Type", "text/html; charset=UTF-8");
+				response->write(header);
+				response->write("No Channel");
+				return;
+			}
+			LastImage& last_image = *_last_images[channel];
+			std::lock_guard<std::mutex> lg(last_image.mutex);
+			if (!last_image.jpg_valid)
 			{
-				if (_last_image.empty())
+				if (last_image.image.empty())
 				{
 					SimpleWeb::CaseInsensitiveMultimap header;
 					header.emplace("Content-Length", "8");
@@ -56,19 +91,73 @@ bool Server::Start()
 					return;
 				}
 
-				cv::imencode(".jpg", _last_image, _last_image_jpg);
-				_last_image_jpg_valid = true;
+				cv::imencode(".jpg", last_image.image, last_image.jpg);
+				last_image.jpg_valid = true;
 			}
 
 			SimpleWeb::CaseInsensitiveMultimap header;
-			header.emplace("Content-Length", std::to_string(_last_image_jpg.size()));
+			header.emplace("Content-Length", std::to_string(last_image.jpg.size()));
 			header.emplace("Content-Type", "image/jpeg");
 			response->write(header);
-			response->write((char*)&_last_image_jpg[0], _last_image_jpg.size());
+			response->write((char*)&last_image.jpg[0], last_image.jpg.size());
 		};
 
-		std::promise<unsigned short> server_port;
-		_http_server_thread = std::thread([this, &server_port]() {
+		_http_server.resource["^/stats$"]["GET"] = [this](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+			std::string stats;
+			{
+				std::lock_guard<std::mutex> lg(_stats_provider_mutex);
+				if (_stats_provider)
+					stats = _stats_provider();
+			}
+			if (stats.empty())
+				stats = "No statistics available";
+
+			SimpleWeb::CaseInsensitiveMultimap header;
+			header.emplace("Content-Length", std::to_string(stats.size()));
+			header.emplace("Content-Type", "text/plain; charset=UTF-8");
+			response->write(header);
+			response->write(stats.data(), stats.size());
+		};
+
+		_http_server.resource["^/replay(/([0-9]+))?(/([a-z]+))?$"]["GET"] = [this](std::shared_ptr<HttpServer::Response> response, std::shared_ptr<HttpServer::Request> request) {
+			ReplayRequest replay_request;
+			replay_request.channel = GetChannel(request->path_match);
+			replay_request.action = request->path_match[4].matched ? request->path_match[4].str() : "list";
+			bool valid = replay_request.channel >= 0;
+			try
+			{
+				SimpleWeb::CaseInsensitiveMultimap query = request->parse_query_string();
+				auto it = query.find("from");
+				if (it != query.end())
+					replay_request.from_frame = std::stoi(it->second);
+				it = query.find("to");
+				if (it != query.end())
+					replay_request.to_frame = std::stoi(it->second);
+			}
+			catch (const std::exception&)
+			{
+				valid = false;
+			}
+
+			ReplayResponse replay_response;
+			{
+				std::lock_guard<std::mutex> lg(_replay_provider_mutex);
+				valid = valid && _replay_provider && _replay_provider(replay_request, replay_response);
+			}
+			if (!valid)
+			{
+				replay_response.content_type = "text/plain; charset=UTF-8";
+				replay_response.body = "Replay not available, use /replay/<channel>/<list|image|ocr>?from=<frame>&to=<frame>";
+			}
+
+			SimpleWeb::CaseInsensitiveMultimap header;
+			header.emplace("Content-Length", std::to_string(replay_response.body.size()));
+			header.emplace("Content-Type", replay_response.content_type);
+			response->write(header);
+			response->write(replay_response.body.data(), replay_response.body.size());
+		};
+
+		_http_server_thread = std::thread([this, &server_port = http_server_port]() {
 			try {
 				// Start server
 				_http_server.start([&server_port](unsigned short port) {
@@ -83,13 +172,6 @@ bool Server::Start()
 				}
 			}
 		});
-		uint16_t port = server_port.get_future().get();
-		if (port == 0)
-		{
-			_http_server_thread.join();
-			return false;
-		}
-		std::cout << "Http server listening on http://localhost:" << port << std::endl;
 	}
 
 	// start websocket server
@@ -97,26 +179,34 @@ bool Server::Start()
 		_ws_server.config.port = 12178;
 		_ws_server.config.address = "127.0.0.1";
 		_ws_server.config.reuse_address = false;
-		auto& ep = _ws_server.endpoint["^/data$"];
+		auto& ep = _ws_server.endpoint["^/data(/([0-9]+))?$"];
 
 		ep.on_open = [this](std::shared_ptr<WsServer::Connection> connection) {
+			int channel = GetChannel(connection->path_match);
+			if (channel < 0)
+			{
+				std::cout << "Websocket connection " << connection->remote_endpoint().address().to_string() << " requested a channel that doesn't exist" << std::endl;
+				return;
+			}
 			std::unique_lock<std::shared_mutex> lock(_ws_connection_mutex);
-			_ws_connections.insert(connection);
-			std::cout << "New websocket connection " << connection->remote_endpoint().address().to_string() << std::endl;
+			_ws_connections[channel].insert(connection);
+			std::cout << "New websocket connection " << connection->remote_endpoint().address().to_string() << " on channel " << channel << std::endl;
 		};
 		ep.on_close = [this](std::shared_ptr<WsServer::Connection> connection, int status, const std::string& /*reason*/) {
 			std::unique_lock<std::shared_mutex> lock(_ws_connection_mutex);
-			_ws_connections.erase(connection);
+			for (auto& connections : _ws_connections)
+				connections.erase(connection);
 			std::cout << "Websocket Connection closed " << connection->remote_endpoint().address().to_string() << std::endl;
 		};
 		ep.on_message = [](std::shared_ptr<WsServer::Connection> connection, std::shared_ptr<WsServer::InMessage> in_message) {
-			static DWORD tbegin = ::timeGetTime();
-			std::cout << "ws server: Message received: size \"" << in_message->size() << "\" from " << connection.get() << " " << ::timeGetTime() - tbegin << std::endl;
-			tbegin = ::timeGetTime();
+			static auto tbegin = std::chrono::steady_clock::now();
+			auto now = std::chrono::steady_clock::now();
+			std::cout << "ws server: Message received: size \"" << in_message->size() << "\" from " << connection.get() << " "
+				<< std::chrono::duration_cast<std::chrono::milliseconds>(now - tbegin).count() << std::endl;
+			tbegin = now;
 		};
 
-		std::promise<unsigned short> server_port;
-		_ws_server_thread = std::thread([this, &server_port]() {
+		_ws_server_thread = std::thread([this, &server_port = ws_server_port]() {
 			try {
 				// Start server
 				_ws_server.start([&server_port](unsigned short port) {
@@ -131,35 +221,53 @@ bool Server::Start()
 				}
 			}
 		});
-		uint16_t port = server_port.get_future().get();
-		if (port == 0)
-		{
-			_http_server.stop();
-			_http_server_thread.join();
-			_ws_server_thread.join();
-			return false;
-		}
-		std::cout << "Websocket server listening on ws://localhost:" << port << std::endl;
 	}
 
+	uint16_t http_port = http_server_port.get_future().get();
+	uint16_t ws_port = ws_server_port.get_future().get();
+	if (http_port == 0 || ws_port == 0)
+	{
+		// the one that failed has already returned from start()
+		_http_server.stop();
+		_http_server_thread.join();
+		_ws_server.stop();
+		_ws_server_thread.join();
+		return false;
+	}
+	std::cout << "Http server listening on http://localhost:" << http_port << std::endl;
+	std::cout << "Websocket server listening on ws://localhost:" << ws_port << std::endl;
+
+	_is_running = true;
+
 	// start broadcast thread
 	_broadcast_thread = std::thread([this]() {
 		std::unique_lock<std::mutex> lock(_push_mutex);
 		while (1)
 		{
-			_push_cv.wait(lock, [this] { return _broadcast_str.size() > 0 || !_is_running; });
+			_push_cv.wait(lock, [this] { return _broadcast_queue.size() > 0 || !_is_running; });
 			if (!_is_running)
 				break;
-			std::shared_lock<std::shared_mutex> lock(_ws_connection_mutex);
-			for (const std::shared_ptr<WsServer::Connection>& connection : _ws_connections)
-				connection->send(_broadcast_str);
-			_broadcast_str.clear();
+			while (_broadcast_queue.size() > 0)
+			{
+				Broadcast broadcast = std::move(_broadcast_queue.front());
+				_broadcast_queue.pop_front();
+				auto send_time = std::chrono::steady_clock::now();
+				if (broadcast.frame_number >= 0 && broadcast.message.size() > 0 && broadcast.message.back() == '}')
+				{
+					broadcast.message.pop_back();
+					broadcast.message += ",\"sent\":" + std::to_string(Tracer::ToEpochMicroseconds(send_time)) + "}";
+				}
+				{
+					std::shared_lock<std::shared_mutex> lock(_ws_connection_mutex);
+					for (const std::shared_ptr<WsServer::Connection>& connection : _ws_connections[broadcast.channel])
+						connection->send(broadcast.message);
+				}
+				if (broadcast.frame_number >= 0)
+					g_tracer.AddSpan("send", broadcast.channel, Tracer::ServerLane, broadcast.frame_number, broadcast.push_time, std::chrono::steady_clock::now());
+			}
 		}
 	});
 
-
-	_is_running = true;
-
 	return true;
 }
 
@@ -182,23 +290,50 @@ void Server::Stop()
 	_http_server_thread.join();
 }
 
-void Server::PushMessage(const std::string &msg)
+void Server::PushMessage(const std::string &msg, int channel)
 {
-	if (!_is_running)
+	if (!_is_running || channel < 0 || channel >= int(_ws_connections.size()))
 		return;
 
 	{
 		std::lock_guard lg(_push_mutex);
-		_broadcast_str = msg;
+		_broadcast_queue.push_back({ channel, msg });
 	}
 	_push_cv.notify_one();
 }
 
-void Server::SetLastImage(cv::Mat img)
+void Server::PushTimedMessage(const std::string &json, int frame_number, int channel)
 {
-	std::unique_lock<std::mutex> lock(_last_image_mutex, std::try_to_lock);
+	if (!_is_running || channel < 0 || channel >= int(_ws_connections.size()))
+		return;
+
+	{
+		std::lock_guard lg(_push_mutex);
+		_broadcast_queue.push_back({ channel, json, std::max(frame_number, 0), std::chrono::steady_clock::now() });
+	}
+	_push_cv.notify_one();
+}
+
+void Server::SetLastImage(cv::Mat img, int channel)
+{
+	if (channel < 0 || channel >= int(_last_images.size()))
+		return;
+	LastImage& last_image = *_last_images[channel];
+	std::unique_lock<std::mutex> lock(last_image.mutex, std::try_to_lock);
 	if (!lock.owns_lock())
 		return;
-	_last_image = img;
-	_last_image_jpg_valid = false;
+	last_image.image = img;
+	last_image.jpg_valid = false;
+}
+
+void Server::SetStatsProvider(std::function<std::string()> provider)
+{
+	std::lock_guard<std::mutex> lg(_stats_provider_mutex);
+	_stats_provider = std::move(provider);
+}
+
+void Server::SetReplayProvider(ReplayProvider provider)
+{
+	std::lock_guard<std::mutex> lg(_replay_provider_mutex);
+	_replay_provider = std::move(provider);
 }
\ No newline at end of file
@@ -4,6 +4,9 @@
 #include <set>
 #include <memory>
 #include <shared_mutex>
+#include <deque>
+#include <climits>
+#include <chrono>
 #define ASIO_STANDALONE 1
 #include "Simple-Web-Server/server_http.hpp"
 #pragma warning(push)
@@ -14,6 +17,25 @@
 
 class Server
 {
+public:
+	// a request on "/replay/<channel>/<action>?from=<frame>&to=<frame>", all parts after "/replay" are optional
+	struct ReplayRequest
+	{
+		int channel = 0;
+		std::string action;				// "list" if not given
+		int from_frame = 0;
+		int to_frame = INT_MAX;
+	};
+	struct ReplayResponse
+	{
+		std::string content_type = "text/plain; charset=UTF-8";
+		std::string body;
+	};
+
+	// returns false if the request can't be served
+	using ReplayProvider = std::function<bool(const ReplayRequest& request, ReplayResponse& response)>;
+
+private:
 	using HttpServer = SimpleWeb::Server<SimpleWeb::HTTP>;
 	using WsServer = SimpleWeb::SocketServer<SimpleWeb::WS>;
 
@@ -21,8 +43,8 @@ class Server
 	HttpServer _http_server;
 	std::thread _http_server_thread;
 
-	// ws server
-	std::set<std::shared_ptr<WsServer::Connection>> _ws_connections;
+	// ws server, connections of each channel
+	std::vector<std::set<std::shared_ptr<WsServer::Connection>>> _ws_connections;
 	std::shared_mutex _ws_connection_mutex;
 	WsServer _ws_server;
 	std::thread _ws_server_thread;
@@ -31,18 +53,49 @@ class Server
 	std::thread _broadcast_thread;
 	std::mutex _push_mutex;
 	std::condition_variable _push_cv;
-	std::string _broadcast_str;
+	struct Broadcast
+	{
+		int channel;
+		std::string message;
+		int frame_number = -1;			// >= 0 for a timed message
+		std::chrono::steady_clock::time_point push_time;
+	};
+	std::deque<Broadcast> _broadcast_queue;
+
+	struct LastImage
+	{
+		cv::Mat image;
+		std::mutex mutex;
+		std::vector<uint8_t> jpg;
+		bool jpg_valid = false;
+	};
+	std::vector<std::unique_ptr<LastImage>> _last_images;		// one for each channel
 
-	cv::Mat _last_image;
-	std::mutex _last_image_mutex;
-	std::vector<uint8_t> _last_image_jpg;
-	bool _last_image_jpg_valid = false;
+	std::function<std::string()> _stats_provider;
+	std::mutex _stats_provider_mutex;
+
+	ReplayProvider _replay_provider;
+	std::mutex _replay_provider_mutex;
 
 	bool _is_running = false;
 
+	// channel number from a request path matched by "...(/([0-9]+))?$", or -1 if it's out of range
+	int GetChannel(const std::smatch& path_match) const;
+
 public:
-	bool Start();
+	// Each channel is an independent input stream, with its own websocket endpoint "/data/<channel>" and input image "/img/<channel>".
+	// "/data" and "/img" are channel 0.
+	bool Start(int num_channels = 1);
 	void Stop();
-	void PushMessage(const std::string &msg);
-	void SetLastImage(cv::Mat img);
+	void PushMessage(const std::string &msg, int channel = 0);
+	// A JSON object with the stage timestamps of a frame. The broadcast thread adds "sent", the time in microseconds since the Unix epoch
+	// when the message was handed to the connections, and traces the time from the push to then
+	void PushTimedMessage(const std::string &json, int frame_number, int channel = 0);
+	void SetLastImage(cv::Mat img, int channel = 0);
+
+	// the text returned by the provider is served on "/stats", pass nullptr to remove it
+	void SetStatsProvider(std::function<std::string()> provider);
+
+	// serves "/replay", pass nullptr to remove it
+	void SetReplayProvider(ReplayProvider provider);
 };
\ No newline at end of file
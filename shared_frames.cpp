@@ -0,0 +1,226 @@
+#include "shared_frames.h"
+#include <atomic>
+
+namespace shared_frames
+{
+	uint64_t FrameSize(uint32_t format, int width, int height, int stride)
+	{
+		if (width <= 0 || height <= 0)
+			return 0;
+		switch (format)
+		{
+		case format_bgr:
+			return stride >= width * 3 ? uint64_t(stride) * height : 0;
+		case format_bgra:
+			return stride >= width * 4 ? uint64_t(stride) * height : 0;
+		case format_nv12:
+			return stride >= width && width % 2 == 0 && height % 2 == 0 ? uint64_t(stride) * height * 3 / 2 : 0;
+		default:
+			return 0;
+		}
+	}
+}
+
+SharedFrameWriter::~SharedFrameWriter()
+{
+	Close();
+}
+
+bool SharedFrameWriter::Create(const std::string& name, uint64_t max_frame_size, uint32_t num_slots)
+{
+	Close();
+
+	uint64_t slot_size = (sizeof(shared_frames::SlotHeader) + max_frame_size + 63) / 64 * 64;
+	uint64_t header_size = 64;
+	uint64_t total_size = header_size + slot_size * num_slots;
+	_mapping = ::CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, DWORD(total_size >> 32), DWORD(total_size), name.c_str());
+	if (!_mapping || ::GetLastError() == ERROR_ALREADY_EXISTS)
+	{
+		std::cout << "Cannot create shared memory " << name << ", it might be used by another producer" << std::endl;
+		Close();
+		return false;
+	}
+	_view = (uint8_t*)::MapViewOfFile(_mapping, FILE_MAP_ALL_ACCESS, 0, 0, 0);
+	_event = ::CreateEventA(nullptr, FALSE, FALSE, (name + "_event").c_str());
+	if (!_view || !_event)
+	{
+		std::cout << "Cannot map shared memory " << name << std::endl;
+		Close();
+		return false;
+	}
+
+	// a new mapping is zeroed, so no frame is visible until the header is complete
+	shared_frames::Header& header = *(shared_frames::Header*)_view;
+	header.version = shared_frames::version;
+	header.header_size = uint32_t(header_size);
+	header.num_slots = num_slots;
+	header.slot_size = slot_size;
+	header.latest_sequence = 0;
+	header.closed = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+	header.magic = shared_frames::magic;
+	_sequence = 0;
+	return true;
+}
+
+void SharedFrameWriter::Close()
+{
+	if (_view)
+	{
+		((shared_frames::Header*)_view)->closed = 1;
+		if (_event)
+			::SetEvent(_event);
+		::UnmapViewOfFile(_view);
+		_view = nullptr;
+	}
+	if (_event)
+	{
+		::CloseHandle(_event);
+		_event = nullptr;
+	}
+	if (_mapping)
+	{
+		::CloseHandle(_mapping);
+		_mapping = nullptr;
+	}
+}
+
+bool SharedFrameWriter::Write(uint32_t format, int width, int height, int stride, const uint8_t* pixels, int64_t timestamp_us)
+{
+	if (!_view)
+		return false;
+	shared_frames::Header& header = *(shared_frames::Header*)_view;
+	uint64_t frame_size = shared_frames::FrameSize(format, width, height, stride);
+	if (frame_size == 0 || frame_size > header.slot_size - sizeof(shared_frames::SlotHeader))
+		return false;
+
+	int64_t sequence = ++_sequence;
+	shared_frames::SlotHeader& slot = *(shared_frames::SlotHeader*)(_view + header.header_size + (sequence % header.num_slots) * header.slot_size);
+	slot.sequence = 0;
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.timestamp_us = timestamp_us;
+	slot.format = format;
+	slot.width = width;
+	slot.height = height;
+	slot.stride = stride;
+	memcpy(&slot + 1, pixels, frame_size);
+
+	std::atomic_thread_fence(std::memory_order_release);
+	slot.sequence = sequence;
+	header.latest_sequence = sequence;
+	::SetEvent(_event);
+	return true;
+}
+
+SharedFrameReader::~SharedFrameReader()
+{
+	Close();
+}
+
+bool SharedFrameReader::Open(const std::string& name)
+{
+	Close();
+
+	_mapping = ::OpenFileMappingA(FILE_MAP_READ, FALSE, name.c_str());
+	_event = ::OpenEventA(SYNCHRONIZE, FALSE, (name + "_event").c_str());
+	if (!_mapping || !_event)
+	{
+		std::cout << "Cannot open shared memory " << name << ", the producer has to be started first" << std::endl;
+		Close();
+		return false;
+	}
+	_view = (const uint8_t*)::MapViewOfFile(_mapping, FILE_MAP_READ, 0, 0, 0);
+	MEMORY_BASIC_INFORMATION info;
+	if (!_view || ::VirtualQuery(_view, &info, sizeof(info)) == 0)
+	{
+		std::cout << "Cannot map shared memory " << name << std::endl;
+		Close();
+		return false;
+	}
+	_view_size = info.RegionSize;
+
+	// checked on a copy, so that the producer can't change it in between
+	shared_frames::Header header = {};
+	if (_view_size >= sizeof(shared_frames::Header))
+		memcpy(&header, _view, sizeof(header));
+	if (_view_size < sizeof(shared_frames::Header) || header.magic != shared_frames::magic || header.version != shared_frames::version
+		|| header.num_slots == 0 || header.slot_size < sizeof(shared_frames::SlotHeader) || header.header_size < sizeof(shared_frames::Header)
+		|| header.header_size > _view_size || header.slot_size > (_view_size - header.header_size) / header.num_slots)
+	{
+		std::cout << "Shared memory " << name << " is not a frame ring buffer of a supported version" << std::endl;
+		Close();
+		return false;
+	}
+	_header_size = header.header_size;
+	_num_slots = header.num_slots;
+	_slot_size = header.slot_size;
+	return true;
+}
+
+void SharedFrameReader::Close()
+{
+	if (_view)
+	{
+		::UnmapViewOfFile(_view);
+		_view = nullptr;
+	}
+	if (_event)
+	{
+		::CloseHandle(_event);
+		_event = nullptr;
+	}
+	if (_mapping)
+	{
+		::CloseHandle(_mapping);
+		_mapping = nullptr;
+	}
+	_view_size = 0;
+	_header_size = _num_slots = _slot_size = 0;
+}
+
+bool SharedFrameReader::WaitForFrame(std::chrono::milliseconds timeout) const
+{
+	return ::WaitForSingleObject(_event, DWORD(timeout.count())) == WAIT_OBJECT_0;
+}
+
+int64_t SharedFrameReader::ReadLatest(int64_t last_sequence, cv::Mat& bgr, int64_t& timestamp_us) const
+{
+	const shared_frames::Header& header = GetHeader();
+	int64_t sequence = header.latest_sequence;
+	if (sequence <= 0 || sequence == last_sequence)
+		return last_sequence;
+
+	const shared_frames::SlotHeader& slot = *(const shared_frames::SlotHeader*)(_view + _header_size + (uint64_t(sequence) % _num_slots) * _slot_size);
+	if (slot.sequence != sequence)
+		return last_sequence;		// overwritten already, the next signal brings a newer frame
+	std::atomic_thread_fence(std::memory_order_acquire);
+
+	uint32_t format = slot.format;
+	int width = slot.width, height = slot.height, stride = slot.stride;
+	uint64_t frame_size = shared_frames::FrameSize(format, width, height, stride);
+	if (frame_size == 0 || frame_size > _slot_size - sizeof(shared_frames::SlotHeader))
+		return last_sequence;
+	timestamp_us = slot.timestamp_us;
+
+	// the conversion to BGR is the only copy of the pixels
+	void* pixels = (void*)(&slot + 1);
+	switch (format)
+	{
+	case shared_frames::format_bgr:
+		cv::Mat(height, width, CV_8UC3, pixels, size_t(stride)).copyTo(bgr);
+		break;
+	case shared_frames::format_bgra:
+		cv::cvtColor(cv::Mat(height, width, CV_8UC4, pixels, size_t(stride)), bgr, cv::COLOR_BGRA2BGR);
+		break;
+	case shared_frames::format_nv12:
+		cv::cvtColor(cv::Mat(height * 3 / 2, width, CV_8UC1, pixels, size_t(stride)), bgr, cv::COLOR_YUV2BGR_NV12);
+		break;
+	}
+
+	// the producer went round the ring while the frame was being copied
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (slot.sequence != sequence)
+		return last_sequence;
+	return sequence;
+}
@@ -0,0 +1,120 @@
+#pragma once
+#include "common.h"
+
+
+// Frames written by a local producer process (e.g. an OBS plugin or a capture tool) into a shared memory ring buffer, so that HRT gets
+// them without the virtual camera device, the decode and the scaling of FFmpegWrap.
+//
+// The producer creates a file mapping named <name> and an auto-reset event named <name>_event, there can only be one reader.
+// Layout of the mapping, all little-endian:
+//   Header
+//   num_slots slots from Header::header_size on, Header::slot_size bytes apart. Each is a SlotHeader followed by the pixels
+// Frame n (starting from 1) goes into slot n % num_slots:
+//   1. SlotHeader::sequence is set to 0, readers skip the slot while it's being written
+//   2. the rest of the SlotHeader and the pixels are written
+//   3. SlotHeader::sequence is set to n, then Header::latest_sequence, then the event is signalled
+// A reader copies the slot of latest_sequence and checks afterwards that the sequence of the slot hasn't changed, otherwise the copy is
+// dropped. With 4 slots that only happens if the reader takes longer than 3 frames to copy one.
+namespace shared_frames
+{
+	constexpr uint32_t magic = 0x53545248;		// "HRTS"
+	constexpr uint32_t version = 1;
+	constexpr uint32_t default_num_slots = 4;
+
+	enum PixelFormat : uint32_t
+	{
+		format_bgr = 1,			// 3 bytes per pixel
+		format_bgra = 2,		// 4 bytes per pixel, alpha is ignored
+		format_nv12 = 3,		// height rows of luma, then height / 2 rows of interleaved chroma (BT.601 video range), both with the same stride
+	};
+
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint32_t header_size;				// offset of the first slot
+		uint32_t num_slots;
+		uint64_t slot_size;					// distance between slots, including the SlotHeader
+		volatile int64_t latest_sequence;	// of the latest complete frame, 0 before the first one
+		volatile uint32_t closed;			// set by the producer when it stops, the stream ends then
+		uint32_t reserved;
+	};
+
+	struct SlotHeader
+	{
+		volatile int64_t sequence;			// of the frame in the slot, 0 while it's being written
+		int64_t timestamp_us;				// when the frame was captured, in microseconds since the Unix epoch. 0 if unknown
+		uint32_t format;					// PixelFormat
+		int32_t width;
+		int32_t height;
+		int32_t stride;						// bytes from one row to the next
+	};
+
+	static_assert(sizeof(Header) == 40 && sizeof(SlotHeader) == 32, "the layout is shared with other programs");
+
+	// bytes of the pixels of a frame, 0 if the format or size is not valid
+	uint64_t FrameSize(uint32_t format, int width, int height, int stride);
+}
+
+// Reference producer, writes frames into a new ring buffer
+class SharedFrameWriter
+{
+private:
+	void* _mapping = nullptr;
+	void* _event = nullptr;
+	uint8_t* _view = nullptr;
+	int64_t _sequence = 0;
+
+public:
+	SharedFrameWriter() = default;
+	SharedFrameWriter(const SharedFrameWriter&) = delete;
+	SharedFrameWriter& operator=(const SharedFrameWriter&) = delete;
+	~SharedFrameWriter();
+
+	// create the ring buffer for frames of up to max_frame_size bytes of pixels
+	bool Create(const std::string& name, uint64_t max_frame_size, uint32_t num_slots = shared_frames::default_num_slots);
+
+	// marks the ring buffer closed so that the reader ends the stream
+	void Close();
+
+	// pixels are FrameSize() bytes in the given layout
+	bool Write(uint32_t format, int width, int height, int stride, const uint8_t* pixels, int64_t timestamp_us);
+};
+
+// Reads the latest frame of a ring buffer created by a producer
+class SharedFrameReader
+{
+private:
+	void* _mapping = nullptr;
+	void* _event = nullptr;
+	const uint8_t* _view = nullptr;
+	uint64_t _view_size = 0;
+
+	// geometry of the ring buffer as checked by Open(), the producer could change the header afterwards
+	uint64_t _header_size = 0;
+	uint64_t _num_slots = 0;
+	uint64_t _slot_size = 0;
+
+private:
+	const shared_frames::Header& GetHeader() const { return *(const shared_frames::Header*)_view; }
+
+public:
+	SharedFrameReader() = default;
+	SharedFrameReader(const SharedFrameReader&) = delete;
+	SharedFrameReader& operator=(const SharedFrameReader&) = delete;
+	~SharedFrameReader();
+
+	// the producer has to have created the ring buffer
+	bool Open(const std::string& name);
+	void Close();
+	bool IsOpen() const { return _view != nullptr; }
+
+	// wait until the producer signals a frame, returns false on timeout
+	bool WaitForFrame(std::chrono::milliseconds timeout) const;
+	bool IsClosed() const { return GetHeader().closed != 0; }
+	int64_t LatestSequence() const { return GetHeader().latest_sequence; }
+
+	// Convert the latest frame into bgr if it's newer than last_sequence, the pixels are read straight from the ring buffer.
+	// Returns its sequence number, or last_sequence if there's no newer complete frame
+	int64_t ReadLatest(int64_t last_sequence, cv::Mat& bgr, int64_t& timestamp_us) const;
+};
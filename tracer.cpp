@@ -0,0 +1,94 @@
+#include "tracer.h"
+
+Tracer g_tracer;
+
+void Tracer::Start(const std::string& file_name, int num_streams)
+{
+	std::lock_guard<std::mutex> lg(_mutex);
+	_file_name = file_name;
+	_base = std::chrono::steady_clock::now();
+	_spans.clear();
+	_spans.reserve(4096);
+	_num_dropped = 0;
+	_num_streams = num_streams;
+	_max_lane = 0;
+	_enabled = true;
+}
+
+void Tracer::AddSpan(const char* name, int stream, int lane, int frame_number, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end)
+{
+	if (!_enabled)
+		return;
+
+	std::lock_guard<std::mutex> lg(_mutex);
+	if (_spans.size() >= max_spans)
+	{
+		_num_dropped++;
+		return;
+	}
+	_spans.push_back({ name, stream, lane, frame_number,
+		std::chrono::duration_cast<std::chrono::microseconds>(begin - _base).count(),
+		std::chrono::duration_cast<std::chrono::microseconds>(end - begin).count() });
+	_max_lane = std::max(_max_lane, lane);
+}
+
+bool Tracer::Stop()
+{
+	std::lock_guard<std::mutex> lg(_mutex);
+	if (!_enabled)
+		return true;
+	_enabled = false;
+
+	std::ofstream ofs(_file_name);
+	if (!ofs.is_open())
+	{
+		std::cout << "Cannot open trace file " << _file_name << std::endl;
+		return false;
+	}
+
+	ofs << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	// events are separated by commas, without one after the last
+	const char* separator = "\n";
+	auto begin_event = [&]() -> std::ofstream& {
+		ofs << separator;
+		separator = ",\n";
+		return ofs;
+	};
+
+	// names of the processes and threads
+	for (int stream = 0; stream < _num_streams; stream++)
+	{
+		begin_event() << "{\"ph\":\"M\",\"name\":\"process_name\",\"pid\":" << stream << ",\"args\":{\"name\":\"stream " << stream << "\"}}";
+		auto name_lane = [&](int lane, const std::string& name) {
+			begin_event() << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":" << stream << ",\"tid\":" << lane << ",\"args\":{\"name\":\"" << name << "\"}}";
+			begin_event() << "{\"ph\":\"M\",\"name\":\"thread_sort_index\",\"pid\":" << stream << ",\"tid\":" << lane << ",\"args\":{\"sort_index\":" << lane << "}}";
+		};
+		name_lane(CaptureLane, "capture");
+		name_lane(LiveLoopLane, "live loop");
+		name_lane(QueueLane, "waiting for a worker");
+		name_lane(ServerLane, "web server");
+		for (int lane = WorkerLane; lane <= _max_lane; lane++)
+			name_lane(lane, "OCR worker " + std::to_string(lane - WorkerLane));
+	}
+
+	for (const Span& span : _spans)
+	{
+		begin_event() << "{\"ph\":\"X\",\"name\":\"" << span.name << "\",\"pid\":" << span.stream << ",\"tid\":" << span.lane
+			<< ",\"ts\":" << span.begin_us << ",\"dur\":" << span.duration_us << ",\"args\":{\"frame\":" << span.frame_number << "}}";
+	}
+	ofs << "\n]}\n";
+
+	std::cout << "Wrote " << _spans.size() << " trace spans to " << _file_name;
+	if (_num_dropped > 0)
+		std::cout << ", " << _num_dropped << " were dropped because the trace was full";
+	std::cout << std::endl;
+	_spans = std::vector<Span>();
+	return true;
+}
+
+int64_t Tracer::ToEpochMicroseconds(std::chrono::steady_clock::time_point time)
+{
+	static const std::chrono::system_clock::time_point s_system_base = std::chrono::system_clock::now();
+	static const std::chrono::steady_clock::time_point s_steady_base = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast<std::chrono::microseconds>((s_system_base + std::chrono::duration_cast<std::chrono::system_clock::duration>(time - s_steady_base)).time_since_epoch()).count();
+}
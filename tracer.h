@@ -0,0 +1,59 @@
+#pragma once
+#include "common.h"
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+
+// Collects the stage spans of the live pipeline (decode, early-out, queue, OCR, match, send) and writes them as a Chrome trace,
+// which can be opened in chrome://tracing or https://ui.perfetto.dev.
+// Each stream shows up as a process, each stage lane (capture, live loop, OCR worker, ...) as a thread of it.
+class Tracer
+{
+public:
+	// thread lanes of a stream, the OCR workers follow after WorkerLane
+	enum Lane
+	{
+		CaptureLane = 0,
+		LiveLoopLane = 1,
+		QueueLane = 2,
+		ServerLane = 3,
+		WorkerLane = 100,
+	};
+
+private:
+	struct Span
+	{
+		const char* name;			// a string literal
+		int stream;
+		int lane;
+		int frame_number;
+		int64_t begin_us;			// since _base
+		int64_t duration_us;
+	};
+
+	// about 32MB of spans, later spans are dropped
+	static constexpr size_t max_spans = 1 << 20;
+
+	std::string _file_name;
+	std::chrono::steady_clock::time_point _base;
+	std::vector<Span> _spans;
+	uint64_t _num_dropped = 0;
+	int _num_streams = 0;
+	int _max_lane = 0;
+	std::mutex _mutex;
+	std::atomic<bool> _enabled = false;
+
+public:
+	// start collecting spans, they are written to file_name by Stop()
+	void Start(const std::string& file_name, int num_streams);
+	bool Stop();
+	bool IsEnabled() const { return _enabled; }
+
+	void AddSpan(const char* name, int stream, int lane, int frame_number, std::chrono::steady_clock::time_point begin, std::chrono::steady_clock::time_point end);
+
+	// microseconds since the Unix epoch of a steady clock time, for timestamps that are compared with other programs
+	static int64_t ToEpochMicroseconds(std::chrono::steady_clock::time_point time);
+};
+
+extern Tracer g_tracer;
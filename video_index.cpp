@@ -0,0 +1,369 @@
+#include "video_index.h"
+#include <filesystem>
+#include <climits>
+
+extern "C" {
+#pragma warning(push)
+#pragma warning(disable: 4819)
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+#pragma warning(pop)
+}
+
+bool VideoIndex::Open(const std::string& video_file)
+{
+	std::error_code ec;
+	uint64_t file_size = std::filesystem::file_size(video_file, ec);
+	auto file_time = std::filesystem::last_write_time(video_file, ec);
+	if (ec)
+	{
+		std::cout << "Cannot open video file " << video_file << std::endl;
+		return false;
+	}
+	video_index::Header expected = {};
+	expected.magic = video_index::magic;
+	expected.version = video_index::version;
+	expected.file_size = file_size;
+	expected.file_time = int64_t(file_time.time_since_epoch().count());
+
+	std::string index_file = GetIndexFileName(video_file);
+	if (Load(index_file, expected))
+		return true;
+
+	std::cout << "Building the seek index of " << video_file << std::endl;
+	auto tbegin = std::chrono::steady_clock::now();
+	if (!Build(video_file))
+		return false;
+	_header.magic = expected.magic;
+	_header.version = expected.version;
+	_header.file_size = expected.file_size;
+	_header.file_time = expected.file_time;
+	std::cout << "Indexed " << _pts.size() << " frames and " << _keyframes.size() << " keyframes in "
+		<< std::chrono::duration<double>(std::chrono::steady_clock::now() - tbegin).count() << " seconds" << std::endl;
+
+	if (!Save(index_file))
+		std::cout << "Cannot write seek index " << index_file << ", it will be built again next time" << std::endl;
+	return true;
+}
+
+bool VideoIndex::Load(const std::string& index_file, const video_index::Header& expected)
+{
+	std::ifstream ifs(index_file, std::ios::binary);
+	if (!ifs.is_open())
+		return false;
+
+	// anything that doesn't look like what Build() writes is built again. The sizes are checked against the file before anything is allocated
+	std::error_code ec;
+	uint64_t index_size = std::filesystem::file_size(index_file, ec);
+	video_index::Header header;
+	if (ec || !ifs.read((char*)&header, sizeof(header)) || header.magic != expected.magic || header.version != expected.version
+		|| header.file_size != expected.file_size || header.file_time != expected.file_time || header.time_base_num <= 0 || header.time_base_den <= 0
+		|| header.stream_index < 0 || header.num_frames == 0 || header.num_frames > uint32_t(INT_MAX) || header.num_keyframes > header.num_frames
+		|| index_size != sizeof(header) + uint64_t(header.num_frames) * sizeof(int64_t) + uint64_t(header.num_keyframes) * sizeof(uint32_t))
+		return false;
+
+	_pts.resize(header.num_frames);
+	_keyframes.resize(header.num_keyframes);
+	ifs.read((char*)_pts.data(), _pts.size() * sizeof(int64_t));
+	ifs.read((char*)_keyframes.data(), _keyframes.size() * sizeof(uint32_t));
+	if (!ifs || !std::is_sorted(_pts.begin(), _pts.end()) || !std::is_sorted(_keyframes.begin(), _keyframes.end())
+		|| std::any_of(_keyframes.begin(), _keyframes.end(), [&header](uint32_t keyframe) { return keyframe >= header.num_frames; }))
+	{
+		_pts.clear();
+		_keyframes.clear();
+		return false;
+	}
+	_header = header;
+	return true;
+}
+
+bool VideoIndex::Save(const std::string& index_file) const
+{
+	std::ofstream ofs(index_file, std::ios::binary | std::ios::trunc);
+	if (!ofs.is_open())
+		return false;
+	ofs.write((const char*)&_header, sizeof(_header));
+	ofs.write((const char*)_pts.data(), _pts.size() * sizeof(int64_t));
+	ofs.write((const char*)_keyframes.data(), _keyframes.size() * sizeof(uint32_t));
+	return ofs.good();
+}
+
+bool VideoIndex::Build(const std::string& video_file)
+{
+	_pts.clear();
+	_keyframes.clear();
+
+	AVFormatContext* format_context = NULL;
+	int averror = avformat_open_input(&format_context, video_file.c_str(), NULL, NULL);
+	if (averror != 0)
+	{
+		char buf[1000];
+		av_strerror(averror, buf, 1000);
+		std::cout << "Could not open video file " << video_file << ": " << buf << std::endl;
+		return false;
+	}
+	int stream_index = avformat_find_stream_info(format_context, NULL) >= 0 ? av_find_best_stream(format_context, AVMEDIA_TYPE_VIDEO, -1, -1, NULL, 0) : -1;
+	if (stream_index < 0)
+	{
+		std::cout << "Could not find a video stream in " << video_file << std::endl;
+		avformat_close_input(&format_context);
+		return false;
+	}
+	AVRational time_base = format_context->streams[stream_index]->time_base;
+
+	// only the packets are read, their time stamps and keyframe flags are all the index needs
+	std::vector<int64_t> keyframe_pts;
+	AVPacket* packet = av_packet_alloc();
+	while (av_read_frame(format_context, packet) >= 0)
+	{
+		if (packet->stream_index == stream_index)
+		{
+			int64_t pts = packet->pts != AV_NOPTS_VALUE ? packet->pts : packet->dts;
+			if (pts != AV_NOPTS_VALUE)
+			{
+				_pts.push_back(pts);
+				if (packet->flags & AV_PKT_FLAG_KEY)
+					keyframe_pts.push_back(pts);
+			}
+		}
+		av_packet_unref(packet);
+	}
+	av_packet_free(&packet);
+	avformat_close_input(&format_context);
+
+	if (_pts.empty())
+	{
+		std::cout << "No video frames with time stamps in " << video_file << std::endl;
+		return false;
+	}
+
+	// packets come in decoding order, the frame numbers are in presentation order
+	std::sort(_pts.begin(), _pts.end());
+	_pts.erase(std::unique(_pts.begin(), _pts.end()), _pts.end());
+	for (int64_t pts : keyframe_pts)
+		_keyframes.push_back(uint32_t(FindFrame(pts)));
+	std::sort(_keyframes.begin(), _keyframes.end());
+	_keyframes.erase(std::unique(_keyframes.begin(), _keyframes.end()), _keyframes.end());
+
+	_header.stream_index = stream_index;
+	_header.time_base_num = time_base.num;
+	_header.time_base_den = time_base.den;
+	_header.num_frames = uint32_t(_pts.size());
+	_header.num_keyframes = uint32_t(_keyframes.size());
+	return true;
+}
+
+int64_t VideoIndex::GetFrameTimeUs(int frame_number) const
+{
+	return av_rescale_q(_pts[frame_number] - _pts[0], AVRational{ _header.time_base_num, _header.time_base_den }, AVRational{ 1, 1000000 });
+}
+
+int64_t VideoIndex::GetLabelTimeUs(int frame_number) const
+{
+	frame_number = std::clamp(frame_number, 1, NumFrames());
+	if (frame_number < NumFrames())
+		return GetFrameTimeUs(frame_number);
+
+	// the last frame ends one average frame duration after it starts
+	double fps = GetAverageFps();
+	return GetFrameTimeUs(frame_number - 1) + (fps > 0.0 ? int64_t(1000000.0 / fps + 0.5) : 0);
+}
+
+double VideoIndex::GetAverageFps() const
+{
+	if (_pts.size() < 2)
+		return 0.0;
+	double seconds = GetFrameTimeUs(NumFrames() - 1) / 1000000.0;
+	return seconds > 0.0 ? (_pts.size() - 1) / seconds : 0.0;
+}
+
+int VideoIndex::FindFrame(int64_t pts) const
+{
+	auto it = std::lower_bound(_pts.begin(), _pts.end(), pts);
+	return it != _pts.end() && *it == pts ? int(it - _pts.begin()) : -1;
+}
+
+int VideoIndex::GetKeyframeBefore(int frame_number) const
+{
+	auto it = std::upper_bound(_keyframes.begin(), _keyframes.end(), uint32_t(frame_number));
+	return it == _keyframes.begin() ? 0 : int(*(it - 1));
+}
+
+VideoReader::~VideoReader()
+{
+	Close();
+}
+
+bool VideoReader::Open(const std::string& file_name)
+{
+	Close();
+
+	if (!_index.Open(file_name))
+		return false;
+
+	int averror = avformat_open_input(&_format_context, file_name.c_str(), NULL, NULL);
+	if (averror != 0)
+	{
+		char buf[1000];
+		av_strerror(averror, buf, 1000);
+		std::cout << "Could not open video file " << file_name << ": " << buf << std::endl;
+		return false;
+	}
+	if (avformat_find_stream_info(_format_context, NULL) < 0 || _index.StreamIndex() < 0 || _index.StreamIndex() >= int(_format_context->nb_streams))
+	{
+		std::cout << "Could not find the video stream of " << file_name << std::endl;
+		Close();
+		return false;
+	}
+
+	const AVCodecParameters* codecpar = _format_context->streams[_index.StreamIndex()]->codecpar;
+	const AVCodec* codec = avcodec_find_decoder(codecpar->codec_id);
+	_codec_context = avcodec_alloc_context3(codec);
+	if (!codec || !_codec_context || avcodec_parameters_to_context(_codec_context, codecpar) < 0)
+	{
+		std::cout << "Could not set up the decoder of " << file_name << std::endl;
+		Close();
+		return false;
+	}
+	// as many decoding threads as there are cores
+	_codec_context->thread_count = 0;
+	if (avcodec_open2(_codec_context, codec, NULL) < 0)
+	{
+		std::cout << "Could not open the decoder of " << file_name << std::endl;
+		Close();
+		return false;
+	}
+
+	_packet = av_packet_alloc();
+	_frame = av_frame_alloc();
+	_next_frame = 0;
+	_seek_keyframe = -1;
+	_draining = false;
+	return true;
+}
+
+void VideoReader::Close()
+{
+	sws_freeContext(_sws_context);
+	_sws_context = nullptr;
+	av_frame_free(&_frame);
+	av_packet_free(&_packet);
+	avcodec_free_context(&_codec_context);
+	avformat_close_input(&_format_context);
+}
+
+int VideoReader::Width() const
+{
+	return _codec_context ? _codec_context->width : 0;
+}
+
+int VideoReader::Height() const
+{
+	return _codec_context ? _codec_context->height : 0;
+}
+
+bool VideoReader::SeekToKeyframe(int keyframe)
+{
+	if (av_seek_frame(_format_context, _index.StreamIndex(), _index.GetPts(keyframe), AVSEEK_FLAG_BACKWARD) < 0)
+	{
+		std::cout << "Could not seek to frame " << keyframe << std::endl;
+		return false;
+	}
+	avcodec_flush_buffers(_codec_context);
+	_seek_keyframe = keyframe;
+	_draining = false;
+	return true;
+}
+
+bool VideoReader::Seek(int frame_number)
+{
+	if (!_codec_context || frame_number < 0 || frame_number >= _index.NumFrames())
+		return false;
+
+	// decoding on is cheaper than seeking while the frame is in the group of pictures that is being decoded
+	int keyframe = _index.GetKeyframeBefore(frame_number);
+	if (frame_number < _next_frame || keyframe > _next_frame)
+	{
+		if (!SeekToKeyframe(keyframe))
+			return false;
+	}
+	_next_frame = frame_number;
+	return true;
+}
+
+bool VideoReader::Read(cv::Mat& bgr, int& frame_number)
+{
+	if (!_codec_context)
+		return false;
+
+	while (true)
+	{
+		int ret = avcodec_receive_frame(_codec_context, _frame);
+		if (ret == 0)
+		{
+			// frames are numbered by their time stamp, a frame that's not in the index follows the previous one
+			int decoded_frame = _frame->best_effort_timestamp != AV_NOPTS_VALUE ? _index.FindFrame(_frame->best_effort_timestamp) : -1;
+			if (decoded_frame < 0)
+				decoded_frame = _next_frame;
+
+			// the demuxer can land after the frame that was asked for, then go back one more keyframe
+			if (_seek_keyframe >= 0)
+			{
+				int keyframe = _seek_keyframe;
+				_seek_keyframe = -1;
+				if (decoded_frame > _next_frame && keyframe > 0)
+				{
+					av_frame_unref(_frame);
+					if (!SeekToKeyframe(_index.GetKeyframeBefore(keyframe - 1)))
+						return false;
+					continue;
+				}
+			}
+
+			// frames between the keyframe and the one that was asked for
+			if (decoded_frame < _next_frame)
+			{
+				av_frame_unref(_frame);
+				continue;
+			}
+
+			_sws_context = sws_getCachedContext(_sws_context, _frame->width, _frame->height, (AVPixelFormat)_frame->format,
+				_frame->width, _frame->height, AV_PIX_FMT_BGR24, SWS_BICUBIC, NULL, NULL, NULL);
+			if (!_sws_context)
+			{
+				std::cout << "Could not create sws context" << std::endl;
+				return false;
+			}
+			bgr.create(_frame->height, _frame->width, CV_8UC3);
+			uint8_t* dst_data[1] = { bgr.data };
+			int dst_linesize[1] = { int(bgr.step) };
+			sws_scale(_sws_context, (const uint8_t* const*)_frame->data, _frame->linesize, 0, _frame->height, dst_data, dst_linesize);
+			av_frame_unref(_frame);
+
+			frame_number = decoded_frame;
+			_next_frame = decoded_frame + 1;
+			return true;
+		}
+		if (ret == AVERROR_EOF)
+			return false;
+		if (ret != AVERROR(EAGAIN))
+		{
+			std::cout << "Error decoding frame" << std::endl;
+			return false;
+		}
+		if (_draining)
+			return false;
+
+		// the decoder needs more data, at the end of the file it gives out the frames it still holds
+		if (av_read_frame(_format_context, _packet) < 0)
+		{
+			avcodec_send_packet(_codec_context, NULL);
+			_draining = true;
+			continue;
+		}
+		if (_packet->stream_index == _index.StreamIndex())
+			avcodec_send_packet(_codec_context, _packet);
+		av_packet_unref(_packet);
+	}
+}
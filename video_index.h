@@ -0,0 +1,113 @@
+#pragma once
+#include "common.h"
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVPacket;
+struct AVFrame;
+struct SwsContext;
+
+
+// Index of the frames of a video file: the presentation time stamp of every frame and which frames are keyframes.
+// It is built by reading the packets of the file once, without decoding, and saved next to the video as <video>.hrtidx.
+// Later runs load it to seek straight to the keyframe before any frame, and to label frames with their exact time,
+// also in variable frame rate files where the frame number divided by the frame rate drifts.
+//
+// Layout of the sidecar file, all little-endian:
+//   Header
+//   int64_t pts[num_frames], in the time base of the stream, in presentation order
+//   uint32_t keyframes[num_keyframes], frame numbers in increasing order
+namespace video_index
+{
+	constexpr uint32_t magic = 0x49545248;		// "HRTI"
+	constexpr uint32_t version = 1;
+
+#pragma pack(push, 1)
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t file_size;				// of the video, the index is built again if the size or the modification time changed
+		int64_t file_time;
+		int32_t stream_index;
+		int32_t time_base_num;
+		int32_t time_base_den;
+		uint32_t num_frames;
+		uint32_t num_keyframes;
+	};
+#pragma pack(pop)
+}
+
+class VideoIndex
+{
+private:
+	video_index::Header _header = {};
+	std::vector<int64_t> _pts;
+	std::vector<uint32_t> _keyframes;
+
+private:
+	bool Load(const std::string& index_file, const video_index::Header& expected);
+	bool Save(const std::string& index_file) const;
+	bool Build(const std::string& video_file);
+
+public:
+	// load the index of video_file from its sidecar file, or build it and save the sidecar if there is none or it's out of date
+	bool Open(const std::string& video_file);
+
+	static std::string GetIndexFileName(const std::string& video_file) { return video_file + ".hrtidx"; }
+
+	int StreamIndex() const { return _header.stream_index; }
+	int NumFrames() const { return int(_pts.size()); }
+	int64_t GetPts(int frame_number) const { return _pts[frame_number]; }
+
+	// time of a frame in microseconds from the first frame
+	int64_t GetFrameTimeUs(int frame_number) const;
+	// Time a frame is labelled with, for frame numbers that start at 1: the end of the frame, i.e. the start of the next one.
+	// For a constant frame rate that's frame_number / fps, as the labels were before the index
+	int64_t GetLabelTimeUs(int frame_number) const;
+	// from the first to the last frame, 0 if there are less than 2 frames
+	double GetAverageFps() const;
+
+	// the frame with the given pts, -1 if there is none
+	int FindFrame(int64_t pts) const;
+	// the last keyframe at or before the frame, 0 if there is none
+	int GetKeyframeBefore(int frame_number) const;
+};
+
+// Decodes a video file with FFmpeg, seeking and numbering the frames with its VideoIndex
+class VideoReader
+{
+private:
+	VideoIndex _index;
+	AVFormatContext* _format_context = nullptr;
+	AVCodecContext* _codec_context = nullptr;
+	AVPacket* _packet = nullptr;
+	AVFrame* _frame = nullptr;
+	SwsContext* _sws_context = nullptr;
+
+	int _next_frame = 0;				// Read() skips the decoded frames before this one
+	int _seek_keyframe = -1;			// keyframe of the last seek until the first frame after it is decoded, -1 otherwise
+	bool _draining = false;				// the end of the file was reached, the decoder gives out the frames it still holds
+
+private:
+	bool SeekToKeyframe(int keyframe);
+
+public:
+	VideoReader() = default;
+	VideoReader(const VideoReader&) = delete;
+	VideoReader& operator=(const VideoReader&) = delete;
+	~VideoReader();
+
+	bool Open(const std::string& file_name);
+	void Close();
+
+	const VideoIndex& Index() const { return _index; }
+	int Width() const;
+	int Height() const;
+
+	// the next Read() returns the given frame. Seeks to the keyframe before it unless it's ahead in the same group of pictures
+	bool Seek(int frame_number);
+
+	// decode the next frame into bgr, frame_number is its index in the video. Returns false at the end of the video
+	bool Read(cv::Mat& bgr, int& frame_number);
+};